@@ -67,17 +67,24 @@ function(caffe_pickup_caffe_sources root)
   caffe_source_group("Source"       GLOB "${root}/src/caffe/test/test_*.cpp")
   caffe_source_group("Source\\Cuda" GLOB "${root}/src/caffe/test/test_*.cu")
 
+  # source groups for benchmark target
+  caffe_source_group("Include" GLOB "${root}/include/caffe/bench/bench_*.h*")
+  caffe_source_group("Source"  GLOB "${root}/src/caffe/bench/bench_*.cpp")
+
   # collect files
   file(GLOB test_hdrs    ${root}/include/caffe/test/test_*.h*)
   file(GLOB test_srcs    ${root}/src/caffe/test/test_*.cpp)
+  file(GLOB bench_hdrs   ${root}/include/caffe/bench/bench_*.h*)
+  file(GLOB bench_srcs   ${root}/src/caffe/bench/bench_*.cpp)
   file(GLOB_RECURSE hdrs ${root}/include/caffe/*.h*)
   file(GLOB_RECURSE srcs ${root}/src/caffe/*.cpp)
-  list(REMOVE_ITEM  hdrs ${test_hdrs})
-  list(REMOVE_ITEM  srcs ${test_srcs})
+  list(REMOVE_ITEM  hdrs ${test_hdrs} ${bench_hdrs})
+  list(REMOVE_ITEM  srcs ${test_srcs} ${bench_srcs})
 
   # adding headers to make the visible in some IDEs (Qt, VS, Xcode)
   list(APPEND srcs ${hdrs} ${PROJECT_BINARY_DIR}/caffe_config.h)
   list(APPEND test_srcs ${test_hdrs})
+  list(APPEND bench_srcs ${bench_hdrs})
 
   # collect cuda files
   file(GLOB    test_cuda ${root}/src/caffe/test/test_*.cu)
@@ -93,12 +100,14 @@ function(caffe_pickup_caffe_sources root)
   caffe_convert_absolute_paths(cuda)
   caffe_convert_absolute_paths(test_srcs)
   caffe_convert_absolute_paths(test_cuda)
+  caffe_convert_absolute_paths(bench_srcs)
 
   # propagate to parent scope
   set(srcs ${srcs} PARENT_SCOPE)
   set(cuda ${cuda} PARENT_SCOPE)
   set(test_srcs ${test_srcs} PARENT_SCOPE)
   set(test_cuda ${test_cuda} PARENT_SCOPE)
+  set(bench_srcs ${bench_srcs} PARENT_SCOPE)
 endfunction()
 
 ################################################################################################
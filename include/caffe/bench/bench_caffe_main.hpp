@@ -0,0 +1,89 @@
+// The main caffe micro-benchmark code. Your benchmark cpp code should include
+// this hpp and register its benchmarks with BENCHMARK.
+#ifndef CAFFE_BENCH_BENCH_CAFFE_MAIN_HPP_
+#define CAFFE_BENCH_BENCH_CAFFE_MAIN_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+namespace bench {
+
+/**
+ * @brief The state of one run of a benchmark, in the style of Google
+ *        Benchmark: the benchmark sets up its inputs for the arguments in
+ *        range(), gives the work that one iteration does, and then runs its
+ *        kernel while KeepRunning(), which times the iterations.
+ */
+class State {
+ public:
+  State(const vector<int>& args, int64_t max_iterations);
+
+  bool KeepRunning();
+  inline int range(int i) const { return args_[i]; }
+  /// @brief The FLOPs of one iteration, counting a multiply-add as two.
+  inline void SetFlopsPerIteration(int64_t flops) { flops_ = flops; }
+  /// @brief The bytes of memory one iteration reads and writes.
+  inline void SetBytesPerIteration(int64_t bytes) { bytes_ = bytes; }
+
+  inline int64_t iterations() const { return iterations_; }
+  inline double seconds() const { return seconds_; }
+  inline int64_t flops() const { return flops_; }
+  inline int64_t bytes() const { return bytes_; }
+
+ protected:
+  vector<int> args_;
+  int64_t max_iterations_, iterations_;
+  int64_t flops_, bytes_;
+  CPUTimer timer_;
+  double seconds_;
+};
+
+typedef void (*Function)(State* state);
+
+/// @brief A registered benchmark and the arguments it is swept over.
+class Benchmark {
+ public:
+  Benchmark(const string& name, Function function)
+      : name_(name), function_(function) {}
+
+  /// @brief Adds a run with the given arguments, the unused ones being -1.
+  Benchmark* Args(int a, int b = -1, int c = -1, int d = -1, int e = -1,
+      int f = -1, int g = -1, int h = -1);
+
+  inline const string& name() const { return name_; }
+  inline Function function() const { return function_; }
+  inline const vector<vector<int> >& args() const { return args_; }
+
+ protected:
+  string name_;
+  Function function_;
+  vector<vector<int> > args_;
+};
+
+Benchmark* RegisterBenchmark(const string& name, Function function);
+const vector<Benchmark*>& Benchmarks();
+
+/// @brief Fills blob with Gaussian noise.
+void FillGaussian(Blob<float>* blob);
+
+/**
+ * @brief Times the forward (or backward, into the first bottom only) of a
+ *        CPU layer on bottom, reporting the work that NetProfiler estimates.
+ */
+void RunLayer(State* state, const LayerParameter& param,
+    const vector<Blob<float>*>& bottom, bool backward);
+
+}  // namespace bench
+}  // namespace caffe
+
+#define BENCHMARK(function) \
+  static ::caffe::bench::Benchmark* benchmark_##function = \
+      ::caffe::bench::RegisterBenchmark(#function, function)
+
+#endif  // CAFFE_BENCH_BENCH_CAFFE_MAIN_HPP_
@@ -216,6 +216,11 @@ class Blob {
     return diff_;
   }
 
+  /// @brief The memory that holds the shape for gpu_shape(), if reshaped.
+  inline const shared_ptr<SyncedMemory>& shape_data() const {
+    return shape_data_;
+  }
+
   const Dtype* cpu_data() const;
   void set_cpu_data(Dtype* data);
   const int* gpu_shape() const;
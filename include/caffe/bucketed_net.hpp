@@ -0,0 +1,75 @@
+#ifndef CAFFE_BUCKETED_NET_HPP_
+#define CAFFE_BUCKETED_NET_HPP_
+
+#include <utility>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_weights.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Runs a net on images of varying size by padding them to a few fixed
+ *        shapes, so that images can be batched and the net is not reshaped
+ *        for every image.
+ *
+ * There is one replica of the net per bucket shape, which share their
+ * weights, each set up once for a batch of images of that shape. An image
+ * goes in the smallest bucket that holds it, at the top left, with zeros to
+ * the bottom and right. For each image, the im_info input, if the net has
+ * one, is set to its height and width before padding and the scale it was
+ * resized by, so that e.g. proposals are clipped to the image and not the
+ * padding. Buckets for the aspect ratios expected, e.g. for Faster R-CNN
+ * images resized to a shorter side of 600, keep the padding small.
+ */
+template <typename Dtype>
+class BucketedNet {
+ public:
+  /**
+   * @param param the net, whose data input gives the number of channels
+   * @param weights the trained weights of the net; without them, the other
+   *        replicas share the params that the first one initialized.
+   */
+  BucketedNet(const ShapeBucketParameter& bucket_param,
+      const NetParameter& param,
+      shared_ptr<NetWeights<Dtype> > weights =
+          shared_ptr<NetWeights<Dtype> >());
+
+  inline int num_buckets() const { return nets_.size(); }
+  /// @brief The smallest bucket that holds height x width, or -1 if none.
+  int Bucket(int height, int width) const;
+  /**
+   * @brief Groups images of the given (height, width) sizes into batches of
+   *        up to batch_size images of the same bucket, by index.
+   */
+  void Group(const vector<std::pair<int, int> >& sizes,
+      vector<vector<int> >* batches, vector<int>* buckets) const;
+
+  /**
+   * @brief Runs the net of a bucket on up to batch_size images, each
+   *        channels x height x width, resized by the given scales.
+   *
+   * @return the outputs of the net, batched like the images
+   */
+  const vector<Blob<Dtype>*>& Forward(int bucket,
+      const vector<Blob<Dtype>*>& images, const vector<Dtype>& scales);
+
+  inline shared_ptr<Net<Dtype> > net(int bucket) const {
+    return nets_[bucket];
+  }
+
+ protected:
+  ShapeBucketParameter param_;
+  vector<shared_ptr<Net<Dtype> > > nets_;
+  int channels_;
+
+  DISABLE_COPY_AND_ASSIGN(BucketedNet);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_BUCKETED_NET_HPP_
@@ -97,6 +97,9 @@ using std::vector;
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
 
+// The peak resident memory of the process in bytes, or 0 if it is unknown.
+size_t PeakResidentBytes();
+
 // A singleton class to hold common caffe stuff, such as the handler that
 // caffe is going to use for cublas, curand, etc.
 class Caffe {
@@ -147,6 +147,9 @@ class DataTransformer {
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
+  // The mean value of a channel repeated along a row, for the uint8 fast
+  // path, kept to reuse its memory across calls
+  vector<Dtype> mean_row_;
 };
 
 }  // namespace caffe
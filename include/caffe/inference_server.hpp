@@ -0,0 +1,82 @@
+#ifndef CAFFE_INFERENCE_SERVER_HPP_
+#define CAFFE_INFERENCE_SERVER_HPP_
+
+#include <boost/thread/future.hpp>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_weights.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
+
+namespace caffe {
+
+/// The input of one request to an InferenceServer, and where its outputs go.
+template <typename Dtype>
+class InferenceRequest {
+ public:
+  vector<Dtype> input_;
+  boost::promise<vector<shared_ptr<Blob<Dtype> > > > output_;
+};
+
+/**
+ * @brief Runs a net on single inputs submitted from any number of threads,
+ *        batching the requests that arrive together.
+ *
+ * The server keeps replicas of the net, which share their weights, each run
+ * on its own thread. A replica takes the first waiting request, waits up to
+ * batch_timeout_us for more, up to max_batch_size in all, and runs the net
+ * forward. The outputs for each request are set on the future that Submit
+ * returned. The nets are shaped for max_batch_size once, so that they are
+ * never reshaped while serving; smaller batches are padded and cost as much.
+ *
+ * The net must have a single input (e.g. an Input layer), and its input and
+ * outputs must be batched along their first axis. It must not set
+ * flat_params, which is for training.
+ */
+template <typename Dtype>
+class InferenceServer {
+ public:
+  /// The outputs of the net for one request, each with a first axis of 1.
+  typedef vector<shared_ptr<Blob<Dtype> > > Output;
+
+  /**
+   * @param param the net, which should be in the TEST phase
+   * @param weights the trained weights of the net; without them, the other
+   *        replicas share the params that the first one initialized.
+   */
+  InferenceServer(const InferenceServerParameter& server_param,
+      const NetParameter& param,
+      shared_ptr<NetWeights<Dtype> > weights =
+          shared_ptr<NetWeights<Dtype> >());
+  /// Stops the replicas; the futures of the requests left are broken.
+  virtual ~InferenceServer();
+
+  /// @brief Queues a copy of the input_count() values of input.
+  boost::unique_future<Output> Submit(const Dtype* input);
+
+  /// @brief The shape of the input of one request.
+  inline const vector<int>& input_shape() const { return input_shape_; }
+  inline int input_count() const { return input_count_; }
+  inline const vector<shared_ptr<Net<Dtype> > >& nets() const {
+    return nets_;
+  }
+
+ protected:
+  class Replica;
+
+  InferenceServerParameter param_;
+  vector<int> input_shape_;
+  int input_count_;
+  vector<shared_ptr<Net<Dtype> > > nets_;
+  BlockingQueue<InferenceRequest<Dtype>*> requests_;
+  vector<shared_ptr<Replica> > replicas_;
+
+  DISABLE_COPY_AND_ASSIGN(InferenceServer);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_INFERENCE_SERVER_HPP_
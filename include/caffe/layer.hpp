@@ -68,7 +68,8 @@ class Layer {
       const vector<Blob<Dtype>*>& top) {
     CheckBlobCounts(bottom, top);
     LayerSetUp(bottom, top);
-    Reshape(bottom, top);
+    reshaped_blobs_.clear();
+    ReshapeIfChanged(bottom, top);
     SetLossWeights(top);
   }
 
@@ -106,6 +107,21 @@ class Layer {
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
 
+  /**
+   * @brief Calls Reshape, unless the bottom and top blobs are the same
+   *        blobs, with the same shapes and data memory, as after the last
+   *        call, so the tops and internal buffers are already set up for
+   *        them.
+   *
+   * The blobs themselves count because Reshape may depend on which they
+   * are (e.g. in-place computation) or share their data (e.g. Flatten).
+   *
+   * Forward and Net::Reshape reshape layers through this, so that running
+   * a net again on inputs of the same shape does not reshape every layer.
+   */
+  void ReshapeIfChanged(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
   /**
    * @brief Given the bottom blobs, compute the top blobs and the loss.
    *
@@ -168,6 +184,13 @@ class Layer {
    */
   virtual void ToProto(LayerParameter* param, bool write_diff = false);
 
+  /**
+   * @brief Called after the values of the layer blobs are set from outside
+   *        the layer, e.g. by Net::CopyTrainedLayersFrom, so that the layer
+   *        can drop what it computed from them.
+   */
+  virtual void BlobsChanged() {}
+
   /**
    * @brief Returns the scalar loss associated with a top blob at a given index.
    */
@@ -257,6 +280,14 @@ class Layer {
    */
   virtual inline bool AutoTopBlobs() const { return false; }
 
+  /**
+   * @brief Returns true if Reshape depends on the data of the bottom blobs,
+   *        or other state, and not only on their shapes.
+   *
+   * If this method returns true, ReshapeIfChanged always calls Reshape.
+   */
+  virtual inline bool ReshapeDependsOnData() const { return false; }
+
   /**
    * @brief Return whether to allow force_backward for a given bottom blob
    *        index.
@@ -312,6 +343,16 @@ class Layer {
    *  the objective function. */
   vector<Dtype> loss_;
 
+  /** A bottom or top blob after the last Reshape by ReshapeIfChanged */
+  struct ReshapedBlob {
+    const Blob<Dtype>* blob;
+    const SyncedMemory* data;
+    vector<int> shape;
+  };
+  /** The bottom then the top blobs after the last Reshape by
+   *  ReshapeIfChanged. */
+  vector<ReshapedBlob> reshaped_blobs_;
+
   /** @brief Using the CPU device, compute the layer output. */
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) = 0;
@@ -419,7 +460,7 @@ template <typename Dtype>
 inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   Dtype loss = 0;
-  Reshape(bottom, top);
+  ReshapeIfChanged(bottom, top);
   switch (Caffe::mode()) {
   case Caffe::CPU:
     Forward_cpu(bottom, top);
@@ -467,6 +508,33 @@ inline void Layer<Dtype>::Backward(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void Layer<Dtype>::ReshapeIfChanged(const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const int num_blobs = bottom.size() + top.size();
+  bool changed = ReshapeDependsOnData() || reshaped_blobs_.size() != num_blobs;
+  for (int i = 0; i < num_blobs && !changed; ++i) {
+    const Blob<Dtype>* blob =
+        i < bottom.size() ? bottom[i] : top[i - bottom.size()];
+    const ReshapedBlob& reshaped = reshaped_blobs_[i];
+    changed = blob != reshaped.blob || blob->shape() != reshaped.shape ||
+        (blob->count() ? blob->data().get() : NULL) != reshaped.data;
+  }
+  if (!changed) {
+    return;
+  }
+  Reshape(bottom, top);
+  reshaped_blobs_.resize(num_blobs);
+  for (int i = 0; i < num_blobs; ++i) {
+    const Blob<Dtype>* blob =
+        i < bottom.size() ? bottom[i] : top[i - bottom.size()];
+    ReshapedBlob& reshaped = reshaped_blobs_[i];
+    reshaped.blob = blob;
+    reshaped.data = blob->count() ? blob->data().get() : NULL;
+    reshaped.shape = blob->shape();
+  }
+}
+
 // Serialize LayerParameter to protocol buffer
 template <typename Dtype>
 void Layer<Dtype>::ToProto(LayerParameter* param, bool write_diff) {
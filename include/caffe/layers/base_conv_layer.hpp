@@ -6,7 +6,9 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/int8.hpp"
 
 namespace caffe {
 
@@ -18,7 +20,7 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), packed_memory_(NULL), packed_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -27,9 +29,17 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
+  virtual void BlobsChanged() {
+    half_weights_.Clear();
+    int8_weights_.Clear();
+  }
 
  protected:
   void reshape_variables(const Blob<Dtype>* bottom, const Blob<Dtype>* top);
+  // Packs the weights into half_weights_ or int8_weights_ for
+  // forward_cpu_gemm, if weight_precision asks for it and they are not
+  // packed yet or were written to since they were packed.
+  void pack_weights();
   // Helper functions that abstract away the column buffer and gemm arguments.
   // The last argument in forward_cpu_gemm is so that we can skip the im2col if
   // we just called weight_cpu_gemm with the same input.
@@ -93,6 +103,13 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief The weights in fp16 or bf16, per weight_precision, if packed
+  HalfMatrix<Dtype> half_weights_;
+  /// @brief The weights quantized to int8, for weight_precision INT8
+  Int8Matrix<Dtype> int8_weights_;
+  /// @brief The memory and version of the weights when they were packed
+  const SyncedMemory* packed_memory_;
+  size_t packed_version_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
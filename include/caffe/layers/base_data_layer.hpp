@@ -46,7 +46,39 @@ class BaseDataLayer : public Layer<Dtype> {
 template <typename Dtype>
 class Batch {
  public:
+  Batch() : load_time_(), read_time_(), trans_time_() {
+#ifndef CPU_ONLY
+    copied_ = NULL;
+#endif
+  }
   Blob<Dtype> data_, label_;
+  // Time in ms taken to load this batch. Layers that time reading and
+  // transforming separately report those parts in read_time_ and trans_time_.
+  double load_time_, read_time_, trans_time_;
+#ifndef CPU_ONLY
+  // Recorded on the prefetch stream once data_ and label_ have been pushed
+  // to the GPU, so that consumers can wait for the upload without blocking.
+  cudaEvent_t copied_;
+#endif
+};
+
+/**
+ * @brief Counters describing how well a BasePrefetchingDataLayer keeps up
+ *        with the net, accumulated over the Forward calls since the last
+ *        reset. Use them to size the prefetch depth and the loading work.
+ */
+struct PrefetchStats {
+  PrefetchStats()
+      : forwards(), waits(), wait_time(), max_wait_time(), load_time(),
+        read_time(), trans_time() {}
+  // occupancy[k] is the number of Forward calls that found k batches ready.
+  vector<int> occupancy;
+  // Number of Forward calls, and how many of them had to wait for a batch.
+  int forwards, waits;
+  // Time in ms spent waiting for batches, in total and in the worst Forward.
+  double wait_time, max_wait_time;
+  // Time in ms spent loading, reading and transforming the batches consumed.
+  double load_time, read_time, trans_time;
 };
 
 template <typename Dtype>
@@ -54,6 +86,7 @@ class BasePrefetchingDataLayer :
     public BaseDataLayer<Dtype>, public InternalThread {
  public:
   explicit BasePrefetchingDataLayer(const LayerParameter& param);
+  virtual ~BasePrefetchingDataLayer();
   // LayerSetUp: implements common data layer setup functionality, and calls
   // DataLayerSetUp to do special data layer setup for individual layer types.
   // This method may not be overridden.
@@ -65,14 +98,21 @@ class BasePrefetchingDataLayer :
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
 
+  inline const PrefetchStats& prefetch_stats() const { return stats_; }
+  void ResetPrefetchStats();
+
  protected:
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Releases the current batch and waits for the next one to be ready,
+  // accounting for it in stats_.
+  void NextBatch();
 
   vector<shared_ptr<Batch<Dtype> > > prefetch_;
   BlockingQueue<Batch<Dtype>*> prefetch_free_;
   BlockingQueue<Batch<Dtype>*> prefetch_full_;
   Batch<Dtype>* prefetch_current_;
+  PrefetchStats stats_;
 
   Blob<Dtype> transformed_data_;
 };
@@ -26,6 +26,8 @@ class FilterLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Filter"; }
+  // The number of items selected shapes the tops.
+  virtual inline bool ReshapeDependsOnData() const { return true; }
   virtual inline int MinBottomBlobs() const { return 2; }
   virtual inline int MinTopBlobs() const { return 1; }
 
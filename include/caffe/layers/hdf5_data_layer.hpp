@@ -7,23 +7,41 @@
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 
 #include "caffe/layers/base_data_layer.hpp"
 
 namespace caffe {
 
+/**
+ * @brief A block of consecutive rows streamed from an HDF5 file, along with
+ *        the order in which its rows are to be output.
+ */
+template <typename Dtype>
+class HDF5Chunk {
+ public:
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+  vector<unsigned int> permutation_;
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * By default each file is loaded whole on the forward path. If
+ * hdf5_data_param.chunk_size is set, files are instead streamed by a
+ * background thread in chunks of chunk_size rows, double-buffered, so that
+ * files of any size are read without stalls at file boundaries.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
  public:
   explicit HDF5DataLayer(const LayerParameter& param)
-      : Layer<Dtype>(param), offset_() {}
+      : Layer<Dtype>(param), offset_(), chunk_current_() {}
   virtual ~HDF5DataLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -49,6 +67,11 @@ class HDF5DataLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void LoadHDF5FileData(const char* filename);
 
+  // Streaming mode, used when chunk_size > 0.
+  virtual void InternalThreadEntry();
+  void StreamHDF5File(const char* filename);
+  void NextChunk();
+
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
   unsigned int current_file_;
@@ -57,6 +80,11 @@ class HDF5DataLayer : public Layer<Dtype> {
   std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
   uint64_t offset_;
+
+  vector<shared_ptr<HDF5Chunk<Dtype> > > chunks_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_free_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_full_;
+  HDF5Chunk<Dtype>* chunk_current_;
 };
 
 }  // namespace caffe
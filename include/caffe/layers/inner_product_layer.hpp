@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
+#include "caffe/util/int8.hpp"
 
 namespace caffe {
 
@@ -19,7 +21,7 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), packed_memory_(NULL), packed_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -29,8 +31,15 @@ class InnerProductLayer : public Layer<Dtype> {
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
   virtual inline bool EqualNumBottomTopBlobs() const { return true; }
+  virtual void BlobsChanged() {
+    half_weights_.Clear();
+    int8_weights_.Clear();
+  }
 
  protected:
+  // Packs the weights for weight_precision, if they are not packed yet or
+  // were written to since they were packed.
+  void pack_weights();
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
@@ -48,6 +57,13 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  /// The weights in fp16 or bf16, per weight_precision, if packed
+  HalfMatrix<Dtype> half_weights_;
+  /// The weights quantized to int8, for weight_precision INT8
+  Int8Matrix<Dtype> int8_weights_;
+  /// The memory and version of the weights when they were packed
+  const SyncedMemory* packed_memory_;
+  size_t packed_version_;
 };
 
 }  // namespace caffe
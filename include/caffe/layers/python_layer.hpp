@@ -10,6 +10,21 @@ namespace bp = boost::python;
 
 namespace caffe {
 
+/**
+ * @brief Holds the GIL for its scope. Native code that pycaffe runs with the
+ *        GIL released (e.g. Net.forward) takes it to call back into Python.
+ */
+class PyGILLock {
+ public:
+  PyGILLock() : state_(PyGILState_Ensure()) {}
+  ~PyGILLock() { PyGILState_Release(state_); }
+
+ private:
+  PyGILState_STATE state_;
+
+  DISABLE_COPY_AND_ASSIGN(PyGILLock);
+};
+
 template <typename Dtype>
 class PythonLayer : public Layer<Dtype> {
  public:
@@ -24,6 +39,7 @@ class PythonLayer : public Layer<Dtype> {
         && !Caffe::multiprocess()) {
       LOG(FATAL) << "PythonLayer does not support CLI Multi-GPU, use train.py";
     }
+    PyGILLock lock;
     self_.attr("param_str") = bp::str(
         this->layer_param_.python_param().param_str());
     self_.attr("phase") = static_cast<int>(this->phase_);
@@ -31,18 +47,22 @@ class PythonLayer : public Layer<Dtype> {
   }
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    PyGILLock lock;
     self_.attr("reshape")(bottom, top);
   }
 
   virtual inline const char* type() const { return "Python"; }
+  virtual inline bool ReshapeDependsOnData() const { return true; }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
+    PyGILLock lock;
     self_.attr("forward")(bottom, top);
   }
   virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    PyGILLock lock;
     self_.attr("backward")(top, propagate_down, bottom);
   }
 
@@ -10,10 +10,15 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/net_tracer.hpp"
+#include "caffe/net_weights.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/mapped_weights.hpp"
 
 namespace caffe {
 
+template <typename Dtype> class BasePrefetchingDataLayer;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -23,9 +28,18 @@ namespace caffe {
 template <typename Dtype>
 class Net {
  public:
-  explicit Net(const NetParameter& param);
+  /**
+   * @brief Initializes a network; the layers named in weights, if given,
+   *        share the data of their params with it instead of allocating and
+   *        filling them (see NetWeights).
+   */
+  explicit Net(const NetParameter& param,
+      shared_ptr<NetWeights<Dtype> > weights =
+          shared_ptr<NetWeights<Dtype> >());
   explicit Net(const string& param_file, Phase phase,
-      const int level = 0, const vector<string>* stages = NULL);
+      const int level = 0, const vector<string>* stages = NULL,
+      shared_ptr<NetWeights<Dtype> > weights =
+          shared_ptr<NetWeights<Dtype> >());
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
@@ -114,10 +128,24 @@ class Net {
   void CopyTrainedLayersFrom(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Points the params at the data of a weights file mapped into memory
+   *        (see MappedWeights), instead of copying it. Params of other types
+   *        than float, or kept in a flat buffer, are copied.
+   */
+  void CopyTrainedLayersFromMapped(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
+  /// @brief Writes the net to a proto, taking the values of the params from
+  ///        params, e.g. a copy of params() made earlier.
+  void ToProto(NetParameter* param, bool write_diff,
+               const vector<shared_ptr<Blob<Dtype> > >& params) const;
   /// @brief Writes the net to an HDF5 file.
   void ToHDF5(const string& filename, bool write_diff = false) const;
+  /// @brief Writes the net to an HDF5 file, taking the values of the params
+  ///        from params.
+  void ToHDF5(const string& filename, bool write_diff,
+              const vector<shared_ptr<Blob<Dtype> > >& params) const;
 
   /// @brief returns the network name.
   inline const string& name() const { return name_; }
@@ -213,6 +241,22 @@ class Net {
   const shared_ptr<Blob<Dtype> > blob_by_name(const string& blob_name) const;
   bool has_layer(const string& layer_name) const;
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
+  /**
+   * @brief returns the buffer holding the data and diffs of all learnable
+   *        params if NetParameter flat_params is set, or NULL
+   *
+   * ClearParamDiffs, Update and SGDSolver::ClipGradients go over it in one
+   * pass. The fused CPU solver updates still run per param, as their
+   * learning rates, decays and history differ per param. It is NULL if the
+   * params share memory with NetWeights or another net, and once the net
+   * shares the params of another net (ShareTrainedLayersWith).
+   */
+  inline const shared_ptr<Blob<Dtype> >& flat_params() const {
+    return flat_params_;
+  }
+  /// @brief returns the layers that prefetch their batches, e.g. to inspect
+  ///        their PrefetchStats
+  vector<BasePrefetchingDataLayer<Dtype>*> prefetching_layers() const;
 
   void set_debug_info(const bool value) { debug_info_ = value; }
 
@@ -252,6 +296,35 @@ class Net {
     after_backward_.push_back(value);
   }
 
+  /**
+   * @brief Records each layer that ForwardFromTo and BackwardFromTo run in
+   *        tracer, or stops recording if it is null. Not to be called while
+   *        the net is running.
+   */
+  void set_tracer(shared_ptr<NetTracer> tracer) { tracer_ = tracer; }
+  inline const shared_ptr<NetTracer>& tracer() const { return tracer_; }
+
+  /// @brief The bytes of memory that a layer holds, see MemoryReport.
+  struct LayerMemory {
+    /// The tops the layer computes, but not in place
+    size_t top_data, top_diff;
+    /// The params of the layer, but not those of other layers it shares
+    size_t param_data, param_diff;
+    /// The buffers of the layer itself, e.g. the im2col buffer
+    size_t internal;
+  };
+  /**
+   * @brief Reports the memory that each layer holds, counting memory that
+   *        blobs share, e.g. in place, by MemoryOptimize or as shared params,
+   *        once.
+   *
+   * Blobs are allocated when they are first used, so this runs the net
+   * forward, and backward where it needs it, a layer at a time. The internal
+   * buffers of a layer are what SyncedMemory allocated on top of its blobs
+   * while it was set up or run here, so call this before running the net.
+   */
+  void MemoryReport(vector<LayerMemory>* report);
+
  protected:
   // Helpers for Init.
   /// @brief Append a new top blob to the net.
@@ -273,6 +346,12 @@ class Net {
   /// @brief Helper for displaying debug info in Update.
   void UpdateDebugInfo(const int param_id);
 
+  /// @brief Moves the learnable params into flat_params_.
+  void FlattenParams();
+  /// @brief The bytes allocated for the bottoms, tops and params of a
+  ///        layer, with their shapes.
+  int64_t LayerBlobBytes(int layer_id) const;
+
   /// @brief do a dry run to decide blob dependency
   void MemoryOptimize_v2();
   /// @brief The network name
@@ -314,6 +393,15 @@ class Net {
   /// The parameters in the network.
   vector<shared_ptr<Blob<Dtype> > > params_;
   vector<Blob<Dtype>*> learnable_params_;
+  /// Backs the data and diffs of learnable_params_ if flat_params is set
+  shared_ptr<Blob<Dtype> > flat_params_;
+  /// Keeps the memory of flat_params_ alive once it is no longer used as a
+  /// whole, as the params not shared from another net still point into it
+  shared_ptr<Blob<Dtype> > flat_storage_;
+  /// The weights files that the params may point into
+  vector<shared_ptr<MappedWeights> > mapped_weights_;
+  /// The weights shared with other nets, if any
+  shared_ptr<NetWeights<Dtype> > weights_;
   /**
    * The mapping from params_ -> learnable_params_: we have
    * learnable_param_ids_.size() == params_.size(),
@@ -330,6 +418,8 @@ class Net {
   vector<bool> has_params_decay_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// The bytes that each layer allocated besides its blobs
+  vector<int64_t> layer_internal_bytes_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
   // Callbacks
@@ -337,6 +427,8 @@ class Net {
   vector<Callback*> after_forward_;
   vector<Callback*> before_backward_;
   vector<Callback*> after_backward_;
+  /// Records the layers run, if set
+  shared_ptr<NetTracer> tracer_;
 
   /// Memory optimization related stuff.
   bool optimize_memory_;
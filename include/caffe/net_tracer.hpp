@@ -0,0 +1,86 @@
+#ifndef CAFFE_NET_TRACER_HPP_
+#define CAFFE_NET_TRACER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/perf_counters.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Records the layers that Nets run into a ring buffer, to sample the
+ *        latency breakdown of a net serving real traffic.
+ *
+ * A Net given a tracer (Net::set_tracer) records each layer it runs in
+ * ForwardFromTo and BackwardFromTo: when it started and ended, on which
+ * thread and on which bottom shapes. Once the buffer is full, each record
+ * overwrites the oldest one, so the tracer holds the last capacity() layers
+ * run and records without allocating. A Net without a tracer only tests
+ * that it has none. One tracer can be shared by the nets of several threads.
+ *
+ * A tracer that counts events also records the hardware events (see
+ * PerfCounters) of the thread while each layer ran, at the cost of reading
+ * the counters twice per layer.
+ */
+class NetTracer {
+ public:
+  struct Record {
+    string layer_name;
+    int layer;
+    bool backward;
+    /// Microseconds since the Unix epoch
+    int64_t start, end;
+    /// A hash of the id of the thread that ran the layer
+    size_t thread;
+    /// The number of axes of each bottom followed by its shape
+    vector<int> bottom_shapes;
+    /// The count of each PerfCounters event while the layer ran, or -1
+    int64_t counts[PerfCounters::NUM_EVENTS];
+  };
+  /// @brief The time and counts of events when a layer started.
+  struct Start {
+    int64_t time;
+    int64_t counts[PerfCounters::NUM_EVENTS];
+  };
+
+  explicit NetTracer(int capacity, bool count_events = false);
+
+  /// @brief The current time, in microseconds since the Unix epoch.
+  static int64_t Now();
+
+  /// @brief Marks the start of a layer run by the calling thread.
+  void Begin(Start* start) const;
+  /// @brief Records a layer that ran from start until now on bottom.
+  template <typename Dtype>
+  void Add(const string& layer_name, int layer, bool backward,
+      const Start& start, const vector<Blob<Dtype>*>& bottom);
+
+  /// @brief Copies the records held, oldest first.
+  void Records(vector<Record>* records) const;
+  /// @brief Drops the records held.
+  void Clear();
+
+  inline int capacity() const { return records_.size(); }
+  inline bool count_events() const { return count_events_; }
+  /// @brief The number of layers recorded since the last Clear, including
+  ///        those overwritten since.
+  int64_t recorded() const;
+
+ protected:
+  // Keeps boost/thread.hpp out of this header, like BlockingQueue.
+  class sync;
+
+  vector<Record> records_;
+  int64_t recorded_;
+  bool count_events_;
+  shared_ptr<sync> sync_;
+
+  DISABLE_COPY_AND_ASSIGN(NetTracer);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NET_TRACER_HPP_
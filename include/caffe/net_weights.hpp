@@ -0,0 +1,58 @@
+#ifndef CAFFE_NET_WEIGHTS_HPP_
+#define CAFFE_NET_WEIGHTS_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Trained weights loaded once, which any number of Nets can be
+ *        constructed with instead of allocating and filling their own params.
+ *
+ * The params of the layers named in the weights share their data with the
+ * weights (see Blob::ShareData); the other layers are initialized as usual.
+ * Nets constructed with the same weights can run Forward concurrently on
+ * separate threads in CPU mode, as the shared data is only read. Backward
+ * and Update write to the params, and GPU mode copies them to the device on
+ * first use, so they must not run concurrently on such nets. Each thread
+ * sets its own Caffe mode, as Caffe's state is per thread.
+ */
+template <typename Dtype>
+class NetWeights {
+ public:
+  /// @brief Loads a .caffemodel, HDF5 or mapped weights file.
+  explicit NetWeights(const string& trained_filename);
+
+  /**
+   * @brief Makes blobs share the data of the weights of a layer. Returns
+   *        false, leaving blobs as they were, if there are none.
+   */
+  bool Share(const string& layer_name,
+             vector<shared_ptr<Blob<Dtype> > >* blobs) const;
+
+  inline const map<string, vector<shared_ptr<Blob<Dtype> > > >& layers()
+      const {
+    return layers_;
+  }
+
+ protected:
+  void LoadBinaryProto(const string& trained_filename);
+  void LoadHDF5(const string& trained_filename);
+  void LoadMapped(const string& trained_filename);
+
+  map<string, vector<shared_ptr<Blob<Dtype> > > > layers_;
+  /// The weights file that the blobs may point into
+  shared_ptr<MappedWeights> mapped_weights_;
+
+  DISABLE_COPY_AND_ASSIGN(NetWeights);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NET_WEIGHTS_HPP_
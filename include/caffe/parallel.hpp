@@ -1,8 +1,6 @@
 #ifndef CAFFE_PARALLEL_HPP_
 #define CAFFE_PARALLEL_HPP_
 
-#ifdef USE_NCCL
-
 #include <boost/thread.hpp>
 
 #include <string>
@@ -16,7 +14,10 @@
 #include "caffe/solver.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/transport.hpp"
+#ifdef USE_NCCL
 #include "caffe/util/nccl.hpp"
+#endif
 
 namespace caffe {
 
@@ -48,6 +49,118 @@ class Params {
 DISABLE_COPY_AND_ASSIGN(Params);
 };
 
+// Params stored in host memory.
+template<typename Dtype>
+class CPUParams : public Params<Dtype> {
+ public:
+  explicit CPUParams(shared_ptr<Solver<Dtype> > root_solver);
+  virtual ~CPUParams();
+
+  void Configure(Solver<Dtype>* solver) const;
+
+ protected:
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+// Data parallel training of CPU solvers running in threads of one process.
+// Gradients are averaged through shared memory, each solver summing a slice
+// of the buffers of all others.
+template<typename Dtype>
+class CPUSync : public CPUParams<Dtype>,
+                public Solver<Dtype>::Callback,
+                public Net<Dtype>::Callback {
+ public:
+  explicit CPUSync(shared_ptr<Solver<Dtype> > solver);
+
+  /**
+   * Connects the solvers, where syncs[i] is the one of rank i. The barrier
+   * must be shared by all of them.
+   */
+  void set_peers(vector<CPUSync<Dtype>*>* syncs, boost::barrier* barrier);
+
+  /**
+   * Broadcast weights from rank 0 other solvers.
+   */
+  void Broadcast();
+
+  /**
+   * Runs the solver and threads replicas of it, Caffe::solver_count() in
+   * total.
+   */
+  void Run(const char* restore);
+
+ protected:
+  void on_start() {}
+  void run(int layer);  // Net callback
+  void on_gradients_ready();
+  // Averages diffs [offset, offset + count) over all solvers.
+  void Allreduce(size_t offset, size_t count);
+
+  shared_ptr<Solver<Dtype> > solver_;
+  vector<CPUSync<Dtype>*>* syncs_;
+  boost::barrier* barrier_;
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+// Data parallel training of CPU solvers in separate processes, possibly on
+// different machines, averaging gradients with a ring allreduce over a
+// Transport. With layer_wise_reduce, the gradients of each layer are reduced
+// on a thread as soon as its backward is done, overlapping communication
+// with the backward of the layers below.
+template<typename Dtype>
+class RingSync : public CPUParams<Dtype>,
+                 public Solver<Dtype>::Callback,
+                 public Net<Dtype>::Callback,
+                 public InternalThread {
+ public:
+  /**
+   * The transport rank and size must match Caffe::solver_rank() and
+   * Caffe::solver_count().
+   */
+  RingSync(shared_ptr<Solver<Dtype> > solver,
+           shared_ptr<Transport> transport);
+  ~RingSync();
+
+  /**
+   * Broadcast weights from rank 0 other solvers.
+   */
+  void Broadcast();
+
+  /**
+   * Broadcasts the weights and runs the solver, in each process.
+   */
+  void Run();
+
+ protected:
+  void on_start() {}
+  void run(int layer);  // Net callback
+  void on_gradients_ready();
+  void InternalThreadEntry();
+  // Averages diffs [offset, offset + count) over all solvers.
+  void Allreduce(size_t offset, size_t count);
+
+  shared_ptr<Solver<Dtype> > solver_;
+  shared_ptr<Transport> transport_;
+  // Position and size of the gradients of each layer in diff_
+  vector<size_t> layer_offsets_;
+  vector<size_t> layer_counts_;
+  // Layers handed to the reduction thread, and those it has reduced
+  BlockingQueue<int> reduce_queue_;
+  BlockingQueue<int> reduced_queue_;
+  int pending_;
+  // Receives the partial sums of Allreduce, which only one thread runs
+  vector<Dtype> reduce_buffer_;
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
+#ifdef USE_NCCL
+
 // Params stored in GPU memory.
 template<typename Dtype>
 class GPUParams : public Params<Dtype> {
@@ -117,7 +230,8 @@ class NCCL : public GPUParams<Dtype>,
   using Params<Dtype>::diff_;
 };
 
+#endif  // USE_NCCL
+
 }  // namespace caffe
 
-#endif  // USE_NCCL
 #endif  // header
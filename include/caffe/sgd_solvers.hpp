@@ -19,6 +19,8 @@ class SGDSolver : public Solver<Dtype> {
       : Solver<Dtype>(param) { PreSolve(); }
   explicit SGDSolver(const string& param_file)
       : Solver<Dtype>(param_file) { PreSolve(); }
+  // The snapshot thread may still be writing staged_history_.
+  virtual ~SGDSolver() { this->WaitForSnapshot(); }
   virtual inline const char* type() const { return "SGD"; }
 
   const vector<shared_ptr<Blob<Dtype> > >& history() { return history_; }
@@ -30,10 +32,25 @@ class SGDSolver : public Solver<Dtype> {
   virtual void Normalize(int param_id);
   virtual void Regularize(int param_id);
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  // Updates param_id on the CPU in a single pass over its values, doing
+  // Normalize, L2 Regularize, ComputeUpdateValue and the weight update at
+  // once. Solvers overriding ComputeUpdateValue must override this too.
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
+  Dtype LocalDecay(int param_id) const;
   virtual void ClipGradients();
   virtual void SnapshotSolverState(const string& model_filename);
-  virtual void SnapshotSolverStateToBinaryProto(const string& model_filename);
-  virtual void SnapshotSolverStateToHDF5(const string& model_filename);
+  virtual void StageSolverState();
+  virtual string SnapshotStagedSolverState(const string& model_filename);
+  // Write the given iter, current_step and history as the solver state, and
+  // return the name of the file written.
+  string SnapshotSolverState(const string& model_filename, int iter,
+      int current_step, const vector<shared_ptr<Blob<Dtype> > >& history);
+  virtual string SnapshotSolverStateToBinaryProto(
+      const string& model_filename, int iter, int current_step,
+      const vector<shared_ptr<Blob<Dtype> > >& history);
+  virtual string SnapshotSolverStateToHDF5(
+      const string& model_filename, int iter, int current_step,
+      const vector<shared_ptr<Blob<Dtype> > >& history);
   virtual void RestoreSolverStateFromHDF5(const string& state_file);
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file);
   // history maintains the historical momentum data.
@@ -41,6 +58,9 @@ class SGDSolver : public Solver<Dtype> {
   // temp maintains other information that might be needed in computation
   //   of gradients/updates and is not needed in snapshots
   vector<shared_ptr<Blob<Dtype> > > history_, update_, temp_;
+  // Copies of current_step_ and history_ for snapshot_async
+  int staged_current_step_;
+  vector<shared_ptr<Blob<Dtype> > > staged_history_;
 
   DISABLE_COPY_AND_ASSIGN(SGDSolver);
 };
@@ -56,6 +76,7 @@ class NesterovSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(NesterovSolver);
 };
@@ -71,6 +92,7 @@ class AdaGradSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with AdaGrad.";
@@ -91,6 +113,7 @@ class RMSPropSolver : public SGDSolver<Dtype> {
 
  protected:
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
   void constructor_sanity_check() {
     CHECK_EQ(0, this->param_.momentum())
         << "Momentum cannot be used with RMSProp.";
@@ -115,6 +138,7 @@ class AdaDeltaSolver : public SGDSolver<Dtype> {
  protected:
   void AdaDeltaPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(AdaDeltaSolver);
 };
@@ -139,6 +163,7 @@ class AdamSolver : public SGDSolver<Dtype> {
  protected:
   void AdamPreSolve();
   virtual void ComputeUpdateValue(int param_id, Dtype rate);
+  virtual void ComputeFusedUpdate(int param_id, Dtype rate);
 
   DISABLE_COPY_AND_ASSIGN(AdamSolver);
 };
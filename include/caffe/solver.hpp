@@ -8,6 +8,8 @@
 #include "caffe/solver_factory.hpp"
 #include "caffe/util/benchmark.hpp"
 
+namespace boost { class thread; }
+
 namespace caffe {
 
 /**
@@ -65,8 +67,12 @@ class Solver {
   // that stores the learned net. You should implement the SnapshotSolverState()
   // function that produces a SolverState protocol buffer that needs to be
   // written to disk together with the learned net.
+  //
+  // With snapshot_async, Snapshot only copies the state aside and returns
+  // while another thread writes it; WaitForSnapshot waits for that write.
   void Snapshot();
-  virtual ~Solver() {}
+  void WaitForSnapshot();
+  virtual ~Solver();
   inline const SolverParameter& param() const { return param_; }
   inline shared_ptr<Net<Dtype> > net() { return net_; }
   inline const vector<shared_ptr<Net<Dtype> > >& test_nets() {
@@ -98,12 +104,22 @@ class Solver {
   // Make and apply the update value for the current iteration.
   virtual void ApplyUpdate() = 0;
   string SnapshotFilename(const string extension);
+  string SnapshotFilename(const string extension, int iter);
   string SnapshotToBinaryProto();
   string SnapshotToHDF5();
+  // Copies the params and solver state for WriteSnapshot.
+  void StageSnapshot();
+  // Writes the state copied by StageSnapshot, on the snapshot thread.
+  void WriteSnapshot();
   // The test routine
   void TestAll();
   void Test(const int test_net_id = 0);
   virtual void SnapshotSolverState(const string& model_filename) = 0;
+  // Copy the solver state on the training thread, and write that copy from
+  // the snapshot thread (returning the name of the solver state file), to
+  // support snapshot_async.
+  virtual void StageSolverState() = 0;
+  virtual string SnapshotStagedSolverState(const string& model_filename) = 0;
   virtual void RestoreSolverStateFromHDF5(const string& state_file) = 0;
   virtual void RestoreSolverStateFromBinaryProto(const string& state_file) = 0;
   void DisplayOutputBlobs(const int net_id);
@@ -125,6 +141,12 @@ class Solver {
   // True iff a request to stop early was received.
   bool requested_early_exit_;
 
+  // The snapshot being written with snapshot_async, and its copy of the
+  // iteration and net params.
+  shared_ptr<boost::thread> snapshot_thread_;
+  int snapshot_iter_;
+  vector<shared_ptr<Blob<Dtype> > > snapshot_params_;
+
   // Timing information, handy to tune e.g. nbr of GPUs
   Timer iteration_timer_;
   float iterations_last_;
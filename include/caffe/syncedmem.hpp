@@ -68,6 +68,20 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /**
+   * @brief A count that changes whenever the data may have been written to,
+   *        through the mutable accessors or by setting or resizing it.
+   */
+  size_t version() const { return version_; }
+  /// @brief The bytes of host and device memory that this points to.
+  size_t allocated_size() const {
+    return (cpu_ptr_ ? size_ : 0) + (gpu_ptr_ ? size_ : 0);
+  }
+  /**
+   * @brief The bytes that SyncedMemory allocated less those it freed on the
+   *        calling thread, to measure the memory that code allocates.
+   */
+  static int64_t thread_allocated_bytes();
 
   void Resize(size_t new_size);
 #ifndef CPU_ONLY
@@ -76,6 +90,8 @@ class SyncedMemory {
 
  private:
   void check_device();
+  // Adds bytes to the allocated bytes of the calling thread.
+  static void CountAllocated(int64_t bytes);
 
   void to_cpu();
   void to_gpu();
@@ -87,6 +103,7 @@ class SyncedMemory {
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
   int device_;
+  size_t version_;
 
   DISABLE_COPY_AND_ASSIGN(SyncedMemory);
 };  // class SyncedMemory
@@ -0,0 +1,95 @@
+#ifndef CAFFE_TILED_NET_HPP_
+#define CAFFE_TILED_NET_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_weights.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Runs the fully convolutional trunk of a net on overlapping tiles of
+ *        an image, then the rest of the net (e.g. an ROI pooling head) once
+ *        on the stitched feature map, so that the memory the trunk needs is
+ *        bounded by the tile size rather than the image size.
+ *
+ * The trunk is the layers that the feature blob depends on, by default the
+ * input of the first ROI pooling layer. From their kernels, strides and
+ * padding it derives the receptive field of the features (like
+ * python/caffe/coord_map.py), and overlaps the tiles so that each feature is
+ * taken from a tile that holds all of its receptive field, or that reaches
+ * the border of the image like the whole image does. The stitched features
+ * are then the same as those of the whole image.
+ */
+template <typename Dtype>
+class TiledNet {
+ public:
+  /**
+   * @param param the net, which should be in the TEST phase
+   * @param weights the trained weights of the net; without them, the trunk
+   *        shares the params that the whole net initialized.
+   */
+  TiledNet(const TilingParameter& tiling_param, const NetParameter& param,
+      shared_ptr<NetWeights<Dtype> > weights =
+          shared_ptr<NetWeights<Dtype> >());
+
+  /**
+   * @brief Runs the net on image, which is N x C x H x W; the other inputs of
+   *        the net (e.g. rois) are set on net() beforehand.
+   *
+   * @return the outputs of the net
+   */
+  const vector<Blob<Dtype>*>& Forward(const Blob<Dtype>& image);
+
+  /// @brief The whole net, whose trunk layers are not run.
+  inline shared_ptr<Net<Dtype> > net() const { return net_; }
+  /// @brief The trunk, which is run on each tile.
+  inline shared_ptr<Net<Dtype> > trunk() const { return trunk_; }
+  /**
+   * @brief The receptive field of the features along the height (axis 0) or
+   *        width (axis 1): feature i sees the input from i * stride - pad to
+   *        i * stride - pad + size - 1.
+   */
+  inline int stride(int axis) const { return stride_[axis]; }
+  inline int pad(int axis) const { return pad_[axis]; }
+  inline int size(int axis) const { return size_[axis]; }
+
+ protected:
+  // A range of input rows (or columns) run as a tile, and the range of
+  // feature rows taken from it.
+  struct Tile {
+    int begin, end;
+    int feature_begin, feature_end;
+  };
+
+  // Computes the receptive field of the features from the trunk layers.
+  void InitReceptiveField();
+  // Splits length input rows (or columns) into tiles along axis. The
+  // feature_end of the last tile is left to the output of the trunk.
+  void Split(int axis, int length, vector<Tile>* tiles) const;
+  // Runs the trunk on a tile of image, returning its features.
+  const Blob<Dtype>& RunTrunk(const Blob<Dtype>& image, const Tile& row,
+      const Tile& col);
+  // Copies the features taken from a tile into the features of the net.
+  void Stitch(const Blob<Dtype>& tile_features, const Tile& row,
+      const Tile& col);
+
+  TilingParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+  shared_ptr<Net<Dtype> > trunk_;
+  string feature_blob_;
+  // The layers of net_ that are not in the trunk, which Forward runs
+  vector<int> head_layers_;
+  int stride_[2], pad_[2], size_[2];
+
+  DISABLE_COPY_AND_ASSIGN(TiledNet);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_TILED_NET_HPP_
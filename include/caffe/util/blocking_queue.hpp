@@ -15,6 +15,9 @@ class BlockingQueue {
 
   bool try_pop(T* t);
 
+  // Like try_pop, but waits up to timeout_us for an element
+  bool try_pop(T* t, int timeout_us);
+
   // This logs a message if the threads needs to be blocked
   // useful for detecting e.g. when data feeding is too slow
   T pop(const string& log_on_wait = "");
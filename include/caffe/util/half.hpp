@@ -0,0 +1,139 @@
+#ifndef CAFFE_UTIL_HALF_HPP_
+#define CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Conversions between float and the 16 bit IEEE half (fp16) and bfloat16
+// (bf16) formats, rounding to nearest even.
+inline uint16_t float_to_bf16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffff) > 0x7f800000) {
+    return (bits >> 16) | 0x40;  // Keep NaNs quiet
+  }
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return bits >> 16;
+}
+
+inline float bf16_to_float(uint16_t value) {
+  const uint32_t bits = static_cast<uint32_t>(value) << 16;
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline uint16_t float_to_fp16(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  bits &= 0x7fffffff;
+  if (bits >= 0x7f800000) {
+    return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0);
+  }
+  if (bits >= 0x477ff000) {
+    return sign | 0x7c00;  // Rounds past 65504
+  }
+  if (bits < 0x38800000) {
+    // Below 2^-14, the result is subnormal or zero.
+    if (bits < 0x33000000) {
+      return sign;
+    }
+    const int shift = 126 - static_cast<int>(bits >> 23);
+    const uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1);
+    const uint32_t tie = 1u << (shift - 1);
+    if (rest > tie || (rest == tie && (half & 1))) {
+      ++half;
+    }
+    return sign | half;
+  }
+  uint32_t half = (bits >> 13) - (112 << 10);
+  const uint32_t rest = bits & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    ++half;
+  }
+  return sign | half;
+}
+
+inline float fp16_to_float(uint16_t value) {
+  const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Normalize the subnormal value.
+    exponent = 113;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+/**
+ * @brief A row-major matrix kept in fp16 or bf16, half the size of a float
+ *        one, and multiplied in Dtype precision.
+ *
+ * The products convert a tile of rows at a time to Dtype, small enough to
+ * stay in cache, so that they read the matrix from memory at 2 bytes per
+ * value. This is how Convolution and InnerProduct layers keep their weights
+ * for LayerParameter weight_precision.
+ */
+template <typename Dtype>
+class HalfMatrix {
+ public:
+  HalfMatrix() : rows_(0), cols_(0), bf16_(false) {}
+
+  // Keeps a copy of the rows x cols matrix data, in bf16 if bf16 is set and
+  // in fp16 otherwise.
+  void Pack(const Dtype* data, int rows, int cols, bool bf16);
+  void Clear();
+  inline bool empty() const { return values_.empty(); }
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+
+  // Writes count rows starting at row to data.
+  void Unpack(int row, int count, Dtype* data) const;
+
+  // C = A * op(W), where A has M rows, as caffe_cpu_gemm would compute with
+  // this matrix as B.
+  void Gemm(const CBLAS_TRANSPOSE TransW, const int M, const Dtype* A,
+      Dtype* C);
+  // C = W[row, row + count) * B, where B has N columns.
+  void GemmRows(const int row, const int count, const int N, const Dtype* B,
+      Dtype* C);
+
+ protected:
+  // The number of rows converted at once
+  int tile_rows() const;
+
+  int rows_;
+  int cols_;
+  bool bf16_;
+  vector<uint16_t> values_;
+  vector<Dtype> tile_;
+
+  DISABLE_COPY_AND_ASSIGN(HalfMatrix);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_HPP_
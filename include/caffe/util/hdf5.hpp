@@ -10,6 +10,23 @@
 
 namespace caffe {
 
+/**
+ * @brief Serializes the calls into the HDF5 library, which is usually built
+ *        without thread safety, while it is in scope.
+ *
+ * Hold one from opening an HDF5 file until closing it, and around each
+ * read or write of a file kept open. The lock is recursive, so a function
+ * holding it may call another that takes it too.
+ */
+class HDF5Lock {
+ public:
+  HDF5Lock();
+  ~HDF5Lock();
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(HDF5Lock);
+};
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
@@ -20,6 +37,16 @@ void hdf5_load_nd_dataset(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob, bool reshape = false);
 
+// Returns the size of the first axis of a dataset, i.e. its number of rows.
+hsize_t hdf5_get_num_rows(hid_t file_id, const char* dataset_name_);
+
+// Loads rows [row_start, row_start + num_rows) of a dataset as a hyperslab,
+// reshaping the blob to num_rows along the first axis.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, hsize_t row_start,
+    hsize_t num_rows, Blob<Dtype>* blob);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
@@ -31,6 +58,9 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name);
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s);
 
+// Whether filename is an HDF5 file, under the HDF5Lock.
+bool hdf5_is_file(const string& filename);
+
 int hdf5_get_num_links(hid_t loc_id);
 string hdf5_get_name_by_idx(hid_t loc_id, int idx);
 
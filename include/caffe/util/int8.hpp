@@ -0,0 +1,70 @@
+#ifndef CAFFE_UTIL_INT8_HPP_
+#define CAFFE_UTIL_INT8_HPP_
+
+#include <stdint.h>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A row-major matrix quantized to int8 with a scale per row, which
+ *        multiplies int8 quantized inputs with int32 accumulation.
+ *
+ * Each row is an output channel: row i holds round(W_i / s_i) where s_i is
+ * the largest |W_i| over 127. The inputs are quantized the same way with a
+ * single scale, given by a calibrated range or by the largest input value.
+ * This is how Convolution and InnerProduct layers run for LayerParameter
+ * weight_precision INT8.
+ *
+ * The rows are zero padded to a multiple of 16 columns, and the inputs are
+ * widened to int16, so that with SSE2 the products are summed 8 at a time
+ * with _mm_madd_epi16.
+ */
+template <typename Dtype>
+class Int8Matrix {
+ public:
+  Int8Matrix() : rows_(0), cols_(0), stride_(0) {}
+
+  // Quantizes the rows x cols matrix data, or if trans is set the matrix
+  // whose transpose is the cols x rows matrix data.
+  void Pack(const Dtype* data, int rows, int cols, bool trans);
+  void Clear();
+  inline bool empty() const { return values_.empty(); }
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  inline Dtype scale(int row) const { return scales_[row]; }
+
+  // C = A * W^T, where A has M rows. The inputs are quantized to the range
+  // [-range, range], or to their largest absolute value if range is 0.
+  void Gemm(const int M, const Dtype* A, const Dtype range, Dtype* C);
+  // C = W[row, row + count) * B, where B has N columns, with the inputs
+  // quantized as in Gemm.
+  void GemmRows(const int row, const int count, const int N, const Dtype* B,
+      const Dtype range, Dtype* C);
+
+ protected:
+  // Quantizes the M x cols_ inputs A, or the cols_ x M inputs if trans is
+  // set, to the rows of input_, and returns their scale.
+  Dtype QuantizeInput(const int M, const Dtype* A, const bool trans,
+      const Dtype range);
+  // Writes the products of input_ with W[row, row + count) to C, as
+  // M x count if trans_C is not set and as count x M if it is.
+  void Multiply(const int row, const int count, const int M,
+      const Dtype input_scale, const bool trans_C, Dtype* C) const;
+
+  int rows_;
+  int cols_;
+  // The padded length of the rows of values_ and input_
+  int stride_;
+  vector<int8_t> values_;
+  vector<Dtype> scales_;
+  vector<int16_t> input_;
+
+  DISABLE_COPY_AND_ASSIGN(Int8Matrix);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INT8_HPP_
@@ -0,0 +1,70 @@
+#ifndef CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A weights file mapped into memory, which a Net can point its params
+ *        at without parsing or copying them.
+ *
+ * The file holds a header, a table of the tensors and their raw float data
+ * in host byte order, each at an offset aligned to kAlignment:
+ *
+ *     "CAFFEWTS", uint32 version, uint32 tensor count, uint64 data offset
+ *     per tensor: uint32 layer name length, layer name, uint32 blob index,
+ *                 uint32 axes, int32 dims[axes], uint64 offset
+ *     data
+ *
+ * The mapping is private, so writes to the params (e.g. when finetuning)
+ * copy the pages they touch instead of changing the file.
+ */
+class MappedWeights {
+ public:
+  struct Tensor {
+    string layer;
+    int index;
+    vector<int> shape;
+    float* data;
+  };
+
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  inline const string& filename() const { return filename_; }
+  inline const vector<Tensor>& tensors() const { return tensors_; }
+
+  /// @brief Returns whether filename starts like a weights file.
+  static bool IsWeightsFile(const string& filename);
+  /// @brief Writes the blobs of the layers of param to a weights file.
+  static void Write(const NetParameter& param, const string& filename);
+
+  static const int kAlignment = 64;
+
+ protected:
+  string filename_;
+  void* data_;
+  size_t size_;
+  vector<Tensor> tensors_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+/**
+ * @brief Loads a mapped tensor into a blob of the same shape: points the
+ *        blob at the mapped data if share is set and Dtype is float, and
+ *        copies the data otherwise.
+ */
+template <typename Dtype>
+void load_mapped_tensor(const MappedWeights::Tensor& tensor, bool share,
+    Blob<Dtype>* blob);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
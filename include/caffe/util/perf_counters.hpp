@@ -0,0 +1,55 @@
+#ifndef CAFFE_UTIL_PERF_COUNTERS_HPP_
+#define CAFFE_UTIL_PERF_COUNTERS_HPP_
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Counts hardware events of the calling thread with perf_event_open,
+ *        to tell whether a layer is bound by compute or by memory.
+ *
+ * The counters only exist on Linux, and only where the kernel and the CPU
+ * support them and perf_event_paranoid lets the process open them (in
+ * user space only); virtual machines and containers often do not. Events
+ * that cannot be counted read as -1, so callers carry on without them.
+ */
+class PerfCounters {
+ public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    // Last level cache references and misses
+    CACHE_REFERENCES,
+    CACHE_MISSES,
+    NUM_EVENTS
+  };
+
+  /// @brief Opens and starts the counters of the calling thread.
+  PerfCounters();
+  ~PerfCounters();
+
+  /// @brief The counters of the calling thread, opened on first use.
+  static PerfCounters* ForThread();
+  /// @brief The name of event, e.g. "cycles".
+  static const char* name(int event);
+
+  inline bool available(int event) const { return fds_[event] >= 0; }
+  inline bool any_available() const { return leader_ >= 0; }
+  /**
+   * @brief Reads the count of each event since the counters were opened
+   *        into counts, which holds NUM_EVENTS; -1 if it is not counted.
+   */
+  void Read(int64_t* counts) const;
+
+ protected:
+  // The counters, read together through the group leader
+  int fds_[NUM_EVENTS];
+  int leader_;
+
+  DISABLE_COPY_AND_ASSIGN(PerfCounters);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PERF_COUNTERS_HPP_
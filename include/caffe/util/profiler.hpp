@@ -0,0 +1,106 @@
+#ifndef CAFFE_UTIL_PROFILER_HPP_
+#define CAFFE_UTIL_PROFILER_HPP_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <ostream>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/perf_counters.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Collects the timings of the layers of a Net, as run by `caffe time`,
+ *        together with estimates of the work each layer does, and writes
+ *        them as JSON or as a Chrome trace (chrome://tracing or Perfetto).
+ *
+ * The estimates count a multiply-add as two FLOPs, and the memory traffic
+ * as each bottom, top and param blob of the layer read or written once, so
+ * they are lower bounds meant for comparing layers and model revisions
+ * rather than exact counts.
+ */
+template <typename Dtype>
+class NetProfiler {
+ public:
+  /// @brief The distribution of the times of a layer or pass, in ms.
+  struct Stats {
+    int count;
+    double mean, min, median, p99;
+  };
+  /// @brief The estimated work of one forward and backward of a layer.
+  struct Cost {
+    int64_t forward_flops, backward_flops;
+    int64_t forward_bytes, backward_bytes;
+    // The memory held by the tops the layer does not compute in place and
+    // by its params
+    int64_t allocated_bytes;
+  };
+
+  /// @brief Profiles net, estimating its costs at its current shapes.
+  explicit NetProfiler(const Net<Dtype>& net);
+
+  /// @brief The microseconds since the profiler was created.
+  double Now() const;
+  /// @brief Records a forward (or backward) of layer that started at start,
+  ///        as given by Now(), and took duration microseconds.
+  void AddLayer(int layer, bool backward, double start, double duration);
+  /// @brief Records a forward (or backward) pass of the whole net.
+  void AddPass(bool backward, double start, double duration);
+  /**
+   * @brief Records the count of each PerfCounters event over a forward (or
+   *        backward) of layer, or -1 for the events not counted.
+   */
+  void AddCounts(int layer, bool backward, const int64_t* counts);
+  /// @brief The mean count of an event per forward (or backward) of layer,
+  ///        or -1 if it was not counted.
+  double MeanCount(int layer, bool backward, int event) const;
+  /// @brief Re-estimates the costs, e.g. after the net was reshaped.
+  void Estimate();
+
+  /// @brief Logs the times and costs of each layer.
+  void Log() const;
+  /// @brief Writes the stats and costs of each layer as a JSON object.
+  void WriteJSON(std::ostream* os) const;
+  /// @brief Writes each recorded forward and backward as a trace event.
+  void WriteTrace(std::ostream* os) const;
+
+  inline const Cost& cost(int layer) const { return costs_[layer]; }
+  Stats LayerStats(int layer, bool backward) const;
+  Stats PassStats(bool backward) const;
+
+  /// @brief Summarizes times in microseconds; p99 is the nearest rank.
+  static Stats Summarize(const vector<float>& times);
+  /// @brief Estimates the work of a layer on the given bottoms and tops.
+  static Cost EstimateCost(Layer<Dtype>* layer,
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top);
+
+ protected:
+  struct Event {
+    int layer;  // -1 for a whole pass
+    bool backward;
+    float start, duration;
+  };
+
+  const Net<Dtype>& net_;
+  boost::posix_time::ptime start_;
+  vector<Cost> costs_;
+  // The microseconds of each forward and backward of each layer
+  vector<vector<float> > forward_times_, backward_times_;
+  vector<float> forward_pass_times_, backward_pass_times_;
+  vector<Event> events_;
+  // The sums of the counts of each event over the forwards and backwards
+  // of each layer, -1 if not counted, and the number of runs counted
+  vector<vector<int64_t> > forward_counts_, backward_counts_;
+  vector<int> forward_counted_, backward_counted_;
+
+  DISABLE_COPY_AND_ASSIGN(NetProfiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_PROFILER_HPP_
@@ -0,0 +1,76 @@
+#ifndef CAFFE_UTIL_TRANSPORT_HPP_
+#define CAFFE_UTIL_TRANSPORT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Connects the processes of a data parallel job in a ring, each one
+ *        exchanging messages with its two neighbors.
+ */
+class Transport {
+ public:
+  Transport(int rank, int size) : rank_(rank), size_(size) {}
+  virtual ~Transport() {}
+
+  inline int rank() const { return rank_; }
+  inline int size() const { return size_; }
+
+  // Sends send_bytes to the next process in the ring while receiving
+  // recv_bytes from the previous one, so that all processes can send at once.
+  virtual void SendRecv(const void* send, size_t send_bytes,
+                        void* recv, size_t recv_bytes) = 0;
+
+ protected:
+  const int rank_;
+  const int size_;
+
+  DISABLE_COPY_AND_ASSIGN(Transport);
+};
+
+/**
+ * @brief A Transport over stream sockets, given the address of each process
+ *        as "tcp://host:port" or "unix:///path/to/socket".
+ *
+ * Each process listens on its own address and connects to the next one.
+ * Processes can start in any order; connecting is retried for a minute.
+ */
+class SocketTransport : public Transport {
+ public:
+  SocketTransport(const vector<string>& addresses, int rank);
+  virtual ~SocketTransport();
+
+  virtual void SendRecv(const void* send, size_t send_bytes,
+                        void* recv, size_t recv_bytes);
+
+ protected:
+  string address_;
+  int next_;  // Socket to the next process
+  int prev_;  // Socket from the previous process
+};
+
+/**
+ * @brief Sums count values of data over all processes of the transport, in
+ *        place, with a ring reduce-scatter followed by a ring all-gather.
+ *        Every process sends and receives 2 (size - 1) / size of the data.
+ *
+ * buffer receives the partial sums; pass the same one to each call so that
+ * its memory is reused.
+ */
+template <typename Dtype>
+void ring_allreduce(Transport* transport, Dtype* data, size_t count,
+                    vector<Dtype>* buffer);
+
+/**
+ * @brief Copies count values of data from rank 0 to all other processes.
+ */
+template <typename Dtype>
+void ring_broadcast(Transport* transport, Dtype* data, size_t count);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_TRANSPORT_HPP_
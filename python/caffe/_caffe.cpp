@@ -5,6 +5,7 @@
 
 #include <boost/make_shared.hpp>
 #include <boost/python.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/python/raw_function.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 #include <numpy/arrayobject.h>
@@ -47,9 +48,54 @@ namespace caffe {
 typedef float Dtype;
 const int NPY_DTYPE = NPY_FLOAT32;
 
+// Caffe's state is per thread. Each Python thread starts out with the mode
+// and device last set from Python, on whichever thread.
+static Caffe::Brew default_mode = Caffe::CPU;
+static int default_device = -1;
+static boost::thread_specific_ptr<bool> thread_initialized;
+
+static void InitThread() {
+  if (thread_initialized.get()) {
+    return;
+  }
+  thread_initialized.reset(new bool(true));
+  if (default_device >= 0) {
+    Caffe::SetDevice(default_device);
+  }
+  Caffe::set_mode(default_mode);
+}
+
+// Releases the GIL for its scope, so that other Python threads run while
+// Caffe computes. Native code takes it back to call into Python (see
+// PyGILLock).
+class ScopedGILRelease {
+ public:
+  ScopedGILRelease() {
+    InitThread();
+    state_ = PyEval_SaveThread();
+  }
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+ private:
+  PyThreadState* state_;
+};
+
 // Selecting mode.
-void set_mode_cpu() { Caffe::set_mode(Caffe::CPU); }
-void set_mode_gpu() { Caffe::set_mode(Caffe::GPU); }
+void set_mode_cpu() {
+  InitThread();
+  default_mode = Caffe::CPU;
+  Caffe::set_mode(Caffe::CPU);
+}
+void set_mode_gpu() {
+  InitThread();
+  default_mode = Caffe::GPU;
+  Caffe::set_mode(Caffe::GPU);
+}
+void set_device(int device_id) {
+  InitThread();
+  default_device = device_id;
+  Caffe::SetDevice(device_id);
+}
 
 void InitLog() {
   ::google::InitGoogleLogging("");
@@ -120,6 +166,7 @@ shared_ptr<Net<Dtype> > Net_Init(string network_file, int phase,
   }
 
   // Initialize net
+  InitThread();
   shared_ptr<Net<Dtype> > net(new Net<Dtype>(network_file,
         static_cast<Phase>(phase), level, &stages_vector));
 
@@ -144,12 +191,43 @@ shared_ptr<Net<Dtype> > Net_Init_Load(
   CheckFile(param_file);
   CheckFile(pretrained_param_file);
 
+  InitThread();
   shared_ptr<Net<Dtype> > net(new Net<Dtype>(param_file,
       static_cast<Phase>(phase)));
   net->CopyTrainedLayersFrom(pretrained_param_file);
   return net;
 }
 
+// Native compute, run without the GIL.
+Dtype Net_ForwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease release;
+  return net->ForwardFromTo(start, end);
+}
+
+void Net_BackwardFromTo(Net<Dtype>* net, int start, int end) {
+  ScopedGILRelease release;
+  net->BackwardFromTo(start, end);
+}
+
+void Net_Reshape(Net<Dtype>* net) {
+  ScopedGILRelease release;
+  net->Reshape();
+}
+
+void Solver_Step(Solver<Dtype>* solver, int iters) {
+  ScopedGILRelease release;
+  solver->Step(iters);
+}
+
+void Solver_Solve(Solver<Dtype>* solver, bp::object resume_file) {
+  string filename;
+  if (!resume_file.is_none()) {
+    filename = bp::extract<string>(resume_file);
+  }
+  ScopedGILRelease release;
+  solver->Solve(filename.empty() ? NULL : filename.c_str());
+}
+
 void Net_Save(const Net<Dtype>& net, string filename) {
   NetParameter net_param;
   net.ToProto(&net_param, false);
@@ -279,9 +357,11 @@ class SolverCallback: public Solver<Dtype>::Callback {
   SolverCallback(bp::object on_start, bp::object on_gradients_ready)
     : on_start_(on_start), on_gradients_ready_(on_gradients_ready) { }
   virtual void on_gradients_ready() {
+    PyGILLock lock;
     on_gradients_ready_();
   }
   virtual void on_start() {
+    PyGILLock lock;
     on_start_();
   }
 };
@@ -313,6 +393,7 @@ class NetCallback: public Net<Dtype>::Callback {
 
  protected:
   virtual void run(int layer) {
+    PyGILLock lock;
     run_(layer);
   }
   bp::object run_;
@@ -330,6 +411,45 @@ void Net_after_backward(Net<Dtype>* net, bp::object run) {
   net->add_after_backward(new NetCallback<Dtype>(run));
 }
 
+shared_ptr<NetTracer> Net_tracer(const Net<Dtype>& net) {
+  return net.tracer();
+}
+
+bp::list NetTracer_Records(const NetTracer& tracer) {
+  vector<NetTracer::Record> records;
+  tracer.Records(&records);
+  bp::list result;
+  for (int i = 0; i < records.size(); ++i) {
+    const NetTracer::Record& record = records[i];
+    bp::list bottom_shapes;
+    for (int j = 0; j < record.bottom_shapes.size();
+         j += record.bottom_shapes[j] + 1) {
+      bp::list shape;
+      for (int k = 1; k <= record.bottom_shapes[j]; ++k) {
+        shape.append(record.bottom_shapes[j + k]);
+      }
+      bottom_shapes.append(bp::tuple(shape));
+    }
+    bp::dict entry;
+    entry["layer_name"] = record.layer_name;
+    entry["layer"] = record.layer;
+    entry["backward"] = record.backward;
+    entry["start"] = record.start;
+    entry["end"] = record.end;
+    entry["thread"] = record.thread;
+    entry["bottom_shapes"] = bottom_shapes;
+    bp::dict counts;
+    for (int j = 0; j < PerfCounters::NUM_EVENTS; ++j) {
+      if (record.counts[j] >= 0) {
+        counts[PerfCounters::name(j)] = record.counts[j];
+      }
+    }
+    entry["counts"] = counts;
+    result.append(entry);
+  }
+  return result;
+}
+
 void Net_add_nccl(Net<Dtype>* net
 #ifdef USE_NCCL
   , NCCL<Dtype>* nccl
@@ -376,14 +496,17 @@ bp::object NCCL_New_Uid() {
 }
 #endif
 
-BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(SolveOverloads, Solve, 0, 1);
-
 BOOST_PYTHON_MODULE(_caffe) {
   // below, we prepend an underscore to methods that will be replaced
   // in Python
 
   bp::scope().attr("__version__") = AS_STRING(CAFFE_VERSION);
 
+#if PY_VERSION_HEX < 0x03070000
+  // Set up the GIL, which forward, backward, reshape and step release.
+  PyEval_InitThreads();
+#endif
+
   // Caffe utility functions
   bp::def("init_log", &InitLog);
   bp::def("init_log", &InitLogLevel);
@@ -393,7 +516,7 @@ BOOST_PYTHON_MODULE(_caffe) {
   bp::def("set_mode_cpu", &set_mode_cpu);
   bp::def("set_mode_gpu", &set_mode_gpu);
   bp::def("set_random_seed", &set_random_seed);
-  bp::def("set_device", &Caffe::SetDevice);
+  bp::def("set_device", &set_device);
   bp::def("solver_count", &Caffe::solver_count);
   bp::def("set_solver_count", &Caffe::set_solver_count);
   bp::def("solver_rank", &Caffe::solver_rank);
@@ -411,9 +534,9 @@ BOOST_PYTHON_MODULE(_caffe) {
             bp::arg("weights")=bp::object())))
     // Legacy constructor
     .def("__init__", bp::make_constructor(&Net_Init_Load))
-    .def("_forward", &Net<Dtype>::ForwardFromTo)
-    .def("_backward", &Net<Dtype>::BackwardFromTo)
-    .def("reshape", &Net<Dtype>::Reshape)
+    .def("_forward", &Net_ForwardFromTo)
+    .def("_backward", &Net_BackwardFromTo)
+    .def("reshape", &Net_Reshape)
     .def("clear_param_diffs", &Net<Dtype>::ClearParamDiffs)
     // The cast is to select a particular overload.
     .def("copy_from", static_cast<void (Net<Dtype>::*)(const string)>(
@@ -447,9 +570,20 @@ BOOST_PYTHON_MODULE(_caffe) {
     .def("after_forward", &Net_after_forward)
     .def("before_backward", &Net_before_backward)
     .def("after_backward", &Net_after_backward)
-    .def("after_backward", &Net_add_nccl);
+    .def("after_backward", &Net_add_nccl)
+    .add_property("tracer", &Net_tracer, &Net<Dtype>::set_tracer);
   BP_REGISTER_SHARED_PTR_TO_PYTHON(Net<Dtype>);
 
+  bp::class_<NetTracer, shared_ptr<NetTracer>, boost::noncopyable>(
+    "NetTracer", bp::init<int, bp::optional<bool> >())
+    .add_property("capacity", &NetTracer::capacity)
+    .add_property("count_events", &NetTracer::count_events)
+    .add_property("recorded", &NetTracer::recorded)
+    .def("records", &NetTracer_Records)
+    .def("clear", &NetTracer::Clear)
+    .def("now", &NetTracer::Now).staticmethod("now");
+  BP_REGISTER_SHARED_PTR_TO_PYTHON(NetTracer);
+
   bp::class_<Blob<Dtype>, shared_ptr<Blob<Dtype> >, boost::noncopyable>(
     "Blob", bp::no_init)
     .add_property("shape",
@@ -493,9 +627,9 @@ BOOST_PYTHON_MODULE(_caffe) {
     .add_property("iter", &Solver<Dtype>::iter)
     .def("add_callback", &Solver_add_callback<Dtype>)
     .def("add_callback", &Solver_add_nccl)
-    .def("solve", static_cast<void (Solver<Dtype>::*)(const char*)>(
-          &Solver<Dtype>::Solve), SolveOverloads())
-    .def("step", &Solver<Dtype>::Step)
+    .def("solve", &Solver_Solve,
+          (bp::arg("self"), bp::arg("resume_file") = bp::object()))
+    .def("step", &Solver_Step)
     .def("restore", &Solver<Dtype>::Restore)
     .def("snapshot", &Solver<Dtype>::Snapshot)
     .def("share_weights", &share_weights)
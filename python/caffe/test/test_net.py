@@ -71,6 +71,29 @@ class TestNet(unittest.TestCase):
         self.net.forward()
         self.net.backward()
 
+    def test_tracer(self):
+        self.assertIsNone(self.net.tracer)
+        tracer = caffe.NetTracer(100)
+        self.net.tracer = tracer
+        self.net.forward()
+        self.net.backward()
+        self.net.tracer = None
+        self.net.forward()
+        records = tracer.records()
+        self.assertEqual(tracer.recorded, len(records))
+        names = [r['layer_name'] for r in records]
+        self.assertEqual(names, ['data', 'conv', 'ip', 'loss',
+                                 'loss', 'ip', 'conv', 'data'])
+        self.assertEqual([r['backward'] for r in records],
+                         [False] * 4 + [True] * 4)
+        self.assertEqual(records[1]['bottom_shapes'], [(5, 2, 3, 4)])
+        self.assertEqual(records[3]['bottom_shapes'], [(5, 13), (5, 1, 1, 1)])
+        for r in records:
+            self.assertLessEqual(r['start'], r['end'])
+            self.assertEqual(r['counts'], {})
+        tracer.clear()
+        self.assertEqual(tracer.records(), [])
+
     def test_forward_start_end(self):
         conv_blob=self.net.blobs['conv'];
         ip_blob=self.net.blobs['ip_blob'];
@@ -1,5 +1,6 @@
 import unittest
 import tempfile
+import threading
 import os
 import six
 
@@ -127,6 +128,33 @@ class TestPythonLayer(unittest.TestCase):
             for d in blob.data.shape:
                 self.assertEqual(s, d)
 
+    def test_threads(self):
+        # Each thread reshapes and runs its own net, with the GIL released in
+        # between the calls into the Python layers.
+        net_file = python_net_file()
+        nets = [caffe.Net(net_file, caffe.TRAIN) for _ in range(4)]
+        os.remove(net_file)
+        errors = []
+
+        def run(net, x):
+            try:
+                for _ in range(20):
+                    net.blobs['data'].data[...] = x
+                    net.reshape()
+                    net.forward()
+                    if not (net.blobs['three'].data == 10**3 * x).all():
+                        errors.append(x)
+            except Exception as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target=run, args=(net, i + 1))
+                   for i, net in enumerate(nets)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(errors, [])
+
     def test_exception(self):
         net_file = exception_net_file()
         self.assertRaises(RuntimeError, caffe.Net, net_file, caffe.TEST)
@@ -0,0 +1,153 @@
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/bench/bench_caffe_main.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/profiler.hpp"
+
+DEFINE_string(bench_filter, "",
+    "Optional; only run the benchmarks whose name contains this.");
+DEFINE_double(bench_min_time, 0.5,
+    "The minimum seconds to time each run of a benchmark for.");
+
+namespace caffe {
+namespace bench {
+
+State::State(const vector<int>& args, int64_t max_iterations)
+    : args_(args), max_iterations_(max_iterations), iterations_(0),
+      flops_(0), bytes_(0), seconds_(0) {}
+
+bool State::KeepRunning() {
+  if (iterations_ == 0) {
+    timer_.Start();
+  }
+  if (iterations_ < max_iterations_) {
+    ++iterations_;
+    return true;
+  }
+  seconds_ = timer_.MicroSeconds() / 1e6;
+  return false;
+}
+
+Benchmark* Benchmark::Args(int a, int b, int c, int d, int e, int f, int g,
+    int h) {
+  const int all[] = {a, b, c, d, e, f, g, h};
+  vector<int> args;
+  for (int i = 0; i < 8 && all[i] >= 0; ++i) {
+    args.push_back(all[i]);
+  }
+  args_.push_back(args);
+  return this;
+}
+
+static vector<Benchmark*>& Registry() {
+  static vector<Benchmark*>* registry = new vector<Benchmark*>();
+  return *registry;
+}
+
+Benchmark* RegisterBenchmark(const string& name, Function function) {
+  Registry().push_back(new Benchmark(name, function));
+  return Registry().back();
+}
+
+const vector<Benchmark*>& Benchmarks() {
+  return Registry();
+}
+
+void FillGaussian(Blob<float>* blob) {
+  FillerParameter filler_param;
+  GaussianFiller<float> filler(filler_param);
+  filler.Fill(blob);
+}
+
+void RunLayer(State* state, const LayerParameter& param,
+    const vector<Blob<float>*>& bottom, bool backward) {
+  shared_ptr<Layer<float> > layer = LayerRegistry<float>::CreateLayer(param);
+  Blob<float> top_blob;
+  vector<Blob<float>*> top(1, &top_blob);
+  layer->SetUp(bottom, top);
+  layer->Forward(bottom, top);
+  // The other bottoms are e.g. rois, which take no gradient.
+  vector<bool> propagate_down(bottom.size(), false);
+  propagate_down[0] = true;
+  if (backward) {
+    caffe_copy(top_blob.count(), top_blob.cpu_data(),
+               top_blob.mutable_cpu_diff());
+  }
+  const NetProfiler<float>::Cost cost =
+      NetProfiler<float>::EstimateCost(layer.get(), bottom, top);
+  state->SetFlopsPerIteration(backward ?
+      cost.backward_flops : cost.forward_flops);
+  state->SetBytesPerIteration(backward ?
+      cost.backward_bytes : cost.forward_bytes);
+  while (state->KeepRunning()) {
+    if (backward) {
+      layer->Backward(top, propagate_down, bottom);
+    } else {
+      layer->Forward(bottom, top);
+    }
+  }
+}
+
+// Runs benchmark with args for at least --bench_min_time, growing the
+// iterations like Google Benchmark does, and prints a row of the results.
+static void Run(const Benchmark& benchmark, const vector<int>& args) {
+  std::ostringstream name;
+  name << benchmark.name();
+  for (int i = 0; i < args.size(); ++i) {
+    name << "/" << args[i];
+  }
+  int64_t iterations = 1;
+  while (true) {
+    State state(args, iterations);
+    Caffe::set_random_seed(1701);
+    benchmark.function()(&state);
+    if (state.seconds() >= FLAGS_bench_min_time || iterations >= 1000000000) {
+      const double seconds = state.seconds() / state.iterations();
+      printf("%-48s %12.2f %12lld %10.2f %10.2f\n", name.str().c_str(),
+          seconds * 1e6, static_cast<long long>(state.iterations()),  // NOLINT
+          state.flops() / seconds * 1e-9, state.bytes() / seconds * 1e-9);
+      fflush(stdout);
+      return;
+    }
+    // Aim for 1.4 times the minimum time, growing at most tenfold at once.
+    const double multiplier = state.seconds() > FLAGS_bench_min_time / 10 ?
+        FLAGS_bench_min_time * 1.4 / state.seconds() : 10;
+    iterations = std::max(static_cast<int64_t>(iterations * multiplier),
+                          iterations + 1);
+  }
+}
+
+}  // namespace bench
+}  // namespace caffe
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  caffe::GlobalInit(&argc, &argv);
+  caffe::Caffe::set_mode(caffe::Caffe::CPU);
+  printf("%-48s %12s %12s %10s %10s\n", "Benchmark", "Time (us)",
+      "Iterations", "GFLOP/s", "GB/s");
+  const std::vector<caffe::bench::Benchmark*>& benchmarks =
+      caffe::bench::Benchmarks();
+  for (int i = 0; i < benchmarks.size(); ++i) {
+    const caffe::bench::Benchmark& benchmark = *benchmarks[i];
+    if (benchmark.name().find(FLAGS_bench_filter) == std::string::npos) {
+      continue;
+    }
+    if (benchmark.args().empty()) {
+      caffe::bench::Run(benchmark, std::vector<int>());
+    }
+    for (int j = 0; j < benchmark.args().size(); ++j) {
+      caffe::bench::Run(benchmark, benchmark.args()[j]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,48 @@
+#include <string>
+#include <vector>
+
+#include "caffe/bench/bench_caffe_main.hpp"
+#include "caffe/blob.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+namespace bench {
+
+// Args: H, W of a color image of bytes, crop size (0 for none), and whether
+// it is randomly mirrored; it is centered with mean values as in training.
+static void BM_DataTransformer(State* state) {
+  const int height = state->range(0);
+  const int width = state->range(1);
+  const int crop_size = state->range(2);
+  TransformationParameter param;
+  param.set_crop_size(crop_size);
+  param.set_mirror(state->range(3));
+  param.add_mean_value(104);
+  param.add_mean_value(117);
+  param.add_mean_value(123);
+  DataTransformer<float> transformer(param, TRAIN);
+  transformer.InitRand();
+  Datum datum;
+  datum.set_channels(3);
+  datum.set_height(height);
+  datum.set_width(width);
+  string pixels(3 * height * width, 0);
+  for (int i = 0; i < pixels.size(); ++i) {
+    pixels[i] = caffe_rng_rand() & 0xff;
+  }
+  datum.set_data(pixels);
+  Blob<float> blob(1, 3, crop_size ? crop_size : height,
+                   crop_size ? crop_size : width);
+  // Subtracts the mean from each output value.
+  state->SetFlopsPerIteration(blob.count());
+  state->SetBytesPerIteration(blob.count() * (1 + sizeof(float)));
+  while (state->KeepRunning()) {
+    transformer.Transform(datum, &blob);
+  }
+}
+BENCHMARK(BM_DataTransformer)->Args(256, 256, 227, 1)->Args(256, 256, 0, 0)
+    ->Args(600, 1000, 0, 1);
+
+}  // namespace bench
+}  // namespace caffe
@@ -0,0 +1,49 @@
+#include <vector>
+
+#include "caffe/bench/bench_caffe_main.hpp"
+#include "caffe/blob.hpp"
+#include "caffe/util/im2col.hpp"
+
+namespace caffe {
+namespace bench {
+
+// Args: channels, height, width, kernel size, with a stride of 1 and the
+// padding that keeps the size.
+static void BM_Im2col(State* state) {
+  const int channels = state->range(0);
+  const int height = state->range(1);
+  const int width = state->range(2);
+  const int kernel = state->range(3);
+  Blob<float> image(1, channels, height, width);
+  Blob<float> col(1, channels * kernel * kernel, height, width);
+  FillGaussian(&image);
+  state->SetBytesPerIteration((image.count() + col.count()) * sizeof(float));
+  while (state->KeepRunning()) {
+    im2col_cpu(image.cpu_data(), channels, height, width, kernel, kernel,
+        kernel / 2, kernel / 2, 1, 1, 1, 1, col.mutable_cpu_data());
+  }
+}
+BENCHMARK(BM_Im2col)->Args(3, 224, 224, 7)->Args(64, 56, 56, 3)
+    ->Args(256, 14, 14, 3)->Args(512, 7, 7, 3);
+
+static void BM_Col2im(State* state) {
+  const int channels = state->range(0);
+  const int height = state->range(1);
+  const int width = state->range(2);
+  const int kernel = state->range(3);
+  Blob<float> image(1, channels, height, width);
+  Blob<float> col(1, channels * kernel * kernel, height, width);
+  FillGaussian(&col);
+  // Reads the columns and adds into the image.
+  state->SetFlopsPerIteration(col.count());
+  state->SetBytesPerIteration((image.count() + col.count()) * sizeof(float));
+  while (state->KeepRunning()) {
+    col2im_cpu(col.cpu_data(), channels, height, width, kernel, kernel,
+        kernel / 2, kernel / 2, 1, 1, 1, 1, image.mutable_cpu_data());
+  }
+}
+BENCHMARK(BM_Col2im)->Args(3, 224, 224, 7)->Args(64, 56, 56, 3)
+    ->Args(256, 14, 14, 3)->Args(512, 7, 7, 3);
+
+}  // namespace bench
+}  // namespace caffe
@@ -0,0 +1,114 @@
+#include <vector>
+
+#include "caffe/bench/bench_caffe_main.hpp"
+#include "caffe/blob.hpp"
+
+namespace caffe {
+namespace bench {
+
+// Runs the layer param on a bottom of N x C x H x W from the first four
+// args.
+static void RunOnImage(State* state, const LayerParameter& param,
+    bool backward) {
+  Blob<float> data(state->range(0), state->range(1), state->range(2),
+                   state->range(3));
+  FillGaussian(&data);
+  RunLayer(state, param, vector<Blob<float>*>(1, &data), backward);
+}
+
+// Args: N, C, H, W, num_output, kernel size, with a stride of 1 and the
+// padding that keeps the size.
+static void Convolution(State* state, bool backward) {
+  LayerParameter param;
+  param.set_type("Convolution");
+  ConvolutionParameter* conv_param = param.mutable_convolution_param();
+  conv_param->set_num_output(state->range(4));
+  conv_param->add_kernel_size(state->range(5));
+  conv_param->add_pad(state->range(5) / 2);
+  conv_param->mutable_weight_filler()->set_type("gaussian");
+  RunOnImage(state, param, backward);
+}
+static void BM_ConvolutionForward(State* state) { Convolution(state, false); }
+static void BM_ConvolutionBackward(State* state) { Convolution(state, true); }
+BENCHMARK(BM_ConvolutionForward)->Args(1, 64, 56, 56, 64, 3)
+    ->Args(1, 256, 14, 14, 256, 3)->Args(1, 1024, 14, 14, 256, 1)
+    ->Args(1, 512, 7, 7, 2048, 1);
+BENCHMARK(BM_ConvolutionBackward)->Args(1, 64, 56, 56, 64, 3)
+    ->Args(1, 256, 14, 14, 256, 3)->Args(1, 1024, 14, 14, 256, 1);
+
+// Args: N, K, num_output. Reduced weight precisions run the TEST phase.
+static void InnerProduct(State* state, bool backward,
+    LayerParameter::Precision precision = LayerParameter_Precision_FLOAT) {
+  LayerParameter param;
+  param.set_type("InnerProduct");
+  if (precision != LayerParameter_Precision_FLOAT) {
+    param.set_phase(TEST);
+    param.set_weight_precision(precision);
+  }
+  InnerProductParameter* ip_param = param.mutable_inner_product_param();
+  ip_param->set_num_output(state->range(2));
+  ip_param->mutable_weight_filler()->set_type("gaussian");
+  Blob<float> data(state->range(0), state->range(1), 1, 1);
+  FillGaussian(&data);
+  RunLayer(state, param, vector<Blob<float>*>(1, &data), backward);
+}
+static void BM_InnerProductForward(State* state) {
+  InnerProduct(state, false);
+}
+static void BM_InnerProductBackward(State* state) {
+  InnerProduct(state, true);
+}
+static void BM_InnerProductForwardInt8(State* state) {
+  InnerProduct(state, false, LayerParameter_Precision_INT8);
+}
+BENCHMARK(BM_InnerProductForward)->Args(1, 2048, 1000)
+    ->Args(128, 2048, 1024)->Args(128, 1024, 1024);
+BENCHMARK(BM_InnerProductForwardInt8)->Args(1, 2048, 1000)
+    ->Args(128, 2048, 1024)->Args(128, 1024, 1024);
+BENCHMARK(BM_InnerProductBackward)->Args(128, 2048, 1024)
+    ->Args(128, 1024, 1024);
+
+// Args: N, C, H, W, kernel size, stride, and 0 for MAX or 1 for AVE
+static void Pooling(State* state, bool backward) {
+  LayerParameter param;
+  param.set_type("Pooling");
+  PoolingParameter* pool_param = param.mutable_pooling_param();
+  pool_param->set_kernel_size(state->range(4));
+  pool_param->set_stride(state->range(5));
+  pool_param->set_pool(state->range(6) ?
+      PoolingParameter_PoolMethod_AVE : PoolingParameter_PoolMethod_MAX);
+  RunOnImage(state, param, backward);
+}
+static void BM_PoolingForward(State* state) { Pooling(state, false); }
+static void BM_PoolingBackward(State* state) { Pooling(state, true); }
+BENCHMARK(BM_PoolingForward)->Args(1, 64, 112, 112, 3, 2, 0)
+    ->Args(1, 256, 56, 56, 2, 2, 0)->Args(1, 2048, 7, 7, 7, 1, 1);
+BENCHMARK(BM_PoolingBackward)->Args(1, 64, 112, 112, 3, 2, 0)
+    ->Args(1, 256, 56, 56, 2, 2, 0)->Args(1, 2048, 7, 7, 7, 1, 1);
+
+// Args: N, C, H, W, local size
+static void LRN(State* state, bool backward) {
+  LayerParameter param;
+  param.set_type("LRN");
+  param.mutable_lrn_param()->set_local_size(state->range(4));
+  RunOnImage(state, param, backward);
+}
+static void BM_LRNForward(State* state) { LRN(state, false); }
+static void BM_LRNBackward(State* state) { LRN(state, true); }
+BENCHMARK(BM_LRNForward)->Args(1, 96, 55, 55, 5)->Args(1, 256, 27, 27, 5);
+BENCHMARK(BM_LRNBackward)->Args(1, 96, 55, 55, 5)->Args(1, 256, 27, 27, 5);
+
+// Args: N, C, H, W, softmax over the channels
+static void Softmax(State* state, bool backward) {
+  LayerParameter param;
+  param.set_type("Softmax");
+  RunOnImage(state, param, backward);
+}
+static void BM_SoftmaxForward(State* state) { Softmax(state, false); }
+static void BM_SoftmaxBackward(State* state) { Softmax(state, true); }
+BENCHMARK(BM_SoftmaxForward)->Args(1, 1000, 1, 1)->Args(128, 21, 1, 1)
+    ->Args(1, 2, 38, 50)->Args(1, 21, 64, 64);
+BENCHMARK(BM_SoftmaxBackward)->Args(128, 21, 1, 1)->Args(1, 21, 64, 64);
+
+}  // namespace bench
+}  // namespace caffe
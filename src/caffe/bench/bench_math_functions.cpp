@@ -0,0 +1,71 @@
+#include <vector>
+
+#include "caffe/bench/bench_caffe_main.hpp"
+#include "caffe/blob.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+namespace bench {
+
+// Args: M, N, K and whether B is transposed, as in InnerProduct, rather
+// than not, as in Convolution.
+static void BM_Gemm(State* state) {
+  const int M = state->range(0);
+  const int N = state->range(1);
+  const int K = state->range(2);
+  const bool trans_b = state->range(3);
+  Blob<float> A(1, 1, M, K);
+  Blob<float> B(1, 1, K, N);
+  Blob<float> C(1, 1, M, N);
+  FillGaussian(&A);
+  FillGaussian(&B);
+  state->SetFlopsPerIteration(int64_t(2) * M * N * K);
+  state->SetBytesPerIteration(
+      (int64_t(M) * K + int64_t(K) * N + int64_t(M) * N) * sizeof(float));
+  while (state->KeepRunning()) {
+    caffe_cpu_gemm<float>(CblasNoTrans, trans_b ? CblasTrans : CblasNoTrans,
+        M, N, K, 1., A.cpu_data(), B.cpu_data(), 0., C.mutable_cpu_data());
+  }
+}
+// Convolutions of ResNet-50 (M = num_output, N = H x W, K = C x k x k) and
+// fully connected layers of a detection head
+BENCHMARK(BM_Gemm)->Args(64, 3136, 576, 0)->Args(128, 784, 1152, 0)
+    ->Args(256, 196, 2304, 0)->Args(512, 49, 4608, 0)
+    ->Args(128, 1024, 2048, 1)->Args(128, 1024, 1024, 1)
+    ->Args(1, 1000, 2048, 1);
+
+// Args: M, N
+static void BM_Gemv(State* state) {
+  const int M = state->range(0);
+  const int N = state->range(1);
+  Blob<float> A(1, 1, M, N);
+  Blob<float> x(1, 1, 1, N);
+  Blob<float> y(1, 1, 1, M);
+  FillGaussian(&A);
+  FillGaussian(&x);
+  state->SetFlopsPerIteration(int64_t(2) * M * N);
+  state->SetBytesPerIteration((int64_t(M) * N + M + N) * sizeof(float));
+  while (state->KeepRunning()) {
+    caffe_cpu_gemv<float>(CblasNoTrans, M, N, 1., A.cpu_data(), x.cpu_data(),
+        0., y.mutable_cpu_data());
+  }
+}
+BENCHMARK(BM_Gemv)->Args(1000, 2048)->Args(4096, 4096);
+
+// Args: N
+static void BM_Axpy(State* state) {
+  const int N = state->range(0);
+  Blob<float> x(1, 1, 1, N);
+  Blob<float> y(1, 1, 1, N);
+  FillGaussian(&x);
+  FillGaussian(&y);
+  state->SetFlopsPerIteration(int64_t(2) * N);
+  state->SetBytesPerIteration(int64_t(3) * N * sizeof(float));
+  while (state->KeepRunning()) {
+    caffe_axpy<float>(N, 0.5, x.cpu_data(), y.mutable_cpu_data());
+  }
+}
+BENCHMARK(BM_Axpy)->Args(1 << 12)->Args(1 << 16)->Args(1 << 22);
+
+}  // namespace bench
+}  // namespace caffe
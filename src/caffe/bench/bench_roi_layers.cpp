@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/bench/bench_caffe_main.hpp"
+#include "caffe/blob.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+namespace bench {
+
+// The features are at 1/16 of the image, as in the conv5 of VGG16.
+static const float kSpatialScale = 1. / 16;
+
+// Pools num_rois random boxes of the image of features with param.
+static void RunOnRois(State* state, const LayerParameter& param,
+    int channels, int height, int width, int num_rois, bool backward) {
+  Blob<float> features(1, channels, height, width);
+  FillGaussian(&features);
+  Blob<float> rois(num_rois, 5, 1, 1);
+  const float image_height = height / kSpatialScale;
+  const float image_width = width / kSpatialScale;
+  vector<float> corners(4);
+  for (int i = 0; i < num_rois; ++i) {
+    float* roi = rois.mutable_cpu_data() + rois.offset(i);
+    caffe_rng_uniform<float>(2, 0, image_width, &corners[0]);
+    caffe_rng_uniform<float>(2, 0, image_height, &corners[2]);
+    roi[0] = 0;
+    roi[1] = std::min(corners[0], corners[1]);
+    roi[2] = std::min(corners[2], corners[3]);
+    roi[3] = std::max(corners[0], corners[1]);
+    roi[4] = std::max(corners[2], corners[3]);
+  }
+  vector<Blob<float>*> bottom;
+  bottom.push_back(&features);
+  bottom.push_back(&rois);
+  RunLayer(state, param, bottom, backward);
+}
+
+// Args: C, H, W, num_rois, pooled size
+static void ROIPooling(State* state, const char* type, bool backward) {
+  LayerParameter param;
+  param.set_type(type);
+  ROIPoolingParameter* roi_param = param.mutable_roi_pooling_param();
+  roi_param->set_pooled_h(state->range(4));
+  roi_param->set_pooled_w(state->range(4));
+  roi_param->set_spatial_scale(kSpatialScale);
+  RunOnRois(state, param, state->range(0), state->range(1), state->range(2),
+            state->range(3), backward);
+}
+static void BM_ROIPoolingForward(State* state) {
+  ROIPooling(state, "ROIPooling", false);
+}
+static void BM_ROIPoolingBackward(State* state) {
+  ROIPooling(state, "ROIPooling", true);
+}
+static void BM_ROIAlignForward(State* state) {
+  ROIPooling(state, "ROIAlign", false);
+}
+static void BM_ROIAlignBackward(State* state) {
+  ROIPooling(state, "ROIAlign", true);
+}
+BENCHMARK(BM_ROIPoolingForward)->Args(512, 38, 50, 128, 7)
+    ->Args(512, 38, 50, 300, 7)->Args(1024, 38, 50, 300, 14);
+BENCHMARK(BM_ROIPoolingBackward)->Args(512, 38, 50, 128, 7)
+    ->Args(512, 38, 50, 300, 7);
+BENCHMARK(BM_ROIAlignForward)->Args(512, 38, 50, 128, 7)
+    ->Args(512, 38, 50, 300, 7)->Args(1024, 38, 50, 300, 14);
+BENCHMARK(BM_ROIAlignBackward)->Args(512, 38, 50, 128, 7)
+    ->Args(512, 38, 50, 300, 7);
+
+// Args: output_dim, group size, H, W, num_rois; the features have
+// output_dim x group size^2 channels, as in R-FCN. PSROIAlign only runs on
+// the GPU.
+static void PSROIPooling(State* state, bool backward) {
+  LayerParameter param;
+  param.set_type("PSROIPooling");
+  PSROIPoolingParameter* psroi_param = param.mutable_psroi_pooling_param();
+  const int output_dim = state->range(0);
+  const int group_size = state->range(1);
+  psroi_param->set_output_dim(output_dim);
+  psroi_param->set_group_size(group_size);
+  psroi_param->set_spatial_scale(kSpatialScale);
+  RunOnRois(state, param, output_dim * group_size * group_size,
+            state->range(2), state->range(3), state->range(4), backward);
+}
+static void BM_PSROIPoolingForward(State* state) {
+  PSROIPooling(state, false);
+}
+static void BM_PSROIPoolingBackward(State* state) {
+  PSROIPooling(state, true);
+}
+BENCHMARK(BM_PSROIPoolingForward)->Args(21, 7, 38, 50, 300)
+    ->Args(8, 7, 38, 50, 300);
+BENCHMARK(BM_PSROIPoolingBackward)->Args(21, 7, 38, 50, 300)
+    ->Args(8, 7, 38, 50, 300);
+
+}  // namespace bench
+}  // namespace caffe
@@ -0,0 +1,136 @@
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "caffe/bucketed_net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+BucketedNet<Dtype>::BucketedNet(const ShapeBucketParameter& bucket_param,
+    const NetParameter& param, shared_ptr<NetWeights<Dtype> > weights)
+    : param_(bucket_param) {
+  CHECK_GT(param_.height_size(), 0) << "Need at least one bucket";
+  CHECK_EQ(param_.height_size(), param_.width_size())
+      << "Buckets need both a height and a width";
+  CHECK_GT(param_.batch_size(), 0) << "batch_size must be positive";
+  for (int b = 0; b < param_.height_size(); ++b) {
+    shared_ptr<Net<Dtype> > net(new Net<Dtype>(param, weights));
+    if (!weights && b > 0) {
+      net->ShareTrainedLayersWith(nets_[0].get());
+    }
+    CHECK(net->has_blob(param_.data_blob()))
+        << "Unknown data blob " << param_.data_blob();
+    Blob<Dtype>* data = net->blob_by_name(param_.data_blob()).get();
+    CHECK_EQ(4, data->num_axes()) << "The data must be N x C x H x W";
+    channels_ = data->channels();
+    data->Reshape(param_.batch_size(), channels_, param_.height(b),
+                  param_.width(b));
+    if (net->has_blob(param_.im_info_blob())) {
+      vector<int> shape(2);
+      shape[0] = param_.batch_size();
+      shape[1] = 3;
+      net->blob_by_name(param_.im_info_blob())->Reshape(shape);
+    }
+    net->Reshape();
+    nets_.push_back(net);
+  }
+}
+
+template <typename Dtype>
+int BucketedNet<Dtype>::Bucket(int height, int width) const {
+  int bucket = -1;
+  for (int b = 0; b < param_.height_size(); ++b) {
+    if (height <= param_.height(b) && width <= param_.width(b) &&
+        (bucket < 0 || param_.height(b) * param_.width(b) <
+                       param_.height(bucket) * param_.width(bucket))) {
+      bucket = b;
+    }
+  }
+  return bucket;
+}
+
+template <typename Dtype>
+void BucketedNet<Dtype>::Group(const vector<std::pair<int, int> >& sizes,
+    vector<vector<int> >* batches, vector<int>* buckets) const {
+  batches->clear();
+  buckets->clear();
+  // The batch being filled for each bucket
+  std::map<int, int> open;
+  for (int i = 0; i < sizes.size(); ++i) {
+    const int bucket = Bucket(sizes[i].first, sizes[i].second);
+    CHECK_GE(bucket, 0) << "No bucket holds image " << i << " of "
+        << sizes[i].first << " x " << sizes[i].second;
+    std::map<int, int>::iterator it = open.find(bucket);
+    if (it == open.end()) {
+      it = open.insert(std::make_pair(bucket, batches->size())).first;
+      batches->push_back(vector<int>());
+      buckets->push_back(bucket);
+    }
+    (*batches)[it->second].push_back(i);
+    if ((*batches)[it->second].size() == param_.batch_size()) {
+      open.erase(it);
+    }
+  }
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& BucketedNet<Dtype>::Forward(int bucket,
+    const vector<Blob<Dtype>*>& images, const vector<Dtype>& scales) {
+  CHECK_GE(bucket, 0);
+  CHECK_LT(bucket, nets_.size());
+  const int num = images.size();
+  CHECK_GT(num, 0);
+  CHECK_LE(num, param_.batch_size());
+  CHECK_EQ(num, scales.size()) << "Need a scale for each image";
+  Net<Dtype>& net = *nets_[bucket];
+  const int height = param_.height(bucket);
+  const int width = param_.width(bucket);
+  Blob<Dtype>* data = net.blob_by_name(param_.data_blob()).get();
+  Blob<Dtype>* im_info = net.has_blob(param_.im_info_blob()) ?
+      net.blob_by_name(param_.im_info_blob()).get() : NULL;
+  // Only a batch smaller than the last one reshapes the net.
+  if (data->num() != num) {
+    data->Reshape(num, channels_, height, width);
+    if (im_info) {
+      vector<int> shape(2);
+      shape[0] = num;
+      shape[1] = 3;
+      im_info->Reshape(shape);
+    }
+    net.Reshape();
+  }
+  Dtype* data_data = data->mutable_cpu_data();
+  caffe_set(data->count(), Dtype(0), data_data);
+  for (int i = 0; i < num; ++i) {
+    const Blob<Dtype>& image = *images[i];
+    CHECK_GE(image.num_axes(), 2);
+    const int image_height = image.shape(-2);
+    const int image_width = image.shape(-1);
+    CHECK_EQ(channels_ * image_height * image_width, image.count())
+        << "Image " << i << " must be " << channels_ << " x H x W";
+    CHECK(image_height <= height && image_width <= width)
+        << "Image " << i << " of " << image_height << " x " << image_width
+        << " does not fit bucket " << bucket;
+    const Dtype* image_data = image.cpu_data();
+    for (int c = 0; c < channels_; ++c) {
+      for (int y = 0; y < image_height; ++y) {
+        caffe_copy(image_width,
+                   image_data + (c * image_height + y) * image_width,
+                   data_data + data->offset(i, c, y));
+      }
+    }
+    if (im_info) {
+      Dtype* info = im_info->mutable_cpu_data() + i * 3;
+      info[0] = image_height;
+      info[1] = image_width;
+      info[2] = scales[i];
+    }
+  }
+  return net.Forward();
+}
+
+INSTANTIATE_CLASS(BucketedNet);
+
+}  // namespace caffe
@@ -1,6 +1,9 @@
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 #endif  // USE_OPENCV
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
 
 #include <string>
 #include <vector>
@@ -12,6 +15,58 @@
 
 namespace caffe {
 
+// Converts a row of uint8 pixels to (pixel - mean) * scale, writing it in
+// reverse order if mirror is set.
+template <typename Dtype>
+static void transform_uint8_row(const uint8_t* src, const Dtype* mean,
+    const Dtype scale, const int width, const bool mirror, Dtype* dst) {
+  if (mirror) {
+    for (int w = 0; w < width; ++w) {
+      dst[width - 1 - w] = (static_cast<Dtype>(src[w]) - mean[w]) * scale;
+    }
+  } else {
+    for (int w = 0; w < width; ++w) {
+      dst[w] = (static_cast<Dtype>(src[w]) - mean[w]) * scale;
+    }
+  }
+}
+
+template <>
+void transform_uint8_row<float>(const uint8_t* src, const float* mean,
+    const float scale, const int width, const bool mirror, float* dst) {
+  int w = 0;
+#ifdef __SSE2__
+  // 16 pixels at a time: widen uint8 to int32, convert, subtract and scale.
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128i zero = _mm_setzero_si128();
+  for (; w + 16 <= width; w += 16) {
+    const __m128i px =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + w));
+    const __m128i lo = _mm_unpacklo_epi8(px, zero);
+    const __m128i hi = _mm_unpackhi_epi8(px, zero);
+    __m128 v[4];
+    v[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+    v[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+    v[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+    v[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+    for (int k = 0; k < 4; ++k) {
+      v[k] = _mm_mul_ps(_mm_sub_ps(v[k], _mm_loadu_ps(mean + w + 4 * k)),
+                        vscale);
+      if (mirror) {
+        _mm_storeu_ps(dst + width - 4 - w - 4 * k,
+                      _mm_shuffle_ps(v[k], v[k], _MM_SHUFFLE(0, 1, 2, 3)));
+      } else {
+        _mm_storeu_ps(dst + w + 4 * k, v[k]);
+      }
+    }
+  }
+#endif  // __SSE2__
+  for (; w < width; ++w) {
+    const float value = (static_cast<float>(src[w]) - mean[w]) * scale;
+    dst[mirror ? width - 1 - w : w] = value;
+  }
+}
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -93,6 +148,24 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     }
   }
 
+  if (has_uint8) {
+    // Fast path for uint8 data: transform whole rows at a time.
+    const uint8_t* pixels = reinterpret_cast<const uint8_t*>(data.data());
+    for (int c = 0; c < datum_channels; ++c) {
+      if (!has_mean_file) {
+        mean_row_.assign(width, has_mean_values ? mean_values_[c] : Dtype(0));
+      }
+      for (int h = 0; h < height; ++h) {
+        const int data_index =
+            (c * datum_height + h_off + h) * datum_width + w_off;
+        transform_uint8_row(pixels + data_index,
+            has_mean_file ? mean + data_index : &mean_row_[0], scale, width,
+            do_mirror, transformed_data + (c * height + h) * width);
+      }
+    }
+    return;
+  }
+
   Dtype datum_element;
   int top_index, data_index;
   for (int c = 0; c < datum_channels; ++c) {
@@ -104,12 +177,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
         } else {
           top_index = (c * height + h) * width + w;
         }
-        if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
+        datum_element = datum.float_data(data_index);
         if (has_mean_file) {
           transformed_data[top_index] =
             (datum_element - mean[data_index]) * scale;
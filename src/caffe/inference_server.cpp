@@ -0,0 +1,162 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/inference_server.hpp"
+#include "caffe/internal_thread.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class InferenceServer<Dtype>::Replica : public InternalThread {
+ public:
+  Replica(InferenceServer<Dtype>* server, shared_ptr<Net<Dtype> > net)
+      : server_(server), net_(net) {}
+  // Stop before the members go, as the thread uses them.
+  virtual ~Replica() { StopInternalThread(); }
+
+ protected:
+  virtual void InternalThreadEntry();
+  // Runs the net on a batch, then answers and deletes its requests.
+  void Run(const vector<InferenceRequest<Dtype>*>& batch);
+
+  InferenceServer<Dtype>* server_;
+  shared_ptr<Net<Dtype> > net_;
+};
+
+template <typename Dtype>
+InferenceServer<Dtype>::InferenceServer(
+    const InferenceServerParameter& server_param, const NetParameter& param,
+    shared_ptr<NetWeights<Dtype> > weights)
+    : param_(server_param) {
+  CHECK_GT(param_.replicas(), 0) << "Need at least one replica";
+  CHECK_GT(param_.max_batch_size(), 0) << "max_batch_size must be positive";
+  CHECK(!param.flat_params())
+      << "flat_params is for training, not for serving shared replicas";
+  for (int i = 0; i < param_.replicas(); ++i) {
+    nets_.push_back(shared_ptr<Net<Dtype> >(new Net<Dtype>(param, weights)));
+    if (!weights && i > 0) {
+      nets_[i]->ShareTrainedLayersWith(nets_[0].get());
+    }
+    CHECK_EQ(nets_[i]->input_blobs().size(), 1)
+        << "The net must have one input";
+    Blob<Dtype>* input = nets_[i]->input_blobs()[0];
+    CHECK_GT(input->num_axes(), 0) << "The input of the net must be batched";
+    vector<int> shape = input->shape();
+    shape[0] = param_.max_batch_size();
+    input->Reshape(shape);
+    nets_[i]->Reshape();
+  }
+  // The replicas read the params that they share concurrently, so have the
+  // params where the nets run before they start, leaving no copy to race.
+  for (int i = 0; i < nets_.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& params = nets_[i]->params();
+    for (int j = 0; j < params.size(); ++j) {
+      if (Caffe::mode() == Caffe::GPU) {
+        params[j]->gpu_data();
+      } else {
+        params[j]->cpu_data();
+      }
+    }
+  }
+  const Net<Dtype>& net = *nets_[0];
+  const Blob<Dtype>& input = *net.input_blobs()[0];
+  input_shape_.assign(input.shape().begin() + 1, input.shape().end());
+  input_count_ = input.count(1);
+  for (int i = 0; i < net.output_blobs().size(); ++i) {
+    const Blob<Dtype>& output = *net.output_blobs()[i];
+    CHECK(output.num_axes() > 0 && output.shape(0) == input.shape(0))
+        << "The outputs of the net must be batched like its input";
+  }
+  for (int i = 0; i < nets_.size(); ++i) {
+    replicas_.push_back(shared_ptr<Replica>(new Replica(this, nets_[i])));
+    replicas_[i]->StartInternalThread();
+  }
+  LOG(INFO) << "Serving " << net.name() << " on " << replicas_.size()
+            << " replicas, in batches of up to " << param_.max_batch_size();
+}
+
+template <typename Dtype>
+InferenceServer<Dtype>::~InferenceServer() {
+  replicas_.clear();
+  InferenceRequest<Dtype>* request;
+  while (requests_.try_pop(&request)) {
+    delete request;
+  }
+}
+
+template <typename Dtype>
+boost::unique_future<typename InferenceServer<Dtype>::Output>
+InferenceServer<Dtype>::Submit(const Dtype* input) {
+  InferenceRequest<Dtype>* request = new InferenceRequest<Dtype>();
+  request->input_.assign(input, input + input_count_);
+  boost::unique_future<Output> output = request->output_.get_future();
+  requests_.push(request);
+  return boost::move(output);
+}
+
+template <typename Dtype>
+void InferenceServer<Dtype>::Replica::InternalThreadEntry() {
+  const int max_batch_size = server_->param_.max_batch_size();
+  const boost::posix_time::time_duration timeout =
+      boost::posix_time::microseconds(server_->param_.batch_timeout_us());
+  vector<InferenceRequest<Dtype>*> batch;
+  try {
+    while (!must_stop()) {
+      batch.push_back(server_->requests_.pop());
+      const boost::posix_time::ptime deadline =
+          boost::posix_time::microsec_clock::universal_time() + timeout;
+      InferenceRequest<Dtype>* request;
+      while (batch.size() < max_batch_size) {
+        const int64_t left = (deadline -
+            boost::posix_time::microsec_clock::universal_time())
+            .total_microseconds();
+        if (!server_->requests_.try_pop(&request,
+                                        std::max<int64_t>(left, 0))) {
+          break;
+        }
+        batch.push_back(request);
+      }
+      Run(batch);
+      batch.clear();
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+  for (int i = 0; i < batch.size(); ++i) {
+    delete batch[i];
+  }
+}
+
+template <typename Dtype>
+void InferenceServer<Dtype>::Replica::Run(
+    const vector<InferenceRequest<Dtype>*>& batch) {
+  // The rows past the batch keep their last inputs, and their outputs are
+  // not read.
+  Blob<Dtype>* input = net_->input_blobs()[0];
+  const int input_count = server_->input_count_;
+  for (int i = 0; i < batch.size(); ++i) {
+    caffe_copy(input_count, &batch[i]->input_[0],
+               input->mutable_cpu_data() + i * input_count);
+  }
+  net_->Forward();
+  const vector<Blob<Dtype>*>& outputs = net_->output_blobs();
+  for (int i = 0; i < batch.size(); ++i) {
+    Output output(outputs.size());
+    for (int j = 0; j < outputs.size(); ++j) {
+      vector<int> output_shape = outputs[j]->shape();
+      output_shape[0] = 1;
+      output[j].reset(new Blob<Dtype>(output_shape));
+      const int output_count = output[j]->count();
+      caffe_copy(output_count, outputs[j]->cpu_data() + i * output_count,
+                 output[j]->mutable_cpu_data());
+    }
+    batch[i]->output_.set_value(output);
+    delete batch[i];
+  }
+}
+
+INSTANTIATE_CLASS(InferenceServer);
+
+}  // namespace caffe
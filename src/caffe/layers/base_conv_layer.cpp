@@ -12,6 +12,9 @@ template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   // Configure the kernel size, padding, stride, and inputs.
+  CHECK(this->phase_ == TEST || this->layer_param_.weight_precision() ==
+      LayerParameter_Precision_FLOAT)
+      << "weight_precision is for inference only; set it in the TEST phase.";
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
   force_nd_im2col_ = conv_param.force_nd_im2col();
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
@@ -259,11 +262,43 @@ void BaseConvolutionLayer<Dtype>::reshape_variables(const Blob<Dtype>* bottom, c
   if (bias_term_) {
     vector<int> bias_multiplier_shape(1, out_spatial_dim_);
     bias_multiplier_.Reshape(bias_multiplier_shape);
-    caffe_set(bias_multiplier_.count(), Dtype(1),
-        bias_multiplier_.mutable_cpu_data());
+    // The multiplier keeps its ones unless it grew into new memory.
+    if (bias_multiplier_.cpu_data()[out_spatial_dim_ - 1] != Dtype(1)) {
+      caffe_set(bias_multiplier_.count(), Dtype(1),
+          bias_multiplier_.mutable_cpu_data());
+    }
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::pack_weights() {
+  const LayerParameter::Precision precision =
+      this->layer_param_.weight_precision();
+  if (precision == LayerParameter_Precision_FLOAT) {
+    return;
+  }
+  // Repack if the weights were written to since they were packed.
+  const SyncedMemory* memory = this->blobs_[0]->data().get();
+  if (!half_weights_.empty() || !int8_weights_.empty()) {
+    if (memory == packed_memory_ && memory->version() == packed_version_) {
+      return;
+    }
+    half_weights_.Clear();
+    int8_weights_.Clear();
+  }
+  const Blob<Dtype>& weights = *this->blobs_[0];
+  if (precision == LayerParameter_Precision_INT8) {
+    int8_weights_.Pack(weights.cpu_data(), weights.shape(0),
+                       weights.count(1), false);
+  } else {
+    half_weights_.Pack(weights.cpu_data(), weights.shape(0),
+                       weights.count(1),
+                       precision == LayerParameter_Precision_BF16);
+  }
+  packed_memory_ = memory;
+  packed_version_ = memory->version();
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
@@ -275,6 +310,20 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
+    if (!half_weights_.empty()) {
+      half_weights_.GemmRows(conv_out_channels_ / group_ * g,
+          conv_out_channels_ / group_, conv_out_spatial_dim_,
+          col_buff + col_offset_ * g, output + output_offset_ * g);
+      continue;
+    }
+    if (!int8_weights_.empty()) {
+      int8_weights_.GemmRows(conv_out_channels_ / group_ * g,
+          conv_out_channels_ / group_, conv_out_spatial_dim_,
+          col_buff + col_offset_ * g,
+          this->layer_param_.quantization_param().input_range(),
+          output + output_offset_ * g);
+      continue;
+    }
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
         group_, conv_out_spatial_dim_, kernel_dim_,
         (Dtype)1., weights + weight_offset_ * g, col_buff + col_offset_ * g,
@@ -1,4 +1,5 @@
 #include <boost/thread.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -7,6 +8,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
 namespace caffe {
@@ -44,6 +46,20 @@ BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
   }
 }
 
+template <typename Dtype>
+BasePrefetchingDataLayer<Dtype>::~BasePrefetchingDataLayer() {
+  // Subclasses must already have stopped the thread, which calls their
+  // load_batch; this only guards the events below.
+  this->StopInternalThread();
+#ifndef CPU_ONLY
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    if (prefetch_[i]->copied_) {
+      cudaEventDestroy(prefetch_[i]->copied_);
+    }
+  }
+#endif
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -52,7 +68,8 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
   // Before starting the prefetch thread, we make cpu_data and gpu_data
   // calls so that the prefetch thread does not accidentally make simultaneous
   // cudaMalloc calls when the main thread is running. In some GPUs this
-  // seems to cause failures if we do not so.
+  // seems to cause failures if we do not so. In GPU mode the host buffers
+  // are pinned (see CaffeMallocHost), so batches are uploaded by DMA.
   for (int i = 0; i < prefetch_.size(); ++i) {
     prefetch_[i]->data_.mutable_cpu_data();
     if (this->output_labels_) {
@@ -66,9 +83,14 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
       if (this->output_labels_) {
         prefetch_[i]->label_.mutable_gpu_data();
       }
+      if (!prefetch_[i]->copied_) {
+        CUDA_CHECK(cudaEventCreateWithFlags(&prefetch_[i]->copied_,
+                                            cudaEventDisableTiming));
+      }
     }
   }
 #endif
+  ResetPrefetchStats();
   DLOG(INFO) << "Initializing prefetch";
   this->data_transformer_->InitRand();
   StartInternalThread();
@@ -87,14 +109,27 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
   try {
     while (!must_stop()) {
       Batch<Dtype>* batch = prefetch_free_.pop();
+#ifndef CPU_ONLY
+      if (Caffe::mode() == Caffe::GPU) {
+        // The last upload from this batch must be done before its host
+        // buffers are overwritten.
+        CUDA_CHECK(cudaEventSynchronize(batch->copied_));
+      }
+#endif
+      batch->read_time_ = batch->trans_time_ = 0;
+      CPUTimer timer;
+      timer.Start();
       load_batch(batch);
+      batch->load_time_ = timer.MilliSeconds();
 #ifndef CPU_ONLY
       if (Caffe::mode() == Caffe::GPU) {
         batch->data_.data().get()->async_gpu_push(stream);
         if (this->output_labels_) {
           batch->label_.data().get()->async_gpu_push(stream);
         }
-        CUDA_CHECK(cudaStreamSynchronize(stream));
+        // Signal readiness with an event rather than synchronizing the
+        // stream, so that this upload overlaps with loading the next batch.
+        CUDA_CHECK(cudaEventRecord(batch->copied_, stream));
       }
 #endif
       prefetch_full_.push(batch);
@@ -110,12 +145,38 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 }
 
 template <typename Dtype>
-void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
-    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+void BasePrefetchingDataLayer<Dtype>::ResetPrefetchStats() {
+  stats_ = PrefetchStats();
+  stats_.occupancy.resize(prefetch_.size() + 1);
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::NextBatch() {
   if (prefetch_current_) {
     prefetch_free_.push(prefetch_current_);
   }
+  const int ready = prefetch_full_.size();
+  CPUTimer timer;
+  timer.Start();
   prefetch_current_ = prefetch_full_.pop("Waiting for data");
+  const double wait_time = timer.MilliSeconds();
+  // The stats are only touched here, on the thread running the net.
+  stats_.occupancy[ready]++;
+  stats_.forwards++;
+  if (ready == 0) {
+    stats_.waits++;
+  }
+  stats_.wait_time += wait_time;
+  stats_.max_wait_time = std::max(stats_.max_wait_time, wait_time);
+  stats_.load_time += prefetch_current_->load_time_;
+  stats_.read_time += prefetch_current_->read_time_;
+  stats_.trans_time += prefetch_current_->trans_time_;
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  NextBatch();
   // Reshape to loaded data.
   top[0]->ReshapeLike(prefetch_current_->data_);
   top[0]->set_cpu_data(prefetch_current_->data_.mutable_cpu_data());
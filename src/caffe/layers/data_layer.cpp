@@ -128,6 +128,8 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
+  batch->read_time_ = read_time / 1000;
+  batch->trans_time_ = trans_time / 1000;
 }
 
 INSTANTIATE_CLASS(DataLayer);
@@ -1,11 +1,12 @@
 /*
 TODO:
-- load file in a separate thread ("prefetch")
 - can be smarter about the memcpy call instead of doing it row-by-row
   :: use util functions caffe_copy, and Blob->offset()
   :: don't forget to update hdf5_daa_layer.cu accordingly
 - add ability to shuffle filenames if flag is set
 */
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -16,16 +17,20 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+}
 
 // Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
   DLOG(INFO) << "Loading HDF5 file: " << filename;
+  HDF5Lock lock;
   hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
   if (file_id < 0) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
@@ -107,8 +112,33 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  const int chunk_size = this->layer_param_.hdf5_data_param().chunk_size();
+  if (chunk_size > 0) {
+    LOG(INFO) << "Streaming HDF5 files in chunks of " << chunk_size << " rows";
+    // SetUp may be called more than once; restart from the first file.
+    this->StopInternalThread();
+    HDF5Chunk<Dtype>* chunk;
+    while (chunk_free_.try_pop(&chunk)) {}
+    while (chunk_full_.try_pop(&chunk)) {}
+    chunk_current_ = NULL;
+    // Double buffering: rows are output from one chunk while the next one is
+    // being read.
+    chunks_.resize(2);
+    for (int i = 0; i < chunks_.size(); ++i) {
+      chunks_[i].reset(new HDF5Chunk<Dtype>());
+      for (int j = 0; j < this->layer_param_.top_size(); ++j) {
+        chunks_[i]->blobs_.push_back(
+            shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+      }
+      chunk_free_.push(chunks_[i].get());
+    }
+    this->StartInternalThread();
+    // Wait for the first chunk and initialize the line counter.
+    NextChunk();
+  } else {
+    // Load the first HDF5 file and initialize the line counter.
+    LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  }
   current_row_ = 0;
 
   // Reshape blobs.
@@ -125,6 +155,99 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      for (int i = 0; i < num_files_; ++i) {
+        StreamHDF5File(hdf_filenames_[file_permutation_[i]].c_str());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        shuffle(file_permutation_.begin(), file_permutation_.end());
+      }
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+// Read one HDF5 file chunk by chunk into the free buffers, in shuffled chunk
+// order if requested.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::StreamHDF5File(const char* filename) {
+  DLOG(INFO) << "Streaming HDF5 file: " << filename;
+  const int top_size = this->layer_param_.top_size();
+  hid_t file_id;
+  hsize_t num_rows;
+  {
+    HDF5Lock lock;
+    file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    num_rows = hdf5_get_num_rows(file_id, this->layer_param_.top(0).c_str());
+    for (int i = 1; i < top_size; ++i) {
+      CHECK_EQ(hdf5_get_num_rows(file_id, this->layer_param_.top(i).c_str()),
+               num_rows);
+    }
+  }
+  const bool shuffle_rows = this->layer_param_.hdf5_data_param().shuffle();
+  const hsize_t chunk_size = this->layer_param_.hdf5_data_param().chunk_size();
+  const int num_chunks = (num_rows + chunk_size - 1) / chunk_size;
+  vector<int> chunk_order(num_chunks);
+  for (int i = 0; i < num_chunks; ++i) {
+    chunk_order[i] = i;
+  }
+  if (shuffle_rows) {
+    shuffle(chunk_order.begin(), chunk_order.end());
+  }
+
+  try {
+    for (int c = 0; c < num_chunks; ++c) {
+      HDF5Chunk<Dtype>* chunk = chunk_free_.pop();
+      const hsize_t row_start = chunk_order[c] * chunk_size;
+      const hsize_t rows = std::min(chunk_size, num_rows - row_start);
+      {
+        HDF5Lock lock;
+        for (int i = 0; i < top_size; ++i) {
+          hdf5_load_nd_dataset_rows(file_id,
+              this->layer_param_.top(i).c_str(), row_start, rows,
+              chunk->blobs_[i].get());
+        }
+      }
+      chunk->permutation_.resize(rows);
+      for (int i = 0; i < rows; ++i) {
+        chunk->permutation_[i] = i;
+      }
+      if (shuffle_rows) {
+        shuffle(chunk->permutation_.begin(), chunk->permutation_.end());
+      }
+      chunk_full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    HDF5Lock lock;
+    H5Fclose(file_id);
+    throw;
+  }
+
+  HDF5Lock lock;
+  herr_t status = H5Fclose(file_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+}
+
+// Hand the exhausted chunk back to the streaming thread and make the next one
+// current.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::NextChunk() {
+  if (chunk_current_) {
+    chunk_free_.push(chunk_current_);
+  }
+  chunk_current_ = chunk_full_.pop("Waiting for HDF5 data");
+  hdf_blobs_ = chunk_current_->blobs_;
+  data_permutation_ = chunk_current_->permutation_;
+}
+
 template <typename Dtype>
 bool HDF5DataLayer<Dtype>::Skip() {
   int size = Caffe::solver_count();
@@ -138,22 +261,28 @@ bool HDF5DataLayer<Dtype>::Skip() {
 template<typename Dtype>
 void HDF5DataLayer<Dtype>::Next() {
   if (++current_row_ == hdf_blobs_[0]->shape(0)) {
-    if (num_files_ > 1) {
-      ++current_file_;
-      if (current_file_ == num_files_) {
-        current_file_ = 0;
-        if (this->layer_param_.hdf5_data_param().shuffle()) {
-          std::random_shuffle(file_permutation_.begin(),
-                              file_permutation_.end());
+    if (this->layer_param_.hdf5_data_param().chunk_size() > 0) {
+      // File order and shuffling are handled by the streaming thread.
+      NextChunk();
+    } else {
+      if (num_files_ > 1) {
+        ++current_file_;
+        if (current_file_ == num_files_) {
+          current_file_ = 0;
+          if (this->layer_param_.hdf5_data_param().shuffle()) {
+            std::random_shuffle(file_permutation_.begin(),
+                                file_permutation_.end());
+          }
+          DLOG(INFO) << "Looping around to first file.";
         }
-        DLOG(INFO) << "Looping around to first file.";
+        LoadHDF5FileData(
+          hdf_filenames_[file_permutation_[current_file_]].c_str());
       }
-      LoadHDF5FileData(
-        hdf_filenames_[file_permutation_[current_file_]].c_str());
+      if (this->layer_param_.hdf5_data_param().shuffle())
+        std::random_shuffle(data_permutation_.begin(),
+                            data_permutation_.end());
     }
     current_row_ = 0;
-    if (this->layer_param_.hdf5_data_param().shuffle())
-      std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
   }
   offset_++;
 }
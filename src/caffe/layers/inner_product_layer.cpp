@@ -10,6 +10,9 @@ template <typename Dtype>
 void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int num_output = this->layer_param_.inner_product_param().num_output();
+  CHECK(this->phase_ == TEST || this->layer_param_.weight_precision() ==
+      LayerParameter_Precision_FLOAT)
+      << "weight_precision is for inference only; set it in the TEST phase.";
   bias_term_ = this->layer_param_.inner_product_param().bias_term();
   transpose_ = this->layer_param_.inner_product_param().transpose();
   N_ = num_output;
@@ -85,13 +88,45 @@ void InnerProductLayer<Dtype>::reshape_variables(const Blob<Dtype>* bottom) {
   if (bias_term_) {
     vector<int> bias_shape(1, M_);
     bias_multiplier_.Reshape(bias_shape);
-    caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
+    if (M_ > 0 && bias_multiplier_.cpu_data()[M_ - 1] != Dtype(1)) {
+      caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
+    }
+  }
+}
+
+template <typename Dtype>
+void InnerProductLayer<Dtype>::pack_weights() {
+  const LayerParameter::Precision precision =
+      this->layer_param_.weight_precision();
+  if (precision == LayerParameter_Precision_FLOAT) {
+    return;
+  }
+  // The weights may be written to after packing, e.g. by a solver training
+  // a net that shares them, so the pack is keyed on their version.
+  const SyncedMemory* memory = this->blobs_[0]->data().get();
+  if (!half_weights_.empty() || !int8_weights_.empty()) {
+    if (memory == packed_memory_ && memory->version() == packed_version_) {
+      return;
+    }
+    half_weights_.Clear();
+    int8_weights_.Clear();
+  }
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (precision == LayerParameter_Precision_INT8) {
+    int8_weights_.Pack(weight, N_, K_, transpose_);
+  } else {
+    half_weights_.Pack(weight, this->blobs_[0]->shape(0),
+        this->blobs_[0]->shape(1),
+        precision == LayerParameter_Precision_BF16);
   }
+  packed_memory_ = memory;
+  packed_version_ = memory->version();
 }
 
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
+  pack_weights();
   const Dtype* weight = this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     if (bottom.size() > 0) {
@@ -99,9 +134,17 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-        M_, N_, K_, (Dtype)1.,
-        bottom_data, weight, (Dtype)0., top_data);
+    if (!half_weights_.empty()) {
+      half_weights_.Gemm(transpose_ ? CblasNoTrans : CblasTrans, M_,
+          bottom_data, top_data);
+    } else if (!int8_weights_.empty()) {
+      int8_weights_.Gemm(M_, bottom_data,
+          this->layer_param_.quantization_param().input_range(), top_data);
+    } else {
+      caffe_cpu_gemm<Dtype>(CblasNoTrans,
+          transpose_ ? CblasNoTrans : CblasTrans, M_, N_, K_, (Dtype)1.,
+          bottom_data, weight, (Dtype)0., top_data);
+    }
     if (bias_term_) {
       caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
           bias_multiplier_.cpu_data(),
@@ -10,6 +10,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
@@ -21,13 +22,15 @@
 namespace caffe {
 
 template <typename Dtype>
-Net<Dtype>::Net(const NetParameter& param) {
+Net<Dtype>::Net(const NetParameter& param,
+    shared_ptr<NetWeights<Dtype> > weights) : weights_(weights) {
   Init(param);
 }
 
 template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase,
-    const int level, const vector<string>* stages) {
+    const int level, const vector<string>* stages,
+    shared_ptr<NetWeights<Dtype> > weights) : weights_(weights) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   // Set phase, stages and level
@@ -67,6 +70,7 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   param_id_vecs_.resize(param.layer_size());
   top_id_vecs_.resize(param.layer_size());
   bottom_need_backward_.resize(param.layer_size());
+  layer_internal_bytes_.resize(param.layer_size());
   for (int layer_id = 0; layer_id < param.layer_size(); ++layer_id) {
     // Inherit phase from net if unset.
     if (!param.layer(layer_id).has_phase()) {
@@ -118,8 +122,19 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         AppendTop(param, layer_id, num_top, NULL, NULL);
       }
     }
+    // Give the layer the shared weights, if any, which it then skips
+    // allocating and filling.
+    if (weights_ && weights_->Share(layer_param.name(),
+                                    &layers_[layer_id]->blobs())) {
+      LOG_IF(INFO, Caffe::root_solver())
+          << "Sharing weights of " << layer_param.name();
+    }
     // After this layer is connected, set it up.
+    const int64_t allocated = SyncedMemory::thread_allocated_bytes() -
+        LayerBlobBytes(layer_id);
     layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    layer_internal_bytes_[layer_id] = SyncedMemory::thread_allocated_bytes() -
+        LayerBlobBytes(layer_id) - allocated;
     LOG_IF(INFO, Caffe::root_solver())
         << "Setting up " << layer_names_[layer_id];
     for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
@@ -252,6 +267,9 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  if (param.flat_params()) {
+    FlattenParams();
+  }
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
   // optimize memory
@@ -267,6 +285,88 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   if (!debug_info_ && optimize_memory_) {
     MemoryOptimize_v2();
   }
+  size_t params_used = 0;
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    params_used += learnable_params_[i]->count();
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Memory required for params: " << params_used * sizeof(Dtype);
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Peak resident memory: " << PeakResidentBytes();
+}
+
+// The bytes allocated for the data or diff of blob, unless they are counted.
+template <typename Dtype>
+static size_t AllocatedBytes(const Blob<Dtype>& blob, bool diff,
+    set<const SyncedMemory*>* counted) {
+  if (blob.count() == 0) {
+    return 0;
+  }
+  const shared_ptr<SyncedMemory>& memory = diff ? blob.diff() : blob.data();
+  return counted->insert(memory.get()).second ? memory->allocated_size() : 0;
+}
+
+template <typename Dtype>
+int64_t Net<Dtype>::LayerBlobBytes(int layer_id) const {
+  set<const SyncedMemory*> counted;
+  vector<Blob<Dtype>*> blobs(bottom_vecs_[layer_id]);
+  blobs.insert(blobs.end(), top_vecs_[layer_id].begin(),
+               top_vecs_[layer_id].end());
+  const vector<shared_ptr<Blob<Dtype> > >& params = layers_[layer_id]->blobs();
+  for (int i = 0; i < params.size(); ++i) {
+    blobs.push_back(params[i].get());
+  }
+  int64_t bytes = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    bytes += AllocatedBytes(*blobs[i], false, &counted) +
+        AllocatedBytes(*blobs[i], true, &counted);
+    const shared_ptr<SyncedMemory>& shape = blobs[i]->shape_data();
+    if (shape && counted.insert(shape.get()).second) {
+      bytes += shape->allocated_size();
+    }
+  }
+  return bytes;
+}
+
+template <typename Dtype>
+void Net<Dtype>::MemoryReport(vector<LayerMemory>* report) {
+  for (int i = 0; i < layers_.size(); ++i) {
+    const int64_t allocated = SyncedMemory::thread_allocated_bytes() -
+        LayerBlobBytes(i);
+    ForwardFromTo(i, i);
+    layer_internal_bytes_[i] += SyncedMemory::thread_allocated_bytes() -
+        LayerBlobBytes(i) - allocated;
+  }
+  for (int i = layers_.size() - 1; i >= 0; --i) {
+    if (!layer_need_backward_[i]) {
+      continue;
+    }
+    const int64_t allocated = SyncedMemory::thread_allocated_bytes() -
+        LayerBlobBytes(i);
+    BackwardFromTo(i, i);
+    layer_internal_bytes_[i] += SyncedMemory::thread_allocated_bytes() -
+        LayerBlobBytes(i) - allocated;
+  }
+  // Count each allocation for the first layer that holds it.
+  set<const SyncedMemory*> counted;
+  report->resize(layers_.size());
+  for (int i = 0; i < layers_.size(); ++i) {
+    LayerMemory& memory = (*report)[i];
+    memory.top_data = memory.top_diff = 0;
+    for (int j = 0; j < top_vecs_[i].size(); ++j) {
+      memory.top_data += AllocatedBytes(*top_vecs_[i][j], false, &counted);
+      memory.top_diff += AllocatedBytes(*top_vecs_[i][j], true, &counted);
+    }
+    memory.param_data = memory.param_diff = 0;
+    const vector<shared_ptr<Blob<Dtype> > >& params = layers_[i]->blobs();
+    for (int j = 0; j < params.size(); ++j) {
+      memory.param_data += AllocatedBytes(*params[j], false, &counted);
+      memory.param_diff += AllocatedBytes(*params[j], true, &counted);
+    }
+    // A layer may hand its buffers to its tops, e.g. the prefetched batches
+    // of data layers, which then count as tops.
+    memory.internal = std::max(layer_internal_bytes_[i], int64_t(0));
+  }
 }
 
 template <typename Dtype>
@@ -535,7 +635,15 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
-    Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    Dtype layer_loss;
+    if (tracer_) {
+      NetTracer::Start trace_start;
+      tracer_->Begin(&trace_start);
+      layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+      tracer_->Add(layer_names_[i], i, false, trace_start, bottom_vecs_[i]);
+    } else {
+      layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    }
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
     for (int c = 0; c < after_forward_.size(); ++c) {
@@ -595,8 +703,16 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
       before_backward_[c]->run(i);
     }
     if (layer_need_backward_[i]) {
-      layers_[i]->Backward(
-          top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      if (tracer_) {
+        NetTracer::Start trace_start;
+        tracer_->Begin(&trace_start);
+        layers_[i]->Backward(
+            top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+        tracer_->Add(layer_names_[i], i, true, trace_start, bottom_vecs_[i]);
+      } else {
+        layers_[i]->Backward(
+            top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      }
       if (debug_info_) { BackwardDebugInfo(i); }
     }
     for (int c = 0; c < after_backward_.size(); ++c) {
@@ -713,7 +829,14 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
           << target_blobs[j]->shape_string();
       target_blobs[j]->ShareData(*source_blob);
     }
+    layers_[target_layer_id]->BlobsChanged();
   }
+  mapped_weights_.insert(mapped_weights_.end(),
+      other->mapped_weights_.begin(), other->mapped_weights_.end());
+  // The shared params no longer live in this net's flat buffer, so it can
+  // no longer be updated as a whole, but the other params and all diffs
+  // still do.
+  flat_params_.reset();
 }
 
 template <typename Dtype>
@@ -748,7 +871,7 @@ void Net<Dtype>::Backward() {
 template <typename Dtype>
 void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
-    layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    layers_[i]->ReshapeIfChanged(bottom_vecs_[i], top_vecs_[i]);
   }
 }
 
@@ -787,13 +910,16 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       const bool kReshape = false;
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
+    layers_[target_layer_id]->BlobsChanged();
   }
 }
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
-  if (H5Fis_hdf5(trained_filename.c_str())) {
+  if (hdf5_is_file(trained_filename)) {
     CopyTrainedLayersFromHDF5(trained_filename);
+  } else if (MappedWeights::IsWeightsFile(trained_filename)) {
+    CopyTrainedLayersFromMapped(trained_filename);
   } else {
     CopyTrainedLayersFromBinaryProto(trained_filename);
   }
@@ -809,6 +935,7 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -851,12 +978,49 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
       hdf5_load_nd_dataset(layer_hid, dataset_name.c_str(), 0, kMaxBlobAxes,
           target_blobs[j].get());
     }
+    layers_[target_layer_id]->BlobsChanged();
     H5Gclose(layer_hid);
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
 }
 
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromMapped(const string trained_filename) {
+  shared_ptr<MappedWeights> weights(new MappedWeights(trained_filename));
+  const vector<MappedWeights::Tensor>& tensors = weights->tensors();
+  set<int> target_layer_ids;
+  for (int i = 0; i < tensors.size(); ++i) {
+    const string& source_layer_name = tensors[i].layer;
+    if (!layer_names_index_.count(source_layer_name)) {
+      if (tensors[i].index == 0) {
+        LOG(INFO) << "Ignoring source layer " << source_layer_name;
+      }
+      continue;
+    }
+    const int target_layer_id = layer_names_index_[source_layer_name];
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[target_layer_id]->blobs();
+    const int j = tensors[i].index;
+    CHECK_LT(j, target_blobs.size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    if (target_blobs[j]->shape() != tensors[i].shape) {
+      LOG(FATAL) << "Cannot copy param " << j << " weights from layer '"
+          << source_layer_name << "'; shape mismatch.  Target param shape is "
+          << target_blobs[j]->shape_string() << ". "
+          << "To learn this layer's parameters from scratch rather than "
+          << "copying from a saved net, rename the layer.";
+    }
+    load_mapped_tensor(tensors[i], !flat_params_, target_blobs[j].get());
+    target_layer_ids.insert(target_layer_id);
+  }
+  for (set<int>::iterator it = target_layer_ids.begin();
+       it != target_layer_ids.end(); ++it) {
+    layers_[*it]->BlobsChanged();
+  }
+  mapped_weights_.push_back(weights);
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
@@ -869,8 +1033,34 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ToProto(NetParameter* param, bool write_diff,
+    const vector<shared_ptr<Blob<Dtype> > >& params) const {
+  CHECK_EQ(params.size(), params_.size());
+  param->Clear();
+  param->set_name(name_);
+  for (int i = 0; i < layers_.size(); ++i) {
+    // As in Layer::ToProto
+    LayerParameter* layer_param = param->add_layer();
+    layer_param->CopyFrom(layers_[i]->layer_param());
+    layer_param->clear_blobs();
+    for (int j = 0; j < param_id_vecs_[i].size(); ++j) {
+      params[param_id_vecs_[i][j]]->ToProto(layer_param->add_blobs(),
+                                            write_diff);
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+  ToHDF5(filename, write_diff, params_);
+}
+
+template <typename Dtype>
+void Net<Dtype>::ToHDF5(const string& filename, bool write_diff,
+    const vector<shared_ptr<Blob<Dtype> > >& params) const {
+  CHECK_EQ(params.size(), params_.size());
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -906,12 +1096,12 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
       if (param_owners_[net_param_id] == -1) {
         // Only save params that own themselves
         hdf5_save_nd_dataset<Dtype>(layer_data_hid, dataset_name.str(),
-            *params_[net_param_id]);
+            *params[net_param_id]);
       }
       if (write_diff) {
         // Write diffs regardless of weight-sharing
         hdf5_save_nd_dataset<Dtype>(layer_diff_hid, dataset_name.str(),
-            *params_[net_param_id], true);
+            *params[net_param_id], true);
       }
     }
     H5Gclose(layer_data_hid);
@@ -928,6 +1118,10 @@ void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::Update() {
+  if (flat_params_) {
+    flat_params_->Update();
+    return;
+  }
   for (int i = 0; i < learnable_params_.size(); ++i) {
     learnable_params_[i]->Update();
   }
@@ -935,6 +1129,11 @@ void Net<Dtype>::Update() {
 
 template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
+  if (flat_params_) {
+    caffe_set(flat_params_->count(), static_cast<Dtype>(0),
+              flat_params_->mutable_cpu_diff());
+    return;
+  }
   for (int i = 0; i < learnable_params_.size(); ++i) {
     Blob<Dtype>* blob = learnable_params_[i];
     switch (Caffe::mode()) {
@@ -954,6 +1153,54 @@ void Net<Dtype>::ClearParamDiffs() {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::FlattenParams() {
+  if (Caffe::mode() != Caffe::CPU) {
+    LOG(WARNING) << "Ignoring flat_params, which is only used in CPU mode.";
+    return;
+  }
+  int count = 0;
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    count += learnable_params_[i]->count();
+  }
+  if (count == 0) {
+    return;
+  }
+  // Moving memory that is also referenced from outside this net, e.g. by
+  // NetWeights or another net, would move it for them too, into a buffer
+  // they do not keep alive. Params sharing an owner in this net share its
+  // SyncedMemory, so count those references.
+  map<const SyncedMemory*, int> net_references;
+  for (int i = 0; i < params_.size(); ++i) {
+    ++net_references[params_[i]->data().get()];
+    ++net_references[params_[i]->diff().get()];
+  }
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    const shared_ptr<SyncedMemory>& data = learnable_params_[i]->data();
+    const shared_ptr<SyncedMemory>& diff = learnable_params_[i]->diff();
+    if (data.use_count() > net_references[data.get()] ||
+        diff.use_count() > net_references[diff.get()]) {
+      LOG(WARNING) << "Ignoring flat_params, as the params share memory "
+                   << "with NetWeights or another net.";
+      return;
+    }
+  }
+  flat_params_.reset(new Blob<Dtype>(vector<int>(1, count)));
+  flat_storage_ = flat_params_;
+  Dtype* data = flat_params_->mutable_cpu_data();
+  Dtype* diff = flat_params_->mutable_cpu_diff();
+  // Params sharing an owner share its SyncedMemory, so they follow it.
+  for (int i = 0; i < learnable_params_.size(); ++i) {
+    Blob<Dtype>* param = learnable_params_[i];
+    caffe_copy(param->count(), param->cpu_data(), data);
+    caffe_copy(param->count(), param->cpu_diff(), diff);
+    param->data()->set_cpu_data(data);
+    param->diff()->set_cpu_data(diff);
+    data += param->count();
+    diff += param->count();
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ShareWeights() {
   for (int i = 0; i < params_.size(); ++i) {
@@ -999,6 +1246,20 @@ const shared_ptr<Layer<Dtype> > Net<Dtype>::layer_by_name(
   return layer_ptr;
 }
 
+template <typename Dtype>
+vector<BasePrefetchingDataLayer<Dtype>*>
+Net<Dtype>::prefetching_layers() const {
+  vector<BasePrefetchingDataLayer<Dtype>*> prefetching;
+  for (int i = 0; i < layers_.size(); ++i) {
+    BasePrefetchingDataLayer<Dtype>* layer =
+        dynamic_cast<BasePrefetchingDataLayer<Dtype>*>(layers_[i].get());
+    if (layer) {
+      prefetching.push_back(layer);
+    }
+  }
+  return prefetching;
+}
+
 /**
  * This class is the core of memory optimization
  * It simulates an abstract ``slot'' with shared by multiple syncedmem instances.
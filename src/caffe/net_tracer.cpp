@@ -0,0 +1,96 @@
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/net_tracer.hpp"
+
+namespace caffe {
+
+class NetTracer::sync {
+ public:
+  boost::mutex mutex_;
+};
+
+NetTracer::NetTracer(int capacity, bool count_events)
+    : records_(capacity), recorded_(0), count_events_(count_events),
+      sync_(new sync()) {
+  CHECK_GT(capacity, 0) << "A tracer needs room for at least one record";
+}
+
+int64_t NetTracer::Now() {
+  static const boost::posix_time::ptime epoch(
+      boost::gregorian::date(1970, 1, 1));
+  return (boost::posix_time::microsec_clock::universal_time() - epoch)
+      .total_microseconds();
+}
+
+void NetTracer::Begin(Start* start) const {
+  if (count_events_) {
+    PerfCounters::ForThread()->Read(start->counts);
+  } else {
+    std::fill(start->counts, start->counts + PerfCounters::NUM_EVENTS, -1);
+  }
+  start->time = Now();
+}
+
+template <typename Dtype>
+void NetTracer::Add(const string& layer_name, int layer, bool backward,
+    const Start& start, const vector<Blob<Dtype>*>& bottom) {
+  const int64_t end = Now();
+  int64_t counts[PerfCounters::NUM_EVENTS];
+  if (count_events_) {
+    PerfCounters::ForThread()->Read(counts);
+  }
+  for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i) {
+    counts[i] = start.counts[i] >= 0 ? counts[i] - start.counts[i] : -1;
+  }
+  const size_t thread =
+      boost::hash<boost::thread::id>()(boost::this_thread::get_id());
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  Record& record = records_[recorded_ % records_.size()];
+  record.layer_name = layer_name;
+  record.layer = layer;
+  record.backward = backward;
+  record.start = start.time;
+  record.end = end;
+  std::copy(counts, counts + PerfCounters::NUM_EVENTS, record.counts);
+  record.thread = thread;
+  // Reuses the capacity of the overwritten record
+  record.bottom_shapes.clear();
+  for (int i = 0; i < bottom.size(); ++i) {
+    record.bottom_shapes.push_back(bottom[i]->num_axes());
+    for (int j = 0; j < bottom[i]->num_axes(); ++j) {
+      record.bottom_shapes.push_back(bottom[i]->shape(j));
+    }
+  }
+  ++recorded_;
+}
+
+template void NetTracer::Add(const string& layer_name, int layer,
+    bool backward, const Start& start, const vector<Blob<float>*>& bottom);
+template void NetTracer::Add(const string& layer_name, int layer,
+    bool backward, const Start& start, const vector<Blob<double>*>& bottom);
+
+void NetTracer::Records(vector<Record>* records) const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  const int64_t size = std::min<int64_t>(recorded_, records_.size());
+  records->clear();
+  for (int64_t i = recorded_ - size; i < recorded_; ++i) {
+    records->push_back(records_[i % records_.size()]);
+  }
+}
+
+int64_t NetTracer::recorded() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return recorded_;
+}
+
+void NetTracer::Clear() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  recorded_ = 0;
+}
+
+}  // namespace caffe
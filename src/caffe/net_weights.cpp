@@ -0,0 +1,117 @@
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+
+#include "caffe/net_weights.hpp"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+NetWeights<Dtype>::NetWeights(const string& trained_filename) {
+  if (hdf5_is_file(trained_filename)) {
+    LoadHDF5(trained_filename);
+  } else if (MappedWeights::IsWeightsFile(trained_filename)) {
+    LoadMapped(trained_filename);
+  } else {
+    LoadBinaryProto(trained_filename);
+  }
+  LOG(INFO) << "Loaded the weights of " << layers_.size() << " layers from "
+            << trained_filename;
+}
+
+template <typename Dtype>
+bool NetWeights<Dtype>::Share(const string& layer_name,
+    vector<shared_ptr<Blob<Dtype> > >* blobs) const {
+  typename map<string, vector<shared_ptr<Blob<Dtype> > > >::const_iterator
+      it = layers_.find(layer_name);
+  if (it == layers_.end()) {
+    return false;
+  }
+  // Each net gets its own blobs, so that setting up one net (e.g. sharing
+  // params within it) leaves the others alone. Their diffs are allocated
+  // only if used.
+  const vector<shared_ptr<Blob<Dtype> > >& weights = it->second;
+  blobs->resize(weights.size());
+  for (int i = 0; i < weights.size(); ++i) {
+    CHECK(weights[i]) << "Missing param " << i << " of layer " << layer_name;
+    (*blobs)[i].reset(new Blob<Dtype>(weights[i]->shape()));
+    (*blobs)[i]->ShareData(*weights[i]);
+  }
+  return true;
+}
+
+template <typename Dtype>
+void NetWeights<Dtype>::LoadBinaryProto(const string& trained_filename) {
+  NetParameter param;
+  ReadNetParamsFromBinaryFileOrDie(trained_filename, &param);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    if (layer_param.blobs_size() == 0) {
+      continue;
+    }
+    vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_param.name()];
+    blobs.resize(layer_param.blobs_size());
+    for (int j = 0; j < blobs.size(); ++j) {
+      blobs[j].reset(new Blob<Dtype>());
+      blobs[j]->FromProto(layer_param.blobs(j));
+    }
+  }
+}
+
+template <typename Dtype>
+void NetWeights<Dtype>::LoadHDF5(const string& trained_filename) {
+  HDF5Lock lock;
+  hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
+                           H5P_DEFAULT);
+  CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
+  hid_t data_hid = H5Gopen2(file_hid, "data", H5P_DEFAULT);
+  CHECK_GE(data_hid, 0) << "Error reading weights from " << trained_filename;
+  int num_layers = hdf5_get_num_links(data_hid);
+  for (int i = 0; i < num_layers; ++i) {
+    string layer_name = hdf5_get_name_by_idx(data_hid, i);
+    hid_t layer_hid = H5Gopen2(data_hid, layer_name.c_str(), H5P_DEFAULT);
+    CHECK_GE(layer_hid, 0)
+        << "Error reading weights from " << trained_filename;
+    // The datasets are named by param index; params shared from another
+    // layer may be missing.
+    int num_params = hdf5_get_num_links(layer_hid);
+    for (int j = 0; j < num_params; ++j) {
+      const string dataset_name = hdf5_get_name_by_idx(layer_hid, j);
+      const int index = atoi(dataset_name.c_str());
+      vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[layer_name];
+      if (blobs.size() <= index) {
+        blobs.resize(index + 1);
+      }
+      blobs[index].reset(new Blob<Dtype>());
+      hdf5_load_nd_dataset(layer_hid, dataset_name.c_str(), 0, kMaxBlobAxes,
+          blobs[index].get());
+    }
+    H5Gclose(layer_hid);
+  }
+  H5Gclose(data_hid);
+  H5Fclose(file_hid);
+}
+
+template <typename Dtype>
+void NetWeights<Dtype>::LoadMapped(const string& trained_filename) {
+  mapped_weights_.reset(new MappedWeights(trained_filename));
+  const vector<MappedWeights::Tensor>& tensors = mapped_weights_->tensors();
+  for (int i = 0; i < tensors.size(); ++i) {
+    vector<shared_ptr<Blob<Dtype> > >& blobs = layers_[tensors[i].layer];
+    if (blobs.size() <= tensors[i].index) {
+      blobs.resize(tensors[i].index + 1);
+    }
+    shared_ptr<Blob<Dtype> >& blob = blobs[tensors[i].index];
+    blob.reset(new Blob<Dtype>(tensors[i].shape));
+    load_mapped_tensor(tensors[i], true, blob.get());
+  }
+}
+
+INSTANTIATE_CLASS(NetWeights);
+
+}  // namespace caffe
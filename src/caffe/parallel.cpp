@@ -1,6 +1,6 @@
 #ifdef USE_NCCL
-
 #include <cuda_runtime.h>
+#endif
 #include <glog/logging.h>
 #include <stdio.h>
 #include <sstream>
@@ -72,6 +72,286 @@ Params<Dtype>::Params(shared_ptr<Solver<Dtype> > root_solver)
     diff_() {
 }
 
+template<typename Dtype>
+CPUParams<Dtype>::CPUParams(shared_ptr<Solver<Dtype> > root_solver)
+  : Params<Dtype>(root_solver) {
+  data_ = new Dtype[size_];
+  diff_ = new Dtype[size_];
+  // Copy blob values
+  const vector<Blob<Dtype>*>& net =
+    root_solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, copy);
+  caffe_set(size_, Dtype(0), diff_);
+}
+
+template<typename Dtype>
+CPUParams<Dtype>::~CPUParams() {
+  delete[] data_;
+  delete[] diff_;
+}
+
+template<typename Dtype>
+void CPUParams<Dtype>::Configure(Solver<Dtype>* solver) const {
+  const vector<Blob<Dtype>*>& net =
+    solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, replace_cpu);
+  apply_buffers(net, diff_, size_, replace_cpu_diff);
+  // The buffers have the same layout as the net's flat params, if any.
+  const shared_ptr<Blob<Dtype> >& flat_params = solver->net()->flat_params();
+  if (flat_params) {
+    flat_params->data()->set_cpu_data(data_);
+    flat_params->diff()->set_cpu_data(diff_);
+  }
+}
+
+template<typename Dtype>
+CPUSync<Dtype>::CPUSync(shared_ptr<Solver<Dtype> > solver)
+  : CPUParams<Dtype>(solver),
+    solver_(solver), syncs_(), barrier_() {
+  this->Configure(solver.get());
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::set_peers(vector<CPUSync<Dtype>*>* syncs,
+                               boost::barrier* barrier) {
+  syncs_ = syncs;
+  barrier_ = barrier;
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::Broadcast() {
+  barrier_->wait();
+  if (Caffe::solver_rank() != 0) {
+    caffe_copy(size_, (*syncs_)[0]->data_, data_);
+  }
+  barrier_->wait();
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::Allreduce(size_t offset, size_t count) {
+  // Wait for all gradients, then average slice rank of them into every
+  // solver's buffer, and wait for the other slices.
+  barrier_->wait();
+  const int solvers = syncs_->size();
+  const int rank = Caffe::solver_rank();
+  const size_t begin = offset + count * rank / solvers;
+  const int size = static_cast<int>(offset + count * (rank + 1) / solvers
+                                    - begin);
+  Dtype* slice = diff_ + begin;
+  for (int i = 0; i < solvers; ++i) {
+    if (i != rank) {
+      caffe_axpy(size, Dtype(1), (*syncs_)[i]->diff_ + begin, slice);
+    }
+  }
+  caffe_scal(size, Dtype(1) / solvers, slice);
+  for (int i = 0; i < solvers; ++i) {
+    if (i != rank) {
+      caffe_copy(size, slice, (*syncs_)[i]->diff_ + begin);
+    }
+  }
+  barrier_->wait();
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::run(int layer) {
+  CHECK(solver_->param().layer_wise_reduce());
+  vector<shared_ptr<Blob<Dtype> > >& blobs =
+    solver_->net()->layers()[layer]->blobs();
+  if (blobs.size() > 0) {
+    // Blobs of a layer are contiguous, see Configure
+    size_t size = 0;
+    for (int i = 0; i < blobs.size(); ++i) {
+      size += blobs[i]->count();
+    }
+    Allreduce(blobs[0]->cpu_diff() - diff_, size);
+  }
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::on_gradients_ready() {
+  if (solver_->param().layer_wise_reduce()) {
+    CHECK_EQ(solver_->net()->params().size(),
+             solver_->net()->learnable_params().size())
+      << "Layer-wise reduce is not supported for nets with shared weights.";
+  } else {
+    Allreduce(0, size_);
+  }
+}
+
+template<typename Dtype>
+class CPUWorker : public InternalThread {
+ public:
+  explicit CPUWorker(shared_ptr<Solver<Dtype> > rank0,
+                     boost::barrier* barrier, vector<CPUSync<Dtype>*>* syncs,
+                     const char* restore)
+    : rank0_(rank0), barrier_(barrier), syncs_(syncs), restore_(restore) {
+  }
+  virtual ~CPUWorker() {}
+
+ protected:
+  void InternalThreadEntry() {
+    // Create solver and install callbacks
+    SolverParameter param(rank0_->param());
+    param.set_type(rank0_->type());
+    shared_ptr<Solver<Dtype> > s(SolverRegistry<Dtype>::CreateSolver(param));
+    CHECK_EQ(s->type(), rank0_->type());
+    if (restore_) {
+      s->Restore(restore_);
+    }
+    CPUSync<Dtype> sync(s);
+    sync.set_peers(syncs_, barrier_);
+    s->add_callback(&sync);
+    if (s->param().layer_wise_reduce()) {
+      s->net()->add_after_backward(&sync);
+    }
+    (*syncs_)[Caffe::solver_rank()] = &sync;
+    // Wait for other threads
+    barrier_->wait();
+    // Broadcast rank 0 state
+    sync.Broadcast();
+    // Solve
+    s->Step(param.max_iter() - s->iter());
+    barrier_->wait();
+  }
+
+  shared_ptr<Solver<Dtype> > rank0_;
+  boost::barrier* barrier_;
+  vector<CPUSync<Dtype>*>* syncs_;
+  const char* restore_;
+};
+
+template<typename Dtype>
+void CPUSync<Dtype>::Run(const char* restore) {
+  const int solvers = Caffe::solver_count();
+  boost::barrier barrier(solvers);
+  vector<CPUSync<Dtype>*> syncs(solvers);
+  // Create workers
+  vector<shared_ptr<CPUWorker<Dtype> > > workers(solvers);
+  for (int i = 1; i < solvers; ++i) {
+    Caffe::set_solver_rank(i);
+    CPUWorker<Dtype>* w = new CPUWorker<Dtype>(solver_, &barrier, &syncs,
+                                               restore);
+    w->StartInternalThread();
+    workers[i].reset(w);
+  }
+  Caffe::set_solver_rank(0);
+  set_peers(&syncs, &barrier);
+  solver_->add_callback(this);
+  if (solver_->param().layer_wise_reduce()) {
+    solver_->net()->add_after_backward(this);
+  }
+  syncs[0] = this;
+  // Wait for workers
+  barrier.wait();
+  // Run first solver on current thread
+  Broadcast();
+  solver_->Solve();
+  barrier.wait();
+  // Wait for shutdown
+  for (int i = 1; i < solvers; ++i) {
+    workers[i]->StopInternalThread();
+  }
+}
+
+template<typename Dtype>
+RingSync<Dtype>::RingSync(shared_ptr<Solver<Dtype> > solver,
+                          shared_ptr<Transport> transport)
+  : CPUParams<Dtype>(solver),
+    solver_(solver), transport_(transport), pending_() {
+  CHECK_EQ(transport->rank(), Caffe::solver_rank());
+  CHECK_EQ(transport->size(), Caffe::solver_count());
+  this->Configure(solver.get());
+  const vector<shared_ptr<Layer<Dtype> > >& layers = solver->net()->layers();
+  layer_offsets_.resize(layers.size());
+  layer_counts_.resize(layers.size());
+  for (int i = 0; i < layers.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& blobs = layers[i]->blobs();
+    if (blobs.size() > 0) {
+      // Blobs of a layer are contiguous, see Configure
+      layer_offsets_[i] = blobs[0]->cpu_diff() - diff_;
+      for (int j = 0; j < blobs.size(); ++j) {
+        layer_counts_[i] += blobs[j]->count();
+      }
+    }
+  }
+}
+
+template<typename Dtype>
+RingSync<Dtype>::~RingSync() {
+  this->StopInternalThread();
+}
+
+template<typename Dtype>
+void RingSync<Dtype>::Broadcast() {
+  ring_broadcast(transport_.get(), data_, size_);
+}
+
+template<typename Dtype>
+void RingSync<Dtype>::Allreduce(size_t offset, size_t count) {
+  ring_allreduce(transport_.get(), diff_ + offset, count, &reduce_buffer_);
+  caffe_scal(static_cast<int>(count), Dtype(1) / transport_->size(),
+             diff_ + offset);
+}
+
+template<typename Dtype>
+void RingSync<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      const int layer = reduce_queue_.pop();
+      Allreduce(layer_offsets_[layer], layer_counts_[layer]);
+      reduced_queue_.push(layer);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+template<typename Dtype>
+void RingSync<Dtype>::run(int layer) {
+  CHECK(solver_->param().layer_wise_reduce());
+  if (layer_counts_[layer] > 0) {
+    // The backward of the layers below does not touch these gradients, so
+    // they can be reduced meanwhile.
+    reduce_queue_.push(layer);
+    ++pending_;
+  }
+}
+
+template<typename Dtype>
+void RingSync<Dtype>::on_gradients_ready() {
+  if (solver_->param().layer_wise_reduce()) {
+    CHECK_EQ(solver_->net()->params().size(),
+             solver_->net()->learnable_params().size())
+      << "Layer-wise reduce is not supported for nets with shared weights.";
+    // Make sure reduction is done before applying gradients
+    for (; pending_ > 0; --pending_) {
+      reduced_queue_.pop();
+    }
+  } else {
+    Allreduce(0, size_);
+  }
+}
+
+template<typename Dtype>
+void RingSync<Dtype>::Run() {
+  solver_->add_callback(this);
+  if (solver_->param().layer_wise_reduce()) {
+    // Gradients must not change while the thread reduces them.
+    CHECK_EQ(solver_->param().iter_size(), 1)
+      << "Layer-wise reduce over a transport requires iter_size 1.";
+    solver_->net()->add_after_backward(this);
+    this->StartInternalThread();
+  }
+  Broadcast();
+  if (Caffe::root_solver()) {
+    solver_->Solve();
+  } else {
+    solver_->Step(solver_->param().max_iter() - solver_->iter());
+  }
+}
+
+#ifdef USE_NCCL
+
 template<typename Dtype>
 GPUParams<Dtype>::GPUParams(shared_ptr<Solver<Dtype> > root_solver, int device)
   : Params<Dtype>(root_solver) {
@@ -361,11 +641,17 @@ void NCCL<Dtype>::Run(const vector<int>& gpus, const char* restore) {
   }
 }
 
+#endif  // USE_NCCL
+
 INSTANTIATE_CLASS(Params);
+INSTANTIATE_CLASS(CPUParams);
+INSTANTIATE_CLASS(CPUWorker);
+INSTANTIATE_CLASS(CPUSync);
+INSTANTIATE_CLASS(RingSync);
+#ifdef USE_NCCL
 INSTANTIATE_CLASS(GPUParams);
 INSTANTIATE_CLASS(Worker);
 INSTANTIATE_CLASS(NCCL);
+#endif
 
 }  // namespace caffe
-
-#endif  // USE_NCCL
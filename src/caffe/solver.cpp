@@ -1,3 +1,7 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/thread.hpp>
 #include <cstdio>
 
 #include <string>
@@ -7,10 +11,22 @@
 #include "caffe/util/format.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/upgrade_proto.hpp"
 
 namespace caffe {
 
+// Flushes a snapshot file to disk.
+static void SyncFile(const string& filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0 || fsync(fd) != 0) {
+    LOG(WARNING) << "Could not sync " << filename << " to disk";
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
 template<typename Dtype>
 void Solver<Dtype>::SetActionFunction(ActionCallback func) {
   action_request_function_ = func;
@@ -27,18 +43,23 @@ SolverAction::Enum Solver<Dtype>::GetRequestedAction() {
 
 template <typename Dtype>
 Solver<Dtype>::Solver(const SolverParameter& param)
-    : net_(), callbacks_(), requested_early_exit_(false) {
+    : net_(), callbacks_(), requested_early_exit_(false), snapshot_iter_() {
   Init(param);
 }
 
 template <typename Dtype>
 Solver<Dtype>::Solver(const string& param_file)
-    : net_(), callbacks_(), requested_early_exit_(false) {
+    : net_(), callbacks_(), requested_early_exit_(false), snapshot_iter_() {
   SolverParameter param;
   ReadSolverParamsFromTextFileOrDie(param_file, &param);
   Init(param);
 }
 
+template <typename Dtype>
+Solver<Dtype>::~Solver() {
+  WaitForSnapshot();
+}
+
 template <typename Dtype>
 void Solver<Dtype>::Init(const SolverParameter& param) {
   LOG_IF(INFO, Caffe::root_solver()) << "Initializing solver from parameters: "
@@ -290,6 +311,7 @@ void Solver<Dtype>::Solve(const char* resume_file) {
       && (!param_.snapshot() || iter_ % param_.snapshot() != 0)) {
     Snapshot();
   }
+  WaitForSnapshot();
   if (requested_early_exit_) {
     LOG(INFO) << "Optimization stopped early.";
     return;
@@ -402,6 +424,14 @@ void Solver<Dtype>::Test(const int test_net_id) {
 template <typename Dtype>
 void Solver<Dtype>::Snapshot() {
   CHECK(Caffe::root_solver());
+  if (param_.snapshot_async()) {
+    // Write one snapshot at a time, so that copies do not pile up.
+    WaitForSnapshot();
+    StageSnapshot();
+    snapshot_thread_.reset(
+        new boost::thread(&Solver<Dtype>::WriteSnapshot, this));
+    return;
+  }
   string model_filename;
   switch (param_.snapshot_format()) {
   case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
@@ -417,6 +447,60 @@ void Solver<Dtype>::Snapshot() {
   SnapshotSolverState(model_filename);
 }
 
+template <typename Dtype>
+void Solver<Dtype>::WaitForSnapshot() {
+  if (snapshot_thread_) {
+    snapshot_thread_->join();
+    snapshot_thread_.reset();
+  }
+}
+
+template <typename Dtype>
+void Solver<Dtype>::StageSnapshot() {
+  snapshot_iter_ = iter_;
+  const vector<shared_ptr<Blob<Dtype> > >& params = net_->params();
+  snapshot_params_.resize(params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    if (!snapshot_params_[i]) {
+      snapshot_params_[i].reset(new Blob<Dtype>());
+    }
+    snapshot_params_[i]->ReshapeLike(*params[i]);
+    caffe_copy(params[i]->count(), params[i]->cpu_data(),
+               snapshot_params_[i]->mutable_cpu_data());
+    if (param_.snapshot_diff()) {
+      caffe_copy(params[i]->count(), params[i]->cpu_diff(),
+                 snapshot_params_[i]->mutable_cpu_diff());
+    }
+  }
+  StageSolverState();
+}
+
+template <typename Dtype>
+void Solver<Dtype>::WriteSnapshot() {
+  string model_filename;
+  switch (param_.snapshot_format()) {
+  case caffe::SolverParameter_SnapshotFormat_BINARYPROTO: {
+    model_filename = SnapshotFilename(".caffemodel", snapshot_iter_);
+    LOG(INFO) << "Snapshotting to binary proto file " << model_filename;
+    NetParameter net_param;
+    net_->ToProto(&net_param, param_.snapshot_diff(), snapshot_params_);
+    WriteProtoToBinaryFile(net_param, model_filename);
+    break;
+  }
+  case caffe::SolverParameter_SnapshotFormat_HDF5:
+    model_filename = SnapshotFilename(".caffemodel.h5", snapshot_iter_);
+    LOG(INFO) << "Snapshotting to HDF5 file " << model_filename;
+    // Takes the HDF5Lock, like the solver state writer, as HDF5 data layers
+    // may be reading on other threads meanwhile.
+    net_->ToHDF5(model_filename, param_.snapshot_diff(), snapshot_params_);
+    break;
+  default:
+    LOG(FATAL) << "Unsupported snapshot format.";
+  }
+  SyncFile(model_filename);
+  SyncFile(SnapshotStagedSolverState(model_filename));
+}
+
 template <typename Dtype>
 void Solver<Dtype>::CheckSnapshotWritePermissions() {
   if (Caffe::root_solver() && param_.snapshot()) {
@@ -437,7 +521,12 @@ void Solver<Dtype>::CheckSnapshotWritePermissions() {
 
 template <typename Dtype>
 string Solver<Dtype>::SnapshotFilename(const string extension) {
-  return param_.snapshot_prefix() + "_iter_" + caffe::format_int(iter_)
+  return SnapshotFilename(extension, iter_);
+}
+
+template <typename Dtype>
+string Solver<Dtype>::SnapshotFilename(const string extension, int iter) {
+  return param_.snapshot_prefix() + "_iter_" + caffe::format_int(iter)
     + extension;
 }
 
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -106,6 +107,36 @@ void AdaDeltaSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+// h holds the history of gradients and h2 the history of updates.
+template <typename Dtype>
+static void adadelta_fused_update_cpu(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype* h2, Dtype norm, Dtype decay, Dtype momentum, Dtype delta,
+    Dtype local_rate) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < N; ++i) {
+    const Dtype gi = norm * g[i] + decay * w[i];
+    const Dtype hi = h[i] = momentum * h[i] + (1 - momentum) * gi * gi;
+    const Dtype ui = gi * std::sqrt((h2[i] + delta) / (hi + delta));
+    h2[i] = momentum * h2[i] + (1 - momentum) * ui * ui;
+    g[i] = local_rate * ui;
+    w[i] -= local_rate * ui;
+  }
+}
+
+template <typename Dtype>
+void AdaDeltaSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  size_t update_history_offset = this->net_->learnable_params().size();
+  adadelta_fused_update_cpu(param->count(), param->mutable_cpu_data(),
+      param->mutable_cpu_diff(), this->history_[param_id]->mutable_cpu_data(),
+      this->history_[update_history_offset + param_id]->mutable_cpu_data(),
+      Dtype(1) / this->param_.iter_size(), this->LocalDecay(param_id),
+      Dtype(this->param_.momentum()), Dtype(this->param_.delta()),
+      rate * this->net_->params_lr()[param_id]);
+}
+
 INSTANTIATE_CLASS(AdaDeltaSolver);
 REGISTER_SOLVER_CLASS(AdaDelta);
 
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "caffe/sgd_solvers.hpp"
@@ -63,6 +64,30 @@ void AdaGradSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+static void adagrad_fused_update_cpu(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype norm, Dtype decay, Dtype delta, Dtype local_rate) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < N; ++i) {
+    const Dtype gi = norm * g[i] + decay * w[i];
+    const Dtype hi = h[i] = h[i] + gi * gi;
+    const Dtype ui = local_rate * gi / (std::sqrt(hi) + delta);
+    g[i] = ui;
+    w[i] -= ui;
+  }
+}
+
+template <typename Dtype>
+void AdaGradSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  adagrad_fused_update_cpu(param->count(), param->mutable_cpu_data(),
+      param->mutable_cpu_diff(), this->history_[param_id]->mutable_cpu_data(),
+      Dtype(1) / this->param_.iter_size(), this->LocalDecay(param_id),
+      Dtype(this->param_.delta()), rate * this->net_->params_lr()[param_id]);
+}
+
 INSTANTIATE_CLASS(AdaGradSolver);
 REGISTER_SOLVER_CLASS(AdaGrad);
 
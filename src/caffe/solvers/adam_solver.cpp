@@ -88,6 +88,41 @@ void AdamSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+static void adam_fused_update_cpu(int N, Dtype* w, Dtype* g, Dtype* m,
+    Dtype* v, Dtype norm, Dtype decay, Dtype beta1, Dtype beta2,
+    Dtype eps_hat, Dtype corrected_local_rate) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < N; ++i) {
+    const Dtype gi = norm * g[i] + decay * w[i];
+    const Dtype mi = m[i] = beta1 * m[i] + (1 - beta1) * gi;
+    const Dtype vi = v[i] = beta2 * v[i] + (1 - beta2) * gi * gi;
+    const Dtype ui = corrected_local_rate * mi / (std::sqrt(vi) + eps_hat);
+    g[i] = ui;
+    w[i] -= ui;
+  }
+}
+
+template <typename Dtype>
+void AdamSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  Blob<Dtype>* param = net_params[param_id];
+  size_t update_history_offset = net_params.size();
+  const Dtype beta1 = this->param_.momentum();
+  const Dtype beta2 = this->param_.momentum2();
+  const int t = this->iter_ + 1;
+  const Dtype correction = std::sqrt(Dtype(1) - pow(beta2, t)) /
+      (Dtype(1.) - pow(beta1, t));
+  adam_fused_update_cpu(param->count(), param->mutable_cpu_data(),
+      param->mutable_cpu_diff(), this->history_[param_id]->mutable_cpu_data(),
+      this->history_[param_id + update_history_offset]->mutable_cpu_data(),
+      Dtype(1) / this->param_.iter_size(), this->LocalDecay(param_id),
+      beta1, beta2, Dtype(this->param_.delta()),
+      rate * this->net_->params_lr()[param_id] * correction);
+}
+
 INSTANTIATE_CLASS(AdamSolver);
 REGISTER_SOLVER_CLASS(Adam);
 
@@ -55,6 +55,32 @@ void NesterovSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+template <typename Dtype>
+static void nesterov_fused_update_cpu(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype norm, Dtype decay, Dtype momentum, Dtype local_rate) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < N; ++i) {
+    const Dtype gi = norm * g[i] + decay * w[i];
+    const Dtype hi = h[i];
+    const Dtype hi_new = h[i] = momentum * hi + local_rate * gi;
+    const Dtype ui = (1 + momentum) * hi_new - momentum * hi;
+    g[i] = ui;
+    w[i] -= ui;
+  }
+}
+
+template <typename Dtype>
+void NesterovSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  nesterov_fused_update_cpu(param->count(), param->mutable_cpu_data(),
+      param->mutable_cpu_diff(), this->history_[param_id]->mutable_cpu_data(),
+      Dtype(1) / this->param_.iter_size(), this->LocalDecay(param_id),
+      Dtype(this->param_.momentum()),
+      rate * this->net_->params_lr()[param_id]);
+}
+
 INSTANTIATE_CLASS(NesterovSolver);
 REGISTER_SOLVER_CLASS(Nesterov);
 
@@ -82,9 +82,14 @@ void SGDSolver<Dtype>::ClipGradients() {
   const Dtype clip_gradients = this->param_.clip_gradients();
   if (clip_gradients < 0) { return; }
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
+  const shared_ptr<Blob<Dtype> >& flat_params = this->net_->flat_params();
   Dtype sumsq_diff = 0;
-  for (int i = 0; i < net_params.size(); ++i) {
-    sumsq_diff += net_params[i]->sumsq_diff();
+  if (flat_params) {
+    sumsq_diff = flat_params->sumsq_diff();
+  } else {
+    for (int i = 0; i < net_params.size(); ++i) {
+      sumsq_diff += net_params[i]->sumsq_diff();
+    }
   }
   const Dtype l2norm_diff = std::sqrt(sumsq_diff);
   if (l2norm_diff > clip_gradients) {
@@ -92,8 +97,12 @@ void SGDSolver<Dtype>::ClipGradients() {
     LOG(INFO) << "Gradient clipping: scaling down gradients (L2 norm "
         << l2norm_diff << " > " << clip_gradients << ") "
         << "by scale factor " << scale_factor;
-    for (int i = 0; i < net_params.size(); ++i) {
-      net_params[i]->scale_diff(scale_factor);
+    if (flat_params) {
+      flat_params->scale_diff(scale_factor);
+    } else {
+      for (int i = 0; i < net_params.size(); ++i) {
+        net_params[i]->scale_diff(scale_factor);
+      }
     }
   }
 }
@@ -106,13 +115,26 @@ void SGDSolver<Dtype>::ApplyUpdate() {
         << ", lr = " << rate;
   }
   ClipGradients();
+  const bool fused = Caffe::mode() == Caffe::CPU &&
+      this->param_.regularization_type() == "L2";
+  // Flat params are updated in one pass once all update values are known.
+  const bool flat = this->net_->flat_params().get() != NULL;
   for (int param_id = 0; param_id < this->net_->learnable_params().size();
        ++param_id) {
+    if (fused) {
+      ComputeFusedUpdate(param_id, rate);
+      continue;
+    }
     Normalize(param_id);
     Regularize(param_id);
     ComputeUpdateValue(param_id, rate);
+    if (!flat) {
+      this->net_->learnable_params()[param_id]->Update();
+    }
+  }
+  if (!fused && flat) {
+    this->net_->Update();
   }
-  this->net_->Update();
 }
 
 template <typename Dtype>
@@ -141,6 +163,12 @@ void SGDSolver<Dtype>::Normalize(int param_id) {
   }
 }
 
+template <typename Dtype>
+Dtype SGDSolver<Dtype>::LocalDecay(int param_id) const {
+  return this->param_.weight_decay() *
+      this->net_->params_weight_decay()[param_id];
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::Regularize(int param_id) {
   const vector<Blob<Dtype>*>& net_params = this->net_->learnable_params();
@@ -242,63 +270,125 @@ void SGDSolver<Dtype>::ComputeUpdateValue(int param_id, Dtype rate) {
   }
 }
 
+// Single pass of Normalize, Regularize, ComputeUpdateValue and Blob::Update,
+// where g is the gradient, w the weights and h the history.
+template <typename Dtype>
+static void sgd_fused_update_cpu(int N, Dtype* w, Dtype* g, Dtype* h,
+    Dtype norm, Dtype decay, Dtype momentum, Dtype local_rate) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int i = 0; i < N; ++i) {
+    const Dtype gi = norm * g[i] + decay * w[i];
+    const Dtype hi = h[i] = momentum * h[i] + local_rate * gi;
+    g[i] = hi;
+    w[i] -= hi;
+  }
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::ComputeFusedUpdate(int param_id, Dtype rate) {
+  Blob<Dtype>* param = this->net_->learnable_params()[param_id];
+  sgd_fused_update_cpu(param->count(), param->mutable_cpu_data(),
+      param->mutable_cpu_diff(), history_[param_id]->mutable_cpu_data(),
+      Dtype(1) / this->param_.iter_size(), LocalDecay(param_id),
+      Dtype(this->param_.momentum()),
+      rate * this->net_->params_lr()[param_id]);
+}
+
 template <typename Dtype>
 void SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename) {
+  SnapshotSolverState(model_filename, this->iter_, this->current_step_,
+                      history_);
+}
+
+template <typename Dtype>
+void SGDSolver<Dtype>::StageSolverState() {
+  staged_current_step_ = this->current_step_;
+  staged_history_.resize(history_.size());
+  for (int i = 0; i < history_.size(); ++i) {
+    if (!staged_history_[i]) {
+      staged_history_[i].reset(new Blob<Dtype>());
+    }
+    staged_history_[i]->ReshapeLike(*history_[i]);
+    caffe_copy(history_[i]->count(), history_[i]->cpu_data(),
+               staged_history_[i]->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+string SGDSolver<Dtype>::SnapshotStagedSolverState(
+    const string& model_filename) {
+  return SnapshotSolverState(model_filename, this->snapshot_iter_,
+                             staged_current_step_, staged_history_);
+}
+
+template <typename Dtype>
+string SGDSolver<Dtype>::SnapshotSolverState(const string& model_filename,
+    int iter, int current_step,
+    const vector<shared_ptr<Blob<Dtype> > >& history) {
   switch (this->param_.snapshot_format()) {
     case caffe::SolverParameter_SnapshotFormat_BINARYPROTO:
-      SnapshotSolverStateToBinaryProto(model_filename);
-      break;
+      return SnapshotSolverStateToBinaryProto(model_filename, iter,
+                                              current_step, history);
     case caffe::SolverParameter_SnapshotFormat_HDF5:
-      SnapshotSolverStateToHDF5(model_filename);
-      break;
+      return SnapshotSolverStateToHDF5(model_filename, iter, current_step,
+                                       history);
     default:
       LOG(FATAL) << "Unsupported snapshot format.";
   }
+  return string();
 }
 
 template <typename Dtype>
-void SGDSolver<Dtype>::SnapshotSolverStateToBinaryProto(
-    const string& model_filename) {
+string SGDSolver<Dtype>::SnapshotSolverStateToBinaryProto(
+    const string& model_filename, int iter, int current_step,
+    const vector<shared_ptr<Blob<Dtype> > >& history) {
   SolverState state;
-  state.set_iter(this->iter_);
+  state.set_iter(iter);
   state.set_learned_net(model_filename);
-  state.set_current_step(this->current_step_);
+  state.set_current_step(current_step);
   state.clear_history();
-  for (int i = 0; i < history_.size(); ++i) {
+  for (int i = 0; i < history.size(); ++i) {
     // Add history
     BlobProto* history_blob = state.add_history();
-    history_[i]->ToProto(history_blob);
+    history[i]->ToProto(history_blob);
   }
-  string snapshot_filename = Solver<Dtype>::SnapshotFilename(".solverstate");
+  string snapshot_filename =
+      Solver<Dtype>::SnapshotFilename(".solverstate", iter);
   LOG(INFO)
     << "Snapshotting solver state to binary proto file " << snapshot_filename;
   WriteProtoToBinaryFile(state, snapshot_filename.c_str());
+  return snapshot_filename;
 }
 
 template <typename Dtype>
-void SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
-    const string& model_filename) {
+string SGDSolver<Dtype>::SnapshotSolverStateToHDF5(
+    const string& model_filename, int iter, int current_step,
+    const vector<shared_ptr<Blob<Dtype> > >& history) {
   string snapshot_filename =
-      Solver<Dtype>::SnapshotFilename(".solverstate.h5");
+      Solver<Dtype>::SnapshotFilename(".solverstate.h5", iter);
   LOG(INFO) << "Snapshotting solver state to HDF5 file " << snapshot_filename;
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(snapshot_filename.c_str(), H5F_ACC_TRUNC,
       H5P_DEFAULT, H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
       << "Couldn't open " << snapshot_filename << " to save solver state.";
-  hdf5_save_int(file_hid, "iter", this->iter_);
+  hdf5_save_int(file_hid, "iter", iter);
   hdf5_save_string(file_hid, "learned_net", model_filename);
-  hdf5_save_int(file_hid, "current_step", this->current_step_);
+  hdf5_save_int(file_hid, "current_step", current_step);
   hid_t history_hid = H5Gcreate2(file_hid, "history", H5P_DEFAULT, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(history_hid, 0)
       << "Error saving solver state to " << snapshot_filename << ".";
-  for (int i = 0; i < history_.size(); ++i) {
+  for (int i = 0; i < history.size(); ++i) {
     ostringstream oss;
     oss << i;
-    hdf5_save_nd_dataset<Dtype>(history_hid, oss.str(), *history_[i]);
+    hdf5_save_nd_dataset<Dtype>(history_hid, oss.str(), *history[i]);
   }
   H5Gclose(history_hid);
   H5Fclose(file_hid);
+  return snapshot_filename;
 }
 
 template <typename Dtype>
@@ -323,6 +413,7 @@ void SGDSolver<Dtype>::RestoreSolverStateFromBinaryProto(
 
 template <typename Dtype>
 void SGDSolver<Dtype>::RestoreSolverStateFromHDF5(const string& state_file) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(state_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open solver state file " << state_file;
   this->iter_ = hdf5_load_int(file_hid, "iter");
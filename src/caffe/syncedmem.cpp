@@ -1,11 +1,30 @@
+#include <boost/thread/tss.hpp>
+
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
+
+// The allocated bytes of each thread. It is never deleted, as memory may
+// still be freed while static objects are destroyed.
+static boost::thread_specific_ptr<int64_t>* thread_allocated_bytes_ =
+    new boost::thread_specific_ptr<int64_t>();
+
+int64_t SyncedMemory::thread_allocated_bytes() {
+  return thread_allocated_bytes_->get() ? *thread_allocated_bytes_->get() : 0;
+}
+
+void SyncedMemory::CountAllocated(int64_t bytes) {
+  if (!thread_allocated_bytes_->get()) {
+    thread_allocated_bytes_->reset(new int64_t(0));
+  }
+  *thread_allocated_bytes_->get() += bytes;
+}
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    version_(0) {
 #ifndef CPU_ONLY
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -15,7 +34,8 @@ SyncedMemory::SyncedMemory()
 
 SyncedMemory::SyncedMemory(size_t size)
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
-    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false) {
+    own_cpu_data_(false), cpu_malloc_use_cuda_(false), own_gpu_data_(false),
+    version_(0) {
 #ifndef CPU_ONLY
 #ifdef DEBUG
   CUDA_CHECK(cudaGetDevice(&device_));
@@ -27,11 +47,13 @@ SyncedMemory::~SyncedMemory() {
   check_device();
   if (cpu_ptr_ && own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CountAllocated(-static_cast<int64_t>(size_));
   }
 
 #ifndef CPU_ONLY
   if (gpu_ptr_ && own_gpu_data_) {
     CUDA_CHECK(cudaFree(gpu_ptr_));
+    CountAllocated(-static_cast<int64_t>(size_));
   }
 #endif  // CPU_ONLY
 }
@@ -41,6 +63,7 @@ inline void SyncedMemory::to_cpu() {
   switch (head_) {
   case UNINITIALIZED:
     CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CountAllocated(size_);
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -49,6 +72,7 @@ inline void SyncedMemory::to_cpu() {
 #ifndef CPU_ONLY
     if (cpu_ptr_ == NULL) {
       CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CountAllocated(size_);
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -69,6 +93,7 @@ inline void SyncedMemory::to_gpu() {
   switch (head_) {
   case UNINITIALIZED:
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    CountAllocated(size_);
     caffe_gpu_memset(size_, 0, gpu_ptr_);
     head_ = HEAD_AT_GPU;
     own_gpu_data_ = true;
@@ -76,6 +101,7 @@ inline void SyncedMemory::to_gpu() {
   case HEAD_AT_CPU:
     if (gpu_ptr_ == NULL) {
       CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+      CountAllocated(size_);
       own_gpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, cpu_ptr_, gpu_ptr_);
@@ -101,10 +127,12 @@ void SyncedMemory::set_cpu_data(void* data) {
   CHECK(data);
   if (own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CountAllocated(-static_cast<int64_t>(size_));
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  ++version_;
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -124,10 +152,12 @@ void SyncedMemory::set_gpu_data(void* data) {
   CHECK(data);
   if (own_gpu_data_) {
     CUDA_CHECK(cudaFree(gpu_ptr_));
+    CountAllocated(-static_cast<int64_t>(size_));
   }
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -137,6 +167,7 @@ void* SyncedMemory::mutable_cpu_data() {
   check_device();
   to_cpu();
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -145,6 +176,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
   head_ = HEAD_AT_GPU;
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -159,11 +191,9 @@ void SyncedMemory::Resize(size_t new_size) {
   } else {
     // we need to enlarge the underlying memory
     // For this we just discard currently allocated memory blocks and set the new size
-    size_ = new_size;
-    head_ = UNINITIALIZED;
-
     if (cpu_ptr_ && own_cpu_data_) {
       CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+      CountAllocated(-static_cast<int64_t>(size_));
     }
     cpu_ptr_ = NULL;
     own_cpu_data_ = false;
@@ -171,10 +201,14 @@ void SyncedMemory::Resize(size_t new_size) {
 #ifndef CPU_ONLY
     if (gpu_ptr_ && own_gpu_data_) {
       CUDA_CHECK(cudaFree(gpu_ptr_));
+      CountAllocated(-static_cast<int64_t>(size_));
     }
     gpu_ptr_ = NULL;
     own_gpu_data_ = false;
 #endif  // CPU_ONLY
+    size_ = new_size;
+    head_ = UNINITIALIZED;
+    ++version_;
   }
 }
 
@@ -184,6 +218,7 @@ void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   CHECK(head_ == HEAD_AT_CPU);
   if (gpu_ptr_ == NULL) {
     CUDA_CHECK(cudaMalloc(&gpu_ptr_, size_));
+    CountAllocated(size_);
     own_gpu_data_ = true;
   }
   const cudaMemcpyKind put = cudaMemcpyHostToDevice;
@@ -0,0 +1,200 @@
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Fills each batch with the number of batches loaded before it, and notes
+// whether the thread ever loads more batches than the net has released
+// plus the number of buffers.
+template <typename Dtype>
+class SequenceDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit SequenceDataLayer(const LayerParameter& param, int num = 2)
+      : BasePrefetchingDataLayer<Dtype>(param), num_(num), loaded_(),
+        released_(), overrun_() {}
+  virtual ~SequenceDataLayer() { this->StopInternalThread(); }
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    top[0]->Reshape(num_, 3, 1, 1);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+      this->prefetch_[i]->data_.Reshape(num_, 3, 1, 1);
+    }
+  }
+  virtual inline const char* type() const { return "SequenceData"; }
+
+  int queued() const { return this->prefetch_full_.size(); }
+  int free() const { return this->prefetch_free_.size(); }
+
+  // Blocks until the thread has loaded n batches.
+  void WaitLoaded(int n) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (loaded_ < n) {
+      condition_.wait(lock);
+    }
+  }
+  // Blocks until n batches are ready. The thread queues a batch right after
+  // loading it, so this only waits for the push after WaitLoaded(n).
+  void WaitQueued(int n) {
+    WaitLoaded(n);
+    while (queued() < n) {
+      boost::this_thread::yield();
+    }
+  }
+  // To call before each forward that releases the batch of the previous one.
+  void Release() {
+    boost::mutex::scoped_lock lock(mutex_);
+    ++released_;
+  }
+  bool overrun() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return overrun_;
+  }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch) {
+    int loaded;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (loaded_ >= released_ + static_cast<int>(this->prefetch_.size())) {
+        overrun_ = true;
+      }
+      loaded = loaded_++;
+    }
+    condition_.notify_all();
+    caffe_set(batch->data_.count(), Dtype(loaded),
+              batch->data_.mutable_cpu_data());
+  }
+
+  const int num_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  int loaded_, released_;
+  bool overrun_;
+};
+
+template <typename Dtype>
+class BasePrefetchingDataLayerTest : public ::testing::Test {
+ protected:
+  BasePrefetchingDataLayerTest()
+      : blob_top_data_(new Blob<Dtype>()) {
+    blob_top_vec_.push_back(blob_top_data_);
+    Caffe::set_mode(Caffe::CPU);
+  }
+  virtual ~BasePrefetchingDataLayerTest() { delete blob_top_data_; }
+
+  Blob<Dtype>* const blob_top_data_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(BasePrefetchingDataLayerTest, TestDtypes);
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestOrder) {
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(3);
+  SequenceDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(6, this->blob_top_data_->count());
+    for (int i = 0; i < this->blob_top_data_->count(); ++i) {
+      EXPECT_EQ(iter, this->blob_top_data_->cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestQueueDepth) {
+  const int prefetch = 3;
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(prefetch);
+  SequenceDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The thread fills every buffer ahead of the net.
+  layer.WaitQueued(prefetch);
+  EXPECT_EQ(0, layer.free());
+  // The batch being output is held until the next forward, so the thread
+  // cannot refill it yet: the first forward releases nothing.
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(0, this->blob_top_data_->cpu_data()[0]);
+  EXPECT_EQ(prefetch - 1, layer.queued());
+  EXPECT_EQ(0, layer.free());
+  // Each later forward lets the thread load one more batch, once it has
+  // released the previous one.
+  for (int iter = 1; iter < 3 * prefetch; ++iter) {
+    layer.Release();
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_EQ(iter, this->blob_top_data_->cpu_data()[0]);
+    layer.WaitQueued(prefetch - 1);
+    EXPECT_EQ(0, layer.free());
+  }
+  EXPECT_FALSE(layer.overrun());
+}
+
+#ifndef CPU_ONLY
+TYPED_TEST(BasePrefetchingDataLayerTest, TestGPUUploadReady) {
+  // Batches large enough that reading one before its upload completed
+  // would see stale or partial data.
+  const int num = 1 << 20;
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(3);
+  Caffe::set_mode(Caffe::GPU);
+  SequenceDataLayer<TypeParam> layer(param, num);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int iter = 0; iter < 8; ++iter) {
+    layer.Release();
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // The default stream waits on the batch's event before this copy back,
+    // so every value must be the one loaded.
+    const TypeParam* data = this->blob_top_data_->cpu_data();
+    for (int i = 0; i < this->blob_top_data_->count(); i += 4099) {
+      ASSERT_EQ(iter, data[i]) << "at " << i;
+    }
+    ASSERT_EQ(iter, data[this->blob_top_data_->count() - 1]);
+  }
+  Caffe::set_mode(Caffe::CPU);
+}
+#endif
+
+TYPED_TEST(BasePrefetchingDataLayerTest, TestPrefetchStats) {
+  const int prefetch = 3;
+  LayerParameter param;
+  param.mutable_data_param()->set_prefetch(prefetch);
+  SequenceDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(prefetch + 1, layer.prefetch_stats().occupancy.size());
+  EXPECT_EQ(0, layer.prefetch_stats().forwards);
+  layer.WaitQueued(prefetch);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(1, layer.prefetch_stats().forwards);
+  EXPECT_EQ(0, layer.prefetch_stats().waits);
+  EXPECT_EQ(1, layer.prefetch_stats().occupancy[prefetch]);
+  const int forwards = 20;
+  for (int iter = 1; iter < forwards; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  }
+  const PrefetchStats& stats = layer.prefetch_stats();
+  EXPECT_EQ(forwards, stats.forwards);
+  int total = 0;
+  for (int k = 0; k <= prefetch; ++k) {
+    total += stats.occupancy[k];
+  }
+  EXPECT_EQ(forwards, total);
+  EXPECT_EQ(stats.occupancy[0], stats.waits);
+  EXPECT_GE(stats.wait_time, stats.max_wait_time);
+  EXPECT_GE(stats.load_time, 0);
+  EXPECT_EQ(0, stats.read_time);
+  layer.ResetPrefetchStats();
+  EXPECT_EQ(0, layer.prefetch_stats().forwards);
+  EXPECT_EQ(0, layer.prefetch_stats().occupancy[prefetch]);
+}
+
+}  // namespace caffe
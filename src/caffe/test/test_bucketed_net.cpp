@@ -0,0 +1,164 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/bucketed_net.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class BucketedNetTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  BucketedNetTest() : seed_(1701) {
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'input' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  top: 'im_info' "
+        "  input_param { "
+        "    shape { dim: 1 dim: 2 dim: 4 dim: 4 } "
+        "    shape { dim: 1 dim: 3 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+    // Buckets of 6 x 8, 8 x 6 and 8 x 8
+    bucket_param_.add_height(6);
+    bucket_param_.add_width(8);
+    bucket_param_.add_height(8);
+    bucket_param_.add_width(6);
+    bucket_param_.add_height(8);
+    bucket_param_.add_width(8);
+    bucket_param_.set_batch_size(2);
+  }
+
+  int seed_;
+  NetParameter param_;
+  ShapeBucketParameter bucket_param_;
+};
+
+TYPED_TEST_CASE(BucketedNetTest, TestDtypesAndDevices);
+
+TYPED_TEST(BucketedNetTest, TestBucket) {
+  typedef typename TypeParam::Dtype Dtype;
+  BucketedNet<Dtype> net(this->bucket_param_, this->param_);
+  EXPECT_EQ(3, net.num_buckets());
+  EXPECT_EQ(0, net.Bucket(5, 7));
+  EXPECT_EQ(1, net.Bucket(7, 5));
+  EXPECT_EQ(2, net.Bucket(7, 7));
+  EXPECT_EQ(0, net.Bucket(6, 6));
+  EXPECT_EQ(-1, net.Bucket(9, 1));
+  // The nets are set up for full batches of their bucket.
+  const vector<int>& shape = net.net(1)->blob_by_name("data")->shape();
+  EXPECT_EQ(2, shape[0]);
+  EXPECT_EQ(2, shape[1]);
+  EXPECT_EQ(8, shape[2]);
+  EXPECT_EQ(6, shape[3]);
+  EXPECT_EQ(net.net(0)->params()[0]->cpu_data(),
+            net.net(2)->params()[0]->cpu_data());
+}
+
+TYPED_TEST(BucketedNetTest, TestGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  BucketedNet<Dtype> net(this->bucket_param_, this->param_);
+  vector<std::pair<int, int> > sizes;
+  sizes.push_back(std::make_pair(5, 7));
+  sizes.push_back(std::make_pair(7, 5));
+  sizes.push_back(std::make_pair(6, 8));
+  sizes.push_back(std::make_pair(5, 5));
+  sizes.push_back(std::make_pair(8, 8));
+  vector<vector<int> > batches;
+  vector<int> buckets;
+  net.Group(sizes, &batches, &buckets);
+  ASSERT_EQ(4, batches.size());
+  ASSERT_EQ(4, buckets.size());
+  EXPECT_EQ(0, buckets[0]);
+  ASSERT_EQ(2, batches[0].size());
+  EXPECT_EQ(0, batches[0][0]);
+  EXPECT_EQ(2, batches[0][1]);
+  EXPECT_EQ(1, buckets[1]);
+  ASSERT_EQ(1, batches[1].size());
+  EXPECT_EQ(1, batches[1][0]);
+  EXPECT_EQ(0, buckets[2]);
+  ASSERT_EQ(1, batches[2].size());
+  EXPECT_EQ(3, batches[2][0]);
+  EXPECT_EQ(2, buckets[3]);
+  ASSERT_EQ(1, batches[3].size());
+  EXPECT_EQ(4, batches[3][0]);
+}
+
+TYPED_TEST(BucketedNetTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  BucketedNet<Dtype> net(this->bucket_param_, this->param_);
+  Blob<Dtype> image0(1, 2, 5, 7);
+  Blob<Dtype> image1(1, 2, 6, 8);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&image0);
+  filler.Fill(&image1);
+  vector<Blob<Dtype>*> images;
+  images.push_back(&image0);
+  images.push_back(&image1);
+  vector<Dtype> scales;
+  scales.push_back(1.5);
+  scales.push_back(2);
+  for (int num = 2; num > 0; --num) {
+    images.resize(num);
+    scales.resize(num);
+    net.Forward(0, images, scales);
+    const Blob<Dtype>& conv = *net.net(0)->blob_by_name("conv");
+    const Blob<Dtype>& im_info = *net.net(0)->blob_by_name("im_info");
+    ASSERT_EQ(num, conv.num());
+    // The padding does not change the output within each image.
+    Net<Dtype> unpadded(this->param_);
+    unpadded.ShareTrainedLayersWith(net.net(0).get());
+    for (int i = 0; i < num; ++i) {
+      unpadded.blob_by_name("data")->ReshapeLike(*images[i]);
+      unpadded.Reshape();
+      caffe_copy(images[i]->count(), images[i]->cpu_data(),
+                 unpadded.blob_by_name("data")->mutable_cpu_data());
+      unpadded.Forward();
+      const Blob<Dtype>& expected = *unpadded.blob_by_name("conv");
+      for (int c = 0; c < expected.channels(); ++c) {
+        for (int y = 0; y < expected.height(); ++y) {
+          for (int x = 0; x < expected.width(); ++x) {
+            EXPECT_NEAR(expected.data_at(0, c, y, x),
+                        conv.data_at(i, c, y, x), 1e-5);
+          }
+        }
+      }
+      EXPECT_EQ(images[i]->height(), im_info.cpu_data()[i * 3]);
+      EXPECT_EQ(images[i]->width(), im_info.cpu_data()[i * 3 + 1]);
+      EXPECT_EQ(scales[i], im_info.cpu_data()[i * 3 + 2]);
+    }
+  }
+}
+
+}  // namespace caffe
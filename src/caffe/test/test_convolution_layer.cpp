@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/util/half.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -495,6 +497,100 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestHalfWeightsConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Half precision weights only apply to the CPU forward pass.
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.set_weight_precision(LayerParameter_Precision_BF16);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int pass = 0; pass < 2; ++pass) {
+    layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Check against reference convolution with weights rounded to bf16.
+    vector<shared_ptr<Blob<Dtype> > > rounded(2);
+    for (int i = 0; i < 2; ++i) {
+      rounded[i].reset(new Blob<Dtype>());
+      rounded[i]->CopyFrom(*layer->blobs()[i], false, true);
+    }
+    Dtype* weights = rounded[0]->mutable_cpu_data();
+    for (int i = 0; i < rounded[0]->count(); ++i) {
+      weights[i] = bf16_to_float(float_to_bf16(weights[i]));
+    }
+    caffe_conv(this->blob_bottom_, convolution_param, rounded,
+        this->MakeReferenceTop(this->blob_top_));
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+    // Weights written to are packed again.
+    caffe_scal(layer->blobs()[0]->count(), Dtype(-2),
+               layer->blobs()[0]->mutable_cpu_data());
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestInt8ConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Int8 weights only apply to the CPU forward pass.
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  const int bottom_count = this->blob_bottom_->count();
+  const Dtype max_input = std::max(
+      *std::max_element(bottom_data, bottom_data + bottom_count),
+      -*std::min_element(bottom_data, bottom_data + bottom_count));
+  layer_param.set_weight_precision(LayerParameter_Precision_INT8);
+  layer_param.mutable_quantization_param()->set_input_range(max_input);
+  ConvolutionLayer<Dtype> int8_layer(layer_param);
+  vector<Blob<Dtype>*> int8_top_vec(1, this->blob_top_2_);
+  int8_layer.SetUp(this->blob_bottom_vec_, int8_top_vec);
+  for (int i = 0; i < 2; ++i) {
+    int8_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  int8_layer.Forward(this->blob_bottom_vec_, int8_top_vec);
+  // Each of the 9 products is off by at most
+  // (max |x| * max |w| + max |w| * max |x|) / 254.
+  const Dtype* weights = layer.blobs()[0]->cpu_data();
+  const int count = layer.blobs()[0]->count();
+  const Dtype max_weight = std::max(
+      *std::max_element(weights, weights + count),
+      -*std::min_element(weights, weights + count));
+  const Dtype tolerance = 9 * max_input * max_weight * 1.01 / 127;
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+                this->blob_top_2_->cpu_data()[i], tolerance);
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
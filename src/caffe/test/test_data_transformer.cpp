@@ -340,5 +340,49 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestUint8MatchesFloatData) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = true;
+  const int label = 0;
+  const int channels = 3;
+  const int height = 24;
+  const int width = 37;
+  const int crop_size = 20;  // rows of 20 cover both vector and scalar code
+
+  transform_param.set_crop_size(crop_size);
+  transform_param.set_mirror(true);
+  transform_param.set_scale(0.5);
+  transform_param.add_mean_value(10);
+  transform_param.add_mean_value(20);
+  transform_param.add_mean_value(30);
+  Datum datum;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  // The same pixels stored as float_data take the generic path.
+  Datum float_datum;
+  float_datum.set_label(label);
+  float_datum.set_channels(channels);
+  float_datum.set_height(height);
+  float_datum.set_width(width);
+  for (int j = 0; j < datum.data().size(); ++j) {
+    float_datum.add_float_data(static_cast<uint8_t>(datum.data()[j]));
+  }
+
+  Blob<TypeParam> blob(1, channels, crop_size, crop_size);
+  Blob<TypeParam> float_blob(1, channels, crop_size, crop_size);
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  DataTransformer<TypeParam> float_transformer(transform_param, TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  transformer.InitRand();
+  Caffe::set_random_seed(this->seed_);
+  float_transformer.InitRand();
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    transformer.Transform(datum, &blob);
+    float_transformer.Transform(float_datum, &float_blob);
+    for (int j = 0; j < blob.count(); ++j) {
+      EXPECT_EQ(float_blob.cpu_data()[j], blob.cpu_data()[j]);
+    }
+  }
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -96,6 +96,23 @@ TYPED_TEST(FlattenLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(FlattenLayerTest, TestForwardReallocated) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  FlattenLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Growing the bottom reallocates its data, so shrinking it back to the
+  // same shape still has the top share the new data.
+  this->blob_bottom_->Reshape(4, 3, 6, 5);
+  this->blob_bottom_->Reshape(2, 3, 6, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_bottom_->cpu_data(), this->blob_top_->cpu_data());
+}
+
 TYPED_TEST(FlattenLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
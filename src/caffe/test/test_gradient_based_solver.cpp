@@ -1,3 +1,4 @@
+#include <boost/thread.hpp>
 #include <algorithm>
 #include <string>
 #include <utility>
@@ -11,7 +12,9 @@
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/sgd_solvers.hpp"
+#include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/transport.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -19,6 +22,46 @@ using std::ostringstream;
 
 namespace caffe {
 
+// Runs rank of a RingSync over the unix socket addresses with a copy of the
+// solver of rank 0, as a separate process would.
+template <typename Dtype>
+void RunRingRank(const SolverParameter& param, const vector<string>& addresses,
+    int rank, const char* restore) {
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_solver_count(addresses.size());
+  Caffe::set_solver_rank(rank);
+  shared_ptr<Solver<Dtype> > solver(SolverRegistry<Dtype>::CreateSolver(param));
+  if (restore) {
+    solver->Restore(restore);
+  }
+  shared_ptr<Transport> transport(new SocketTransport(addresses, rank));
+  RingSync<Dtype> sync(solver, transport);
+  sync.Run();
+}
+
+// Exposes the update steps of a solver, to compare its fused CPU update with
+// the separate passes it replaces.
+template <typename Dtype, template <typename> class SolverType>
+class UpdateStepsSolver : public SolverType<Dtype> {
+ public:
+  explicit UpdateStepsSolver(const SolverParameter& param)
+      : SolverType<Dtype>(param) {}
+
+  void FusedUpdate(Dtype rate) {
+    for (int i = 0; i < this->net_->learnable_params().size(); ++i) {
+      this->ComputeFusedUpdate(i, rate);
+    }
+  }
+  void SeparateUpdate(Dtype rate) {
+    for (int i = 0; i < this->net_->learnable_params().size(); ++i) {
+      this->Normalize(i);
+      this->Regularize(i);
+      this->ComputeUpdateValue(i, rate);
+    }
+    this->net_->Update();
+  }
+};
+
 template <typename TypeParam>
 class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -26,7 +69,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
  protected:
   GradientBasedSolverTest() :
       seed_(1701), num_(4), channels_(3), height_(10), width_(10),
-      share_(false) {
+      share_(false), snapshot_async_(false), ring_(false), flat_(false),
+      regularization_type_("L2") {
         input_file_ = new string(
         ABS_TEST_DATA_DIR "/solver_data_list.txt");
       }
@@ -36,6 +80,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
 
   string snapshot_prefix_;
   shared_ptr<SGDSolver<Dtype> > solver_;
+  shared_ptr<CPUSync<Dtype> > cpu_sync_;
+  shared_ptr<RingSync<Dtype> > ring_sync_;
 #ifdef USE_NCCL
   shared_ptr<NCCL<Dtype> > nccl_;
 #endif
@@ -44,6 +90,12 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
   // TODO this is brittle and the hdf5 file should be checked instead.
   int num_, channels_, height_, width_;
   bool share_;
+  bool snapshot_async_;
+  // Whether CPU solvers reduce over a RingSync rather than a CPUSync
+  bool ring_;
+  // Whether the net keeps its params in one flat buffer
+  bool flat_;
+  string regularization_type_;
   Dtype delta_;  // Stability constant for RMSProp, AdaGrad, AdaDelta and Adam
 
   // Test data: check out generate_sample_data.py in the same directory.
@@ -88,8 +140,11 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
        "iter_size: " << iter_size << " "
        "device_id: " << device_id << " "
        "layer_wise_reduce: " << (!share_) << " "
+       "snapshot_async: " << snapshot_async_ << " "
+       "regularization_type: '" << regularization_type_ << "' "
        "net_param { "
        "  name: 'TestNetwork' "
+       "  flat_params: " << flat_ << " "
        "  layer { "
        "    name: 'data' "
        "    type: 'HDF5Data' "
@@ -194,6 +249,15 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     }
     if (devices == 1) {
       this->solver_->Solve();
+    } else if (Caffe::mode() == Caffe::CPU && ring_) {
+      LOG(INFO) << "Ring test on " << devices << " threads";
+      RunRing(devices, from_snapshot);
+    } else if (Caffe::mode() == Caffe::CPU) {
+      LOG(INFO) << "Multi-thread test on " << devices << " solvers";
+      Caffe::set_solver_count(devices);
+      this->cpu_sync_.reset(new CPUSync<Dtype>(this->solver_));
+      this->cpu_sync_->Run(from_snapshot);
+      Caffe::set_solver_count(1);
     } else {
       LOG(INFO) << "Multi-GPU test on " << devices << " devices";
       vector<int> gpus;
@@ -221,6 +285,32 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     return string();
   }
 
+  // Runs solver_ as rank 0 of a ring over unix sockets, and its other ranks
+  // on threads.
+  void RunRing(int devices, const char* from_snapshot) {
+    string dir;
+    MakeTempDir(&dir);
+    vector<string> addresses;
+    for (int rank = 0; rank < devices; ++rank) {
+      addresses.push_back("unix://" + dir + "/" + format_int(rank));
+    }
+    SolverParameter param(solver_->param());
+    param.set_type(solver_->type());
+    boost::thread_group threads;
+    for (int rank = 1; rank < devices; ++rank) {
+      threads.create_thread(boost::bind(&RunRingRank<Dtype>,
+          boost::cref(param), boost::cref(addresses), rank, from_snapshot));
+    }
+    Caffe::set_solver_count(devices);
+    Caffe::set_solver_rank(0);
+    // Kept, like cpu_sync_, as the solver holds callbacks into it.
+    ring_sync_.reset(new RingSync<Dtype>(solver_,
+        shared_ptr<Transport>(new SocketTransport(addresses, 0))));
+    ring_sync_->Run();
+    threads.join_all();
+    Caffe::set_solver_count(1);
+  }
+
   // Compute an update value given the current state of the train net,
   // using the analytical formula for the least squares gradient.
   // updated_params will store the updated weight and bias results,
@@ -461,6 +551,10 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     const int kIterSize = 1;
     // Test over all numbers of devices.
     int available_devices = 1;
+    if (Caffe::mode() == Caffe::CPU) {
+      // CPU solvers run in threads, so test an uneven split too.
+      available_devices = 3;
+    }
 #ifdef USE_NCCL
     if (Caffe::mode() == Caffe::GPU) {
       CUDA_CHECK(cudaGetDeviceCount(&available_devices));
@@ -507,6 +601,89 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // Runs num_iters iterations of two solvers of SolverType from the same
+  // initial weights on the same data, one with the fused CPU update and the
+  // other with Normalize, Regularize, ComputeUpdateValue and Net::Update,
+  // and checks that their weights and history agree.
+  template <template <typename> class SolverType>
+  void CheckFusedUpdate(const Dtype learning_rate, const Dtype weight_decay,
+      const Dtype momentum, const int num_iters) {
+    // Makes solver_, whose parameters include those set by InitSolver.
+    RunLeastSquaresSolver(learning_rate, weight_decay, momentum, 0);
+    SolverParameter param(solver_->param());
+    UpdateStepsSolver<Dtype, SolverType> fused(param);
+    UpdateStepsSolver<Dtype, SolverType> separate(param);
+    const vector<Blob<Dtype>*>& fused_params =
+        fused.net()->learnable_params();
+    const vector<Blob<Dtype>*>& separate_params =
+        separate.net()->learnable_params();
+    ASSERT_EQ(fused_params.size(), separate_params.size());
+    for (int i = 0; i < fused_params.size(); ++i) {
+      separate_params[i]->CopyFrom(*fused_params[i]);
+    }
+    for (int iter = 0; iter < num_iters; ++iter) {
+      fused.net()->ForwardBackward();
+      fused.FusedUpdate(learning_rate);
+      separate.net()->ForwardBackward();
+      separate.SeparateUpdate(learning_rate);
+    }
+    const double kPrecision = 1e-4;
+    const double kMinPrecision = 1e-6;
+    for (int i = 0; i < fused_params.size(); ++i) {
+      for (int j = 0; j < fused_params[i]->count(); ++j) {
+        const Dtype expected = separate_params[i]->cpu_data()[j];
+        const Dtype actual = fused_params[i]->cpu_data()[j];
+        EXPECT_NEAR(expected, actual,
+            std::max(kMinPrecision, kPrecision * fabs(expected)))
+            << "param " << i << " differed at " << j;
+      }
+    }
+    ASSERT_EQ(separate.history().size(), fused.history().size());
+    for (int i = 0; i < fused.history().size(); ++i) {
+      for (int j = 0; j < fused.history()[i]->count(); ++j) {
+        const Dtype expected = separate.history()[i]->cpu_data()[j];
+        const Dtype actual = fused.history()[i]->cpu_data()[j];
+        EXPECT_NEAR(expected, actual,
+            std::max(kMinPrecision, kPrecision * fabs(expected)))
+            << "history " << i << " differed at " << j;
+      }
+    }
+  }
+
+  // Checks that training with the params in one flat buffer gives the same
+  // weights as without, with the fused update for L2 regularization and with
+  // Net::Update for L1.
+  void CheckFlatParams(const Dtype learning_rate, const Dtype weight_decay,
+      const Dtype momentum, const int num_iters) {
+    const char* types[] = {"L2", "L1"};
+    for (int t = 0; t < 2; ++t) {
+      regularization_type_ = types[t];
+      flat_ = false;
+      RunLeastSquaresSolver(learning_rate, weight_decay, momentum, num_iters);
+      EXPECT_TRUE(NULL == solver_->net()->flat_params().get());
+      vector<shared_ptr<Blob<Dtype> > > expected;
+      const vector<Blob<Dtype>*>& params = solver_->net()->learnable_params();
+      for (int i = 0; i < params.size(); ++i) {
+        expected.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+        expected.back()->CopyFrom(*params[i], false, true);
+      }
+      flat_ = true;
+      RunLeastSquaresSolver(learning_rate, weight_decay, momentum, num_iters);
+      EXPECT_EQ(Caffe::mode() == Caffe::CPU,
+                NULL != solver_->net()->flat_params().get());
+      const vector<Blob<Dtype>*>& flat = solver_->net()->learnable_params();
+      ASSERT_EQ(expected.size(), flat.size());
+      for (int i = 0; i < flat.size(); ++i) {
+        for (int j = 0; j < flat[i]->count(); ++j) {
+          EXPECT_FLOAT_EQ(expected[i]->cpu_data()[j], flat[i]->cpu_data()[j])
+              << types[t] << " param " << i << " differed at " << j;
+        }
+      }
+    }
+    regularization_type_ = "L2";
+    flat_ = false;
+  }
+
   void TestSnapshot(const Dtype learning_rate = 1.0,
       const Dtype weight_decay = 0.0, const Dtype momentum = 0.0,
       const int num_iters = 1) {
@@ -595,6 +772,16 @@ class SGDSolverTest : public GradientBasedSolverTest<TypeParam> {
 
 TYPED_TEST_CASE(SGDSolverTest, TestDtypesAndDevices);
 
+TYPED_TEST(SGDSolverTest, TestFusedUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->template CheckFusedUpdate<SGDSolver>(kLearningRate, kWeightDecay, kMomentum,
+                                      kNumIters);
+}
+
 TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdate) {
   this->TestLeastSquaresUpdate();
 }
@@ -672,6 +859,41 @@ TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingShare) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestFlatParams) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->CheckFlatParams(kLearningRate, kWeightDecay, kMomentum, kNumIters);
+}
+
+TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingRing) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.5;
+  const int kNumIters = 4;
+  this->ring_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
+TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingShareRing) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.5;
+  const int kNumIters = 4;
+  // Shared weights reduce all gradients at once rather than per layer.
+  this->share_ = true;
+  this->ring_ = true;
+  for (int i = 0; i <= kNumIters; ++i) {
+    this->TestLeastSquaresUpdate(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 TYPED_TEST(SGDSolverTest, TestLeastSquaresUpdateWithEverythingAccum) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -718,6 +940,18 @@ TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestSnapshotAsync) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->snapshot_async_ = true;
+  for (int i = 1; i <= kNumIters; ++i) {
+    this->TestSnapshot(kLearningRate, kWeightDecay, kMomentum, i);
+  }
+}
+
 
 template <typename TypeParam>
 class AdaGradSolverTest : public GradientBasedSolverTest<TypeParam> {
@@ -731,6 +965,16 @@ class AdaGradSolverTest : public GradientBasedSolverTest<TypeParam> {
 
 TYPED_TEST_CASE(AdaGradSolverTest, TestDtypesAndDevices);
 
+TYPED_TEST(AdaGradSolverTest, TestFusedUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  const int kNumIters = 4;
+  this->template CheckFusedUpdate<AdaGradSolver>(kLearningRate, kWeightDecay, kMomentum,
+                                      kNumIters);
+}
+
 TYPED_TEST(AdaGradSolverTest, TestAdaGradLeastSquaresUpdate) {
   this->TestLeastSquaresUpdate();
 }
@@ -831,6 +1075,16 @@ class NesterovSolverTest : public GradientBasedSolverTest<TypeParam> {
 
 TYPED_TEST_CASE(NesterovSolverTest, TestDtypesAndDevices);
 
+TYPED_TEST(NesterovSolverTest, TestFusedUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->template CheckFusedUpdate<NesterovSolver>(kLearningRate, kWeightDecay, kMomentum,
+                                      kNumIters);
+}
+
 TYPED_TEST(NesterovSolverTest, TestNesterovLeastSquaresUpdate) {
   this->TestLeastSquaresUpdate();
 }
@@ -964,6 +1218,16 @@ class AdaDeltaSolverTest : public GradientBasedSolverTest<TypeParam> {
 
 TYPED_TEST_CASE(AdaDeltaSolverTest, TestDtypesAndDevices);
 
+TYPED_TEST(AdaDeltaSolverTest, TestFusedUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.1;
+  const Dtype kWeightDecay = 0.1;
+  const Dtype kMomentum = 0.95;
+  const int kNumIters = 4;
+  this->template CheckFusedUpdate<AdaDeltaSolver>(kLearningRate, kWeightDecay, kMomentum,
+                                      kNumIters);
+}
+
 TYPED_TEST(AdaDeltaSolverTest, TestAdaDeltaLeastSquaresUpdate) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.1;
@@ -1098,6 +1362,16 @@ class AdamSolverTest : public GradientBasedSolverTest<TypeParam> {
 
 TYPED_TEST_CASE(AdamSolverTest, TestDtypesAndDevices);
 
+TYPED_TEST(AdamSolverTest, TestFusedUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0.9;
+  const int kNumIters = 4;
+  this->template CheckFusedUpdate<AdamSolver>(kLearningRate, kWeightDecay, kMomentum,
+                                      kNumIters);
+}
+
 TYPED_TEST(AdamSolverTest, TestAdamLeastSquaresUpdate) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 0.01;
@@ -1198,6 +1472,16 @@ class RMSPropSolverTest : public GradientBasedSolverTest<TypeParam> {
 
 TYPED_TEST_CASE(RMSPropSolverTest, TestDtypesAndDevices);
 
+TYPED_TEST(RMSPropSolverTest, TestFusedUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  const Dtype kLearningRate = 0.01;
+  const Dtype kWeightDecay = 0.5;
+  const Dtype kMomentum = 0;
+  const int kNumIters = 4;
+  this->template CheckFusedUpdate<RMSPropSolver>(kLearningRate, kWeightDecay, kMomentum,
+                                      kNumIters);
+}
+
 TYPED_TEST(RMSPropSolverTest, TestRMSPropLeastSquaresUpdateWithWeightDecay) {
   typedef typename TypeParam::Dtype Dtype;
   const Dtype kLearningRate = 1.0;
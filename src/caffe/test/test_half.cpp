@@ -0,0 +1,141 @@
+#include <stdint.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(HalfTest, TestFP16) {
+  EXPECT_EQ(0x3c00, float_to_fp16(1.f));
+  EXPECT_EQ(0xc000, float_to_fp16(-2.f));
+  EXPECT_EQ(0x7bff, float_to_fp16(65504.f));
+  EXPECT_EQ(0x7c00, float_to_fp16(65520.f));
+  EXPECT_EQ(0x0001, float_to_fp16(std::pow(2.f, -24)));
+  EXPECT_EQ(0x0000, float_to_fp16(std::pow(2.f, -25)));
+  EXPECT_EQ(0x0400, float_to_fp16(std::pow(2.f, -14)));
+  // Ties round to even.
+  EXPECT_EQ(0x3c00, float_to_fp16(1.f + std::pow(2.f, -11)));
+  EXPECT_EQ(0x3c02, float_to_fp16(1.f + 3 * std::pow(2.f, -11)));
+  EXPECT_EQ(0x7e00, float_to_fp16(std::numeric_limits<float>::quiet_NaN())
+                    & 0x7e00);
+  // Every value that is not a NaN converts back to itself.
+  for (int i = 0; i < 0x10000; ++i) {
+    const uint16_t value = i;
+    if ((value & 0x7c00) == 0x7c00 && (value & 0x3ff)) {
+      continue;
+    }
+    ASSERT_EQ(value, float_to_fp16(fp16_to_float(value))) << value;
+  }
+  EXPECT_EQ(std::pow(2.f, -24), fp16_to_float(0x0001));
+  EXPECT_EQ(65504.f, fp16_to_float(0x7bff));
+}
+
+TEST(HalfTest, TestBF16) {
+  EXPECT_EQ(0x3f80, float_to_bf16(1.f));
+  EXPECT_EQ(0xc000, float_to_bf16(-2.f));
+  EXPECT_EQ(0x3f80, float_to_bf16(1.f + std::pow(2.f, -8)));
+  EXPECT_EQ(0x3f82, float_to_bf16(1.f + 3 * std::pow(2.f, -8)));
+  EXPECT_TRUE(std::isnan(bf16_to_float(
+      float_to_bf16(std::numeric_limits<float>::quiet_NaN()))));
+  for (int i = 0; i < 0x10000; ++i) {
+    const uint16_t value = i;
+    if ((value & 0x7f80) == 0x7f80 && (value & 0x7f)) {
+      continue;
+    }
+    ASSERT_EQ(value, float_to_bf16(bf16_to_float(value))) << value;
+  }
+}
+
+template <typename Dtype>
+class HalfMatrixTest : public ::testing::Test {
+ protected:
+  HalfMatrixTest() {
+    Caffe::set_random_seed(1701);
+  }
+
+  void Fill(Blob<Dtype>* blob, const int rows, const int cols) {
+    vector<int> shape(2);
+    shape[0] = rows;
+    shape[1] = cols;
+    blob->Reshape(shape);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob);
+  }
+
+  // Checks the products of W against those of its unpacked copy.
+  void TestGemm(const bool bf16) {
+    // Several tiles of rows
+    const int rows = 150;
+    const int cols = 1000;
+    const int M = 7;
+    Blob<Dtype> weights, unpacked, a, b, c, expected;
+    Fill(&weights, rows, cols);
+    HalfMatrix<Dtype> matrix;
+    matrix.Pack(weights.cpu_data(), rows, cols, bf16);
+    unpacked.ReshapeLike(weights);
+    matrix.Unpack(0, rows, unpacked.mutable_cpu_data());
+    const Dtype tolerance = bf16 ? 1e-2 : 1e-3;
+    for (int i = 0; i < weights.count(); ++i) {
+      EXPECT_NEAR(weights.cpu_data()[i], unpacked.cpu_data()[i],
+                  tolerance * std::fabs(weights.cpu_data()[i]) + 1e-7);
+    }
+    // C = A * W^T
+    Fill(&a, M, cols);
+    c.Reshape(M, rows, 1, 1);
+    expected.Reshape(M, rows, 1, 1);
+    matrix.Gemm(CblasTrans, M, a.cpu_data(), c.mutable_cpu_data());
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M, rows, cols, Dtype(1),
+        a.cpu_data(), unpacked.cpu_data(), Dtype(0),
+        expected.mutable_cpu_data());
+    for (int i = 0; i < c.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], c.cpu_data()[i], 1e-3);
+    }
+    // C = A * W
+    Fill(&a, M, rows);
+    c.Reshape(M, cols, 1, 1);
+    expected.Reshape(M, cols, 1, 1);
+    matrix.Gemm(CblasNoTrans, M, a.cpu_data(), c.mutable_cpu_data());
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M, cols, rows,
+        Dtype(1), a.cpu_data(), unpacked.cpu_data(), Dtype(0),
+        expected.mutable_cpu_data());
+    for (int i = 0; i < c.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], c.cpu_data()[i], 1e-3);
+    }
+    // C = W[row, row + count) * B
+    const int row = 20;
+    const int count = 100;
+    Fill(&b, cols, M);
+    c.Reshape(count, M, 1, 1);
+    expected.Reshape(count, M, 1, 1);
+    matrix.GemmRows(row, count, M, b.cpu_data(), c.mutable_cpu_data());
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, count, M, cols,
+        Dtype(1), unpacked.cpu_data() + row * cols, b.cpu_data(), Dtype(0),
+        expected.mutable_cpu_data());
+    for (int i = 0; i < c.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], c.cpu_data()[i], 1e-3);
+    }
+  }
+};
+
+TYPED_TEST_CASE(HalfMatrixTest, TestDtypes);
+
+TYPED_TEST(HalfMatrixTest, TestGemmFP16) {
+  this->TestGemm(false);
+}
+
+TYPED_TEST(HalfMatrixTest, TestGemmBF16) {
+  this->TestGemm(true);
+}
+
+}  // namespace caffe
@@ -132,6 +132,105 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+TYPED_TEST(HDF5DataLayerTest, TestReadChunked) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Streaming in chunks that do not divide the 10 rows of each file must give
+  // the same output as loading whole files.
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  param.add_top("label2");
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_size(3);
+  int num_cols = 8;
+  int height = 6;
+  int width = 5;
+
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_data_->num(), batch_size);
+  EXPECT_EQ(this->blob_top_data_->channels(), num_cols);
+  EXPECT_EQ(this->blob_top_data_->height(), height);
+  EXPECT_EQ(this->blob_top_data_->width(), width);
+  EXPECT_EQ(this->blob_top_label_->num_axes(), 2);
+  EXPECT_EQ(this->blob_top_label_->shape(0), batch_size);
+  EXPECT_EQ(this->blob_top_label_->shape(1), 1);
+
+  // Setting up again restarts streaming from the first file.
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  const int data_size = num_cols * height * width;
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+
+    int label_offset = 1 + ((iter % 2 == 0) ? 0 : batch_size);
+    int label2_offset = 1 + label_offset;
+    int data_offset = (iter % 2 == 0) ? 0 : batch_size * data_size;
+    int file_offset = (iter % 4 < 2) ? 0 : 2400;
+
+    for (int i = 0; i < batch_size; ++i) {
+      EXPECT_EQ(label_offset + i, this->blob_top_label_->cpu_data()[i]);
+      EXPECT_EQ(label2_offset + i, this->blob_top_label2_->cpu_data()[i]);
+    }
+    for (int idx = 0; idx < batch_size * data_size; ++idx) {
+      EXPECT_EQ(file_offset + data_offset + idx,
+                this->blob_top_data_->cpu_data()[idx])
+          << "debug: idx " << idx << " iter " << iter;
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestReadChunkedShuffle) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_size(3);
+  hdf5_data_param->set_shuffle(true);
+  const int data_size = 8 * 6 * 5;
+  const int num_rows = 10;
+
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Files are never interleaved, so every two batches output all the rows
+  // of one file exactly once, each with its own data.
+  for (int pass = 0; pass < 4; ++pass) {
+    vector<int> seen(num_rows, 0);
+    int file_offset = -1;
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < batch_size; ++i) {
+        const int label = this->blob_top_label_->cpu_data()[i];
+        ASSERT_GE(label, 1);
+        ASSERT_LE(label, num_rows);
+        ++seen[label - 1];
+        const Dtype* data = this->blob_top_data_->cpu_data() + i * data_size;
+        const int offset = data[0] - (label - 1) * data_size;
+        EXPECT_TRUE(offset == 0 || offset == 2400);
+        if (file_offset < 0) {
+          file_offset = offset;
+        }
+        EXPECT_EQ(file_offset, offset);
+        for (int j = 0; j < data_size; ++j) {
+          EXPECT_EQ(data[0] + j, data[j]);
+        }
+      }
+    }
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_EQ(1, seen[i]) << "row " << i << " pass " << pass;
+    }
+  }
+}
+
 TYPED_TEST(HDF5DataLayerTest, TestSkip) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter param;
@@ -0,0 +1,138 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/inference_server.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class InferenceServerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  InferenceServerTest() : seed_(1701) {
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 4 } } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'data' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'prob' "
+        "  type: 'Softmax' "
+        "  bottom: 'ip' "
+        "  top: 'prob' "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  }
+
+  // Serves a number of requests at once, and compares each output with the
+  // output of the net run on that input alone.
+  void TestServe(int replicas, int max_batch_size, int batch_timeout_us) {
+    Caffe::set_random_seed(seed_);
+    InferenceServerParameter server_param;
+    server_param.set_replicas(replicas);
+    server_param.set_max_batch_size(max_batch_size);
+    server_param.set_batch_timeout_us(batch_timeout_us);
+    InferenceServer<Dtype> server(server_param, param_);
+    ASSERT_EQ(replicas, server.nets().size());
+    ASSERT_EQ(2, server.input_shape().size());
+    EXPECT_EQ(12, server.input_count());
+    for (int i = 0; i < replicas; ++i) {
+      EXPECT_EQ(max_batch_size,
+                server.nets()[i]->input_blobs()[0]->shape(0));
+    }
+
+    const int num = 11;
+    Blob<Dtype> inputs(num, 3, 4, 1);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&inputs);
+    vector<boost::unique_future<typename InferenceServer<Dtype>::Output> >
+        outputs;
+    for (int i = 0; i < num; ++i) {
+      outputs.push_back(server.Submit(inputs.cpu_data() + i * 12));
+    }
+
+    Net<Dtype> net(param_);
+    net.ShareTrainedLayersWith(server.nets()[0].get());
+    vector<int> shape(server.input_shape());
+    shape.insert(shape.begin(), 1);
+    net.input_blobs()[0]->Reshape(shape);
+    net.Reshape();
+    for (int i = 0; i < num; ++i) {
+      const typename InferenceServer<Dtype>::Output output = outputs[i].get();
+      ASSERT_EQ(1, output.size());
+      caffe_copy(12, inputs.cpu_data() + i * 12,
+                 net.input_blobs()[0]->mutable_cpu_data());
+      net.Forward();
+      const Blob<Dtype>& expected = *net.output_blobs()[0];
+      ASSERT_EQ(expected.shape(), output[0]->shape());
+      for (int j = 0; j < expected.count(); ++j) {
+        EXPECT_NEAR(expected.cpu_data()[j], output[0]->cpu_data()[j], 1e-5);
+      }
+    }
+    // Batches of any size run without reshaping the nets.
+    for (int i = 0; i < replicas; ++i) {
+      EXPECT_EQ(max_batch_size,
+                server.nets()[i]->input_blobs()[0]->shape(0));
+    }
+  }
+
+  int seed_;
+  NetParameter param_;
+};
+
+TYPED_TEST_CASE(InferenceServerTest, TestDtypesAndDevices);
+
+TYPED_TEST(InferenceServerTest, TestServe) {
+  this->TestServe(1, 1, 0);
+}
+
+TYPED_TEST(InferenceServerTest, TestServeBatches) {
+  this->TestServe(1, 4, 1000);
+}
+
+TYPED_TEST(InferenceServerTest, TestServeReplicas) {
+  this->TestServe(3, 4, 1000);
+}
+
+TYPED_TEST(InferenceServerTest, TestPendingRequests) {
+  typedef typename TypeParam::Dtype Dtype;
+  InferenceServerParameter server_param;
+  server_param.set_max_batch_size(2);
+  boost::unique_future<typename InferenceServer<Dtype>::Output> output;
+  {
+    InferenceServer<Dtype> server(server_param, this->param_);
+    vector<Dtype> input(server.input_count());
+    output = server.Submit(&input[0]);
+  }
+  // The request is either answered, or abandoned when the server stops.
+  output.wait();
+  EXPECT_TRUE(output.is_ready());
+}
+
+}  // namespace caffe
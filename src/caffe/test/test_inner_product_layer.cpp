@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
+#include "caffe/util/half.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -253,6 +255,100 @@ TYPED_TEST(InnerProductLayerTest, TestForwardNoBatch) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardHalfWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Half precision weights only apply to the CPU forward pass.
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  const LayerParameter::Precision precisions[] = {
+      LayerParameter_Precision_FP16, LayerParameter_Precision_BF16};
+  for (int p = 0; p < 2; ++p) {
+    for (int transpose = false; transpose <= true; ++transpose) {
+      LayerParameter layer_param;
+      layer_param.set_phase(TEST);
+      InnerProductParameter* inner_product_param =
+          layer_param.mutable_inner_product_param();
+      inner_product_param->set_num_output(10);
+      inner_product_param->set_transpose(transpose);
+      inner_product_param->mutable_weight_filler()->set_type("gaussian");
+      inner_product_param->mutable_bias_filler()->set_type("uniform");
+      InnerProductLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer_param.set_weight_precision(precisions[p]);
+      InnerProductLayer<Dtype> half_layer(layer_param);
+      vector<Blob<Dtype>*> half_top_vec(1, this->blob_top_2_);
+      half_layer.SetUp(this->blob_bottom_vec_, half_top_vec);
+      for (int pass = 0; pass < 2; ++pass) {
+        // The float layer computes with the weights rounded.
+        for (int i = 0; i < 2; ++i) {
+          layer.blobs()[i]->CopyFrom(*half_layer.blobs()[i]);
+        }
+        Dtype* weights = layer.blobs()[0]->mutable_cpu_data();
+        for (int i = 0; i < layer.blobs()[0]->count(); ++i) {
+          weights[i] = p == 0 ? fp16_to_float(float_to_fp16(weights[i])) :
+                                bf16_to_float(float_to_bf16(weights[i]));
+        }
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        half_layer.Forward(this->blob_bottom_vec_, half_top_vec);
+        for (int i = 0; i < this->blob_top_->count(); ++i) {
+          EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+                      this->blob_top_2_->cpu_data()[i], 1e-4);
+        }
+        // Weights written to are packed again.
+        caffe_scal(half_layer.blobs()[0]->count(), Dtype(-2),
+                   half_layer.blobs()[0]->mutable_cpu_data());
+      }
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardInt8) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Int8 weights only apply to the CPU forward pass.
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int transpose = false; transpose <= true; ++transpose) {
+    // The bottom values are in [0, 1], as calibrated or not.
+    for (int range = 0; range <= 1; ++range) {
+      LayerParameter layer_param;
+      layer_param.set_phase(TEST);
+      InnerProductParameter* inner_product_param =
+          layer_param.mutable_inner_product_param();
+      inner_product_param->set_num_output(10);
+      inner_product_param->set_transpose(transpose);
+      inner_product_param->mutable_weight_filler()->set_type("gaussian");
+      inner_product_param->mutable_bias_filler()->set_type("uniform");
+      InnerProductLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer_param.set_weight_precision(LayerParameter_Precision_INT8);
+      layer_param.mutable_quantization_param()->set_input_range(range);
+      InnerProductLayer<Dtype> int8_layer(layer_param);
+      vector<Blob<Dtype>*> int8_top_vec(1, this->blob_top_2_);
+      int8_layer.SetUp(this->blob_bottom_vec_, int8_top_vec);
+      for (int i = 0; i < 2; ++i) {
+        int8_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+      }
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      int8_layer.Forward(this->blob_bottom_vec_, int8_top_vec);
+      // Each product is off by at most max |w| / 127 for inputs up to 1.
+      const Dtype* weights = layer.blobs()[0]->cpu_data();
+      const int count = layer.blobs()[0]->count();
+      const Dtype max_weight = std::max(
+          *std::max_element(weights, weights + count),
+          -*std::min_element(weights, weights + count));
+      const Dtype tolerance = 60 * max_weight * 1.01 / 127;
+      for (int i = 0; i < this->blob_top_->count(); ++i) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[i],
+                    this->blob_top_2_->cpu_data()[i], tolerance);
+      }
+    }
+  }
+}
+
 TYPED_TEST(InnerProductLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_);
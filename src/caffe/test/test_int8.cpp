@@ -0,0 +1,138 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/int8.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class Int8MatrixTest : public ::testing::Test {
+ protected:
+  Int8MatrixTest() : rows_(30), cols_(255), M_(70) {
+    Caffe::set_random_seed(1701);
+    // Integers up to 127 in each row, times a scale per row, are exact.
+    weights_.Reshape(rows_, cols_, 1, 1);
+    Dtype* w = weights_.mutable_cpu_data();
+    for (int i = 0; i < rows_; ++i) {
+      for (int j = 0; j < cols_; ++j) {
+        w[i * cols_ + j] = ((i * 37 + j * 11) % 255 - 127) * (i + 1) * 0.5;
+      }
+    }
+    inputs_.Reshape(M_, cols_, 1, 1);
+    Dtype* a = inputs_.mutable_cpu_data();
+    for (int i = 0; i < inputs_.count(); ++i) {
+      a[i] = ((i * 13) % 255 - 127) * 0.25;
+    }
+  }
+
+  // Checks actual against expected, relative to the mean expected value.
+  void CheckNear(const Blob<Dtype>& expected, const Blob<Dtype>& actual) {
+    const Dtype tolerance = 1e-5 * expected.asum_data() / expected.count();
+    for (int i = 0; i < expected.count(); ++i) {
+      ASSERT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i], tolerance);
+    }
+  }
+
+  const int rows_;
+  const int cols_;
+  const int M_;
+  Blob<Dtype> weights_;
+  Blob<Dtype> inputs_;
+};
+
+TYPED_TEST_CASE(Int8MatrixTest, TestDtypes);
+
+TYPED_TEST(Int8MatrixTest, TestGemmExact) {
+  const int rows = this->rows_;
+  const int cols = this->cols_;
+  const int M = this->M_;
+  Blob<TypeParam> c(M, rows, 1, 1);
+  Blob<TypeParam> expected(M, rows, 1, 1);
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasTrans, M, rows, cols, 1.,
+      this->inputs_.cpu_data(), this->weights_.cpu_data(), 0.,
+      expected.mutable_cpu_data());
+  Int8Matrix<TypeParam> matrix;
+  matrix.Pack(this->weights_.cpu_data(), rows, cols, false);
+  EXPECT_EQ(rows, matrix.rows());
+  EXPECT_EQ(cols, matrix.cols());
+  EXPECT_NEAR(0.5, matrix.scale(0), 1e-7);
+  // Calibrated and dynamic input ranges
+  const TypeParam ranges[] = {127 * 0.25, 0};
+  for (int r = 0; r < 2; ++r) {
+    matrix.Gemm(M, this->inputs_.cpu_data(), ranges[r], c.mutable_cpu_data());
+    this->CheckNear(expected, c);
+  }
+  // The transposed weights pack to the same matrix.
+  Blob<TypeParam> weights_t(cols, rows, 1, 1);
+  for (int i = 0; i < rows; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      weights_t.mutable_cpu_data()[j * rows + i] =
+          this->weights_.cpu_data()[i * cols + j];
+    }
+  }
+  matrix.Pack(weights_t.cpu_data(), rows, cols, true);
+  matrix.Gemm(M, this->inputs_.cpu_data(), 0, c.mutable_cpu_data());
+  this->CheckNear(expected, c);
+}
+
+TYPED_TEST(Int8MatrixTest, TestGemmRowsExact) {
+  const int cols = this->cols_;
+  const int M = this->M_;
+  const int row = 5;
+  const int count = 20;
+  // The inputs as cols x M
+  Blob<TypeParam> b(cols, M, 1, 1);
+  for (int i = 0; i < M; ++i) {
+    for (int j = 0; j < cols; ++j) {
+      b.mutable_cpu_data()[j * M + i] = this->inputs_.cpu_data()[i * cols + j];
+    }
+  }
+  Blob<TypeParam> c(count, M, 1, 1);
+  Blob<TypeParam> expected(count, M, 1, 1);
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasNoTrans, count, M, cols, 1.,
+      this->weights_.cpu_data() + row * cols, b.cpu_data(), 0.,
+      expected.mutable_cpu_data());
+  Int8Matrix<TypeParam> matrix;
+  matrix.Pack(this->weights_.cpu_data(), this->rows_, cols, false);
+  matrix.GemmRows(row, count, M, b.cpu_data(), 0, c.mutable_cpu_data());
+  this->CheckNear(expected, c);
+}
+
+TYPED_TEST(Int8MatrixTest, TestGemmRounding) {
+  const int rows = this->rows_;
+  const int cols = this->cols_;
+  const int M = this->M_;
+  FillerParameter filler_param;
+  filler_param.set_min(-1);
+  filler_param.set_max(1);
+  UniformFiller<TypeParam> filler(filler_param);
+  filler.Fill(&this->weights_);
+  filler.Fill(&this->inputs_);
+  Blob<TypeParam> c(M, rows, 1, 1);
+  Blob<TypeParam> expected(M, rows, 1, 1);
+  caffe_cpu_gemm<TypeParam>(CblasNoTrans, CblasTrans, M, rows, cols, 1.,
+      this->inputs_.cpu_data(), this->weights_.cpu_data(), 0.,
+      expected.mutable_cpu_data());
+  Int8Matrix<TypeParam> matrix;
+  matrix.Pack(this->weights_.cpu_data(), rows, cols, false);
+  matrix.Gemm(M, this->inputs_.cpu_data(), 1, c.mutable_cpu_data());
+  // Each value and weight is off by at most half a step of 1 / 127.
+  const TypeParam tolerance = cols * 1.01 / 127;
+  TypeParam error = 0;
+  for (int i = 0; i < c.count(); ++i) {
+    EXPECT_NEAR(expected.cpu_data()[i], c.cpu_data()[i], tolerance);
+    error += std::fabs(expected.cpu_data()[i] - c.cpu_data()[i]);
+  }
+  // The rounding errors mostly cancel out.
+  EXPECT_LT(error / c.count(), 0.1);
+}
+
+}  // namespace caffe
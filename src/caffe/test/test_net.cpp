@@ -8,6 +8,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layers/neuron_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -17,6 +18,32 @@
 
 namespace caffe {
 
+// Copies its bottom to its top, counting the calls to Reshape.
+template <typename Dtype>
+class ReshapeCountingLayer : public NeuronLayer<Dtype> {
+ public:
+  explicit ReshapeCountingLayer(const LayerParameter& param)
+      : NeuronLayer<Dtype>(param), reshapes_(0) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    ++reshapes_;
+    NeuronLayer<Dtype>::Reshape(bottom, top);
+  }
+  virtual inline const char* type() const { return "ReshapeCounting"; }
+
+  int reshapes_;
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    caffe_copy(bottom[0]->count(), bottom[0]->cpu_data(),
+               top[0]->mutable_cpu_data());
+  }
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down,
+      const vector<Blob<Dtype>*>& bottom) {}
+};
+
 template <typename TypeParam>
 class NetTest : public MultiDeviceTest<TypeParam> {
   typedef typename TypeParam::Dtype Dtype;
@@ -1342,6 +1369,194 @@ TYPED_TEST(NetTest, TestSharedWeightsResume) {
   }
 }
 
+TYPED_TEST(NetTest, TestCopyTrainedLayersFromMapped) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->ForwardBackward();
+  this->net_->Update();
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  const vector<shared_ptr<Blob<Dtype> > > params = this->net_->params();
+  string filename;
+  MakeTempFilename(&filename);
+  MappedWeights::Write(net_param, filename);
+  EXPECT_TRUE(MappedWeights::IsWeightsFile(filename));
+  WriteProtoToBinaryFile(net_param, filename + ".caffemodel");
+  EXPECT_FALSE(MappedWeights::IsWeightsFile(filename + ".caffemodel"));
+
+  // Load the weights file into a new net.
+  for (int pass = 0; pass < 2; ++pass) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitDiffDataSharedWeightsNet();
+    this->net_->CopyTrainedLayersFrom(filename);
+    ASSERT_EQ(params.size(), this->net_->params().size());
+    for (int i = 0; i < params.size(); ++i) {
+      const Blob<Dtype>& param = *this->net_->params()[i];
+      ASSERT_TRUE(params[i]->shape() == param.shape());
+      for (int j = 0; j < param.count(); ++j) {
+        EXPECT_EQ(static_cast<float>(params[i]->cpu_data()[j]),
+                  param.cpu_data()[j]);
+      }
+    }
+    // Shared weights still share memory.
+    Blob<Dtype>* ip1_weights = this->net_->layers()[1]->blobs()[0].get();
+    Blob<Dtype>* ip2_weights = this->net_->layers()[2]->blobs()[0].get();
+    EXPECT_EQ(ip1_weights->cpu_data(), ip2_weights->cpu_data());
+    // Changing the params leaves the file as it was for the next pass.
+    caffe_set(ip1_weights->count(), Dtype(7), ip1_weights->mutable_cpu_data());
+    this->net_->ForwardBackward();
+    this->net_->Update();
+  }
+}
+
+TYPED_TEST(NetTest, TestSharedNetWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataSharedWeightsNet();
+  this->net_->ForwardBackward();
+  this->net_->Update();
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  string filename;
+  MakeTempFilename(&filename);
+  WriteProtoToBinaryFile(net_param, filename);
+  shared_ptr<NetWeights<Dtype> > weights(new NetWeights<Dtype>(filename));
+  EXPECT_EQ(2, weights->layers().size());
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    net_param.mutable_layer(i)->clear_blobs();
+  }
+  Net<Dtype> net1(net_param, weights);
+  Net<Dtype> net2(net_param, weights);
+  const vector<shared_ptr<Blob<Dtype> > >& params = this->net_->params();
+  ASSERT_EQ(params.size(), net1.params().size());
+  ASSERT_EQ(params.size(), net2.params().size());
+  for (int i = 0; i < params.size(); ++i) {
+    // The nets have their own blobs, with the same data.
+    EXPECT_NE(net1.params()[i].get(), net2.params()[i].get());
+    EXPECT_EQ(net1.params()[i]->cpu_data(), net2.params()[i]->cpu_data());
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_EQ(params[i]->cpu_data()[j], net1.params()[i]->cpu_data()[j]);
+    }
+  }
+  // Both nets compute the same as the original.
+  Dtype loss, loss1, loss2;
+  Caffe::set_random_seed(this->seed_);
+  this->net_->Forward(&loss);
+  Caffe::set_random_seed(this->seed_);
+  net1.Forward(&loss1);
+  Caffe::set_random_seed(this->seed_);
+  net2.Forward(&loss2);
+  EXPECT_EQ(loss, loss1);
+  EXPECT_EQ(loss, loss2);
+}
+
+TYPED_TEST(NetTest, TestFlatParamsUpdate) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataUnsharedWeightsNet();
+  EXPECT_TRUE(NULL == this->net_->flat_params().get());
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  net_param.set_flat_params(true);
+  Net<Dtype> flat_net(net_param);
+  if (Caffe::mode() != Caffe::CPU) {
+    EXPECT_TRUE(NULL == flat_net.flat_params().get());
+    return;
+  }
+  // The params are laid out back to back in the flat buffer.
+  const vector<Blob<Dtype>*>& params = this->net_->learnable_params();
+  const vector<Blob<Dtype>*>& flat_params = flat_net.learnable_params();
+  ASSERT_FALSE(NULL == flat_net.flat_params().get());
+  ASSERT_EQ(params.size(), flat_params.size());
+  ASSERT_EQ(2, flat_params.size());
+  EXPECT_EQ(flat_params[0]->count() + flat_params[1]->count(),
+            flat_net.flat_params()->count());
+  EXPECT_EQ(flat_net.flat_params()->cpu_data(), flat_params[0]->cpu_data());
+  EXPECT_EQ(flat_params[0]->cpu_data() + flat_params[0]->count(),
+            flat_params[1]->cpu_data());
+  EXPECT_EQ(flat_net.flat_params()->cpu_diff(), flat_params[0]->cpu_diff());
+  EXPECT_EQ(flat_params[0]->cpu_diff() + flat_params[0]->count(),
+            flat_params[1]->cpu_diff());
+  // Training steps give the same params as without flattening.
+  for (int iter = 0; iter < 2; ++iter) {
+    Caffe::set_random_seed(this->seed_ + iter);
+    this->net_->ClearParamDiffs();
+    this->net_->ForwardBackward();
+    this->net_->Update();
+    Caffe::set_random_seed(this->seed_ + iter);
+    flat_net.ClearParamDiffs();
+    flat_net.ForwardBackward();
+    flat_net.Update();
+  }
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      EXPECT_NE(0, flat_params[i]->cpu_diff()[j]);
+      EXPECT_EQ(params[i]->cpu_diff()[j], flat_params[i]->cpu_diff()[j]);
+      EXPECT_EQ(params[i]->cpu_data()[j], flat_params[i]->cpu_data()[j]);
+    }
+  }
+  flat_net.ClearParamDiffs();
+  for (int j = 0; j < flat_net.flat_params()->count(); ++j) {
+    EXPECT_EQ(0, flat_net.flat_params()->cpu_diff()[j]);
+  }
+}
+
+TYPED_TEST(NetTest, TestFlatParamsShareTrainedLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataUnsharedWeightsNet();
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  net_param.set_flat_params(true);
+  // Shares only the first layer with params.
+  NetParameter source_param(net_param);
+  source_param.set_flat_params(false);
+  source_param.mutable_layer(2)->set_name("unshared");
+  Net<Dtype> source(source_param);
+  Net<Dtype> flat_net(net_param);
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  ASSERT_FALSE(NULL == flat_net.flat_params().get());
+  flat_net.ShareTrainedLayersWith(&source);
+  EXPECT_TRUE(NULL == flat_net.flat_params().get());
+  // The params left in the flat buffer, and all diffs, stay usable.
+  const vector<Blob<Dtype>*>& params = flat_net.learnable_params();
+  ASSERT_EQ(2, params.size());
+  EXPECT_EQ(source.learnable_params()[0]->cpu_data(), params[0]->cpu_data());
+  flat_net.ClearParamDiffs();
+  flat_net.ForwardBackward();
+  const Dtype first = params[1]->cpu_data()[0];
+  const Dtype diff = params[1]->cpu_diff()[0];
+  EXPECT_NE(0, diff);
+  flat_net.Update();
+  EXPECT_EQ(first - diff, params[1]->cpu_data()[0]);
+}
+
+TYPED_TEST(NetTest, TestFlatParamsNetWeights) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitDiffDataUnsharedWeightsNet();
+  NetParameter net_param;
+  this->net_->ToProto(&net_param);
+  string filename;
+  MakeTempFilename(&filename);
+  WriteProtoToBinaryFile(net_param, filename);
+  shared_ptr<NetWeights<Dtype> > weights(new NetWeights<Dtype>(filename));
+  for (int i = 0; i < net_param.layer_size(); ++i) {
+    net_param.mutable_layer(i)->clear_blobs();
+  }
+  net_param.set_flat_params(true);
+  // Flattening would move the weights of the other net too.
+  Net<Dtype> net1(net_param, weights);
+  Net<Dtype> net2(net_param, weights);
+  EXPECT_TRUE(NULL == net1.flat_params().get());
+  EXPECT_TRUE(NULL == net2.flat_params().get());
+  EXPECT_EQ(net1.learnable_params()[0]->cpu_data(),
+            net2.learnable_params()[0]->cpu_data());
+}
+
 TYPED_TEST(NetTest, TestParamPropagateDown) {
   typedef typename TypeParam::Dtype Dtype;
   const bool kBiasTerm = true, kForceBackward = false;
@@ -2446,6 +2661,97 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestReshapeIfChanged) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  ReshapeCountingLayer<Dtype> layer(layer_param);
+  Blob<Dtype> bottom(2, 3, 4, 5);
+  Blob<Dtype> top;
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  vector<Blob<Dtype>*> top_vec(1, &top);
+  layer.SetUp(bottom_vec, top_vec);
+  EXPECT_EQ(1, layer.reshapes_);
+  // Running on blobs of the same shapes does not reshape the layer again.
+  layer.Forward(bottom_vec, top_vec);
+  layer.Forward(bottom_vec, top_vec);
+  EXPECT_EQ(1, layer.reshapes_);
+  // A new bottom shape does, and so does a top reshaped elsewhere.
+  bottom.Reshape(1, 3, 4, 5);
+  layer.Forward(bottom_vec, top_vec);
+  EXPECT_EQ(2, layer.reshapes_);
+  EXPECT_EQ(bottom.shape(), top.shape());
+  top.Reshape(2, 2, 2, 2);
+  layer.Forward(bottom_vec, top_vec);
+  EXPECT_EQ(3, layer.reshapes_);
+  EXPECT_EQ(bottom.shape(), top.shape());
+}
+
+TYPED_TEST(NetTest, TestTracer) {
+  this->InitTinyNet();
+  shared_ptr<NetTracer> tracer(new NetTracer(4));
+  this->net_->set_tracer(tracer);
+  const int64_t start = NetTracer::Now();
+  this->net_->Forward();
+  this->net_->Backward();
+  const int64_t end = NetTracer::Now();
+  // The data layer does not need backward, and the first forward was
+  // overwritten.
+  EXPECT_EQ(5, tracer->recorded());
+  vector<NetTracer::Record> records;
+  tracer->Records(&records);
+  ASSERT_EQ(4, records.size());
+  const char* names[] = {"innerproduct", "loss", "loss", "innerproduct"};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(names[i], records[i].layer_name);
+    EXPECT_EQ(i >= 2, records[i].backward);
+    EXPECT_LE(start, records[i].start);
+    EXPECT_LE(records[i].start, records[i].end);
+    EXPECT_LE(records[i].end, end);
+    EXPECT_EQ(records[0].thread, records[i].thread);
+    // The tracer does not count events unless asked to.
+    EXPECT_EQ(-1, records[i].counts[PerfCounters::CYCLES]);
+    if (i > 0) {
+      EXPECT_LE(records[i - 1].end, records[i].start);
+    }
+  }
+  EXPECT_EQ(1, records[0].layer);
+  // innerproduct takes data of 5 x 2 x 3 x 4.
+  const int shape[] = {4, 5, 2, 3, 4};
+  EXPECT_EQ(vector<int>(shape, shape + 5), records[0].bottom_shapes);
+  tracer->Clear();
+  this->net_->set_tracer(shared_ptr<NetTracer>());
+  this->net_->Forward();
+  EXPECT_EQ(0, tracer->recorded());
+  tracer->Records(&records);
+  EXPECT_EQ(0, records.size());
+}
+
+TYPED_TEST(NetTest, TestMemoryReport) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->InitTinyNet();
+  vector<typename Net<Dtype>::LayerMemory> report;
+  this->net_->MemoryReport(&report);
+  ASSERT_EQ(3, report.size());
+  const size_t size = sizeof(Dtype);
+  // data computes data of 5 x 2 x 3 x 4 and a label of 5, but no diffs.
+  EXPECT_EQ(125 * size, report[0].top_data);
+  EXPECT_EQ(0, report[0].top_diff);
+  EXPECT_EQ(0, report[0].param_data);
+  EXPECT_EQ(0, report[0].internal);
+  // innerproduct has 1000 outputs of 24 inputs each, and a bias multiplier
+  // of the batch size, with its shape.
+  EXPECT_EQ(5000 * size, report[1].top_data);
+  EXPECT_EQ(5000 * size, report[1].top_diff);
+  EXPECT_EQ(25000 * size, report[1].param_data);
+  EXPECT_EQ(25000 * size, report[1].param_diff);
+  EXPECT_EQ(5 * size + sizeof(int), report[1].internal);
+  // loss computes a scalar, and its softmax.
+  EXPECT_EQ(size, report[2].top_data);
+  EXPECT_EQ(size, report[2].top_diff);
+  EXPECT_EQ(0, report[2].param_data);
+  EXPECT_LE(5000 * size, report[2].internal);
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -0,0 +1,74 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net_tracer.hpp"
+#include "caffe/util/perf_counters.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class PerfCountersTest : public ::testing::Test {};
+
+TEST_F(PerfCountersTest, TestForThread) {
+  PerfCounters* counters = PerfCounters::ForThread();
+  EXPECT_EQ(counters, PerfCounters::ForThread());
+  EXPECT_EQ(string("cycles"), PerfCounters::name(PerfCounters::CYCLES));
+  EXPECT_EQ(string("cache_misses"),
+            PerfCounters::name(PerfCounters::CACHE_MISSES));
+}
+
+TEST_F(PerfCountersTest, TestRead) {
+  // The counters may not be available here, in which case all read -1.
+  PerfCounters* counters = PerfCounters::ForThread();
+  int64_t before[PerfCounters::NUM_EVENTS];
+  int64_t after[PerfCounters::NUM_EVENTS];
+  counters->Read(before);
+  volatile double sum = 0;
+  for (int i = 0; i < 100000; ++i) {
+    sum += i * 0.5;
+  }
+  counters->Read(after);
+  bool any = false;
+  for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i) {
+    if (counters->available(i)) {
+      any = true;
+      EXPECT_GE(before[i], 0);
+      EXPECT_GE(after[i], before[i]);
+    } else {
+      EXPECT_EQ(-1, before[i]);
+      EXPECT_EQ(-1, after[i]);
+    }
+  }
+  EXPECT_EQ(any, counters->any_available());
+  if (counters->available(PerfCounters::INSTRUCTIONS)) {
+    EXPECT_GT(after[PerfCounters::INSTRUCTIONS],
+              before[PerfCounters::INSTRUCTIONS]);
+  }
+}
+
+TEST_F(PerfCountersTest, TestTracerCounts) {
+  PerfCounters* counters = PerfCounters::ForThread();
+  NetTracer tracer(2, true);
+  EXPECT_TRUE(tracer.count_events());
+  vector<Blob<float>*> bottom;
+  NetTracer::Start start;
+  tracer.Begin(&start);
+  tracer.Add("layer", 0, false, start, bottom);
+  vector<NetTracer::Record> records;
+  tracer.Records(&records);
+  ASSERT_EQ(1, records.size());
+  for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i) {
+    if (counters->available(i)) {
+      EXPECT_GE(records[0].counts[i], 0);
+    } else {
+      EXPECT_EQ(-1, records[0].counts[i]);
+    }
+  }
+}
+
+}  // namespace caffe
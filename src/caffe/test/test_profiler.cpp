@@ -0,0 +1,150 @@
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/profiler.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class NetProfilerTest : public ::testing::Test {
+ protected:
+  NetProfilerTest() {
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'input' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "  inner_product_param { num_output: 5 } "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+    net_->Forward();
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(NetProfilerTest, TestDtypes);
+
+TYPED_TEST(NetProfilerTest, TestSummarize) {
+  vector<float> times;
+  for (int i = 100; i > 0; --i) {
+    times.push_back(i * 1000);
+  }
+  typename NetProfiler<TypeParam>::Stats stats =
+      NetProfiler<TypeParam>::Summarize(times);
+  EXPECT_EQ(100, stats.count);
+  EXPECT_NEAR(50.5, stats.mean, 1e-6);
+  EXPECT_EQ(1, stats.min);
+  EXPECT_EQ(50, stats.median);
+  EXPECT_EQ(99, stats.p99);
+  stats = NetProfiler<TypeParam>::Summarize(vector<float>(1, 2000));
+  EXPECT_EQ(2, stats.median);
+  EXPECT_EQ(2, stats.p99);
+}
+
+TYPED_TEST(NetProfilerTest, TestEstimate) {
+  NetProfiler<TypeParam> profiler(*this->net_);
+  const int64_t size = sizeof(TypeParam);
+  // conv: 2 x 4 x 6 x 6 outputs of 3 x 3 x 3 multiply-adds plus a bias
+  const typename NetProfiler<TypeParam>::Cost& conv = profiler.cost(1);
+  EXPECT_EQ(2 * 288 * 27 + 288, conv.forward_flops);
+  EXPECT_EQ(2 * conv.forward_flops, conv.backward_flops);
+  EXPECT_EQ((216 + 288 + 112) * size, conv.forward_bytes);
+  EXPECT_EQ((288 + 112) * size, conv.allocated_bytes);
+  // The in-place relu allocates nothing.
+  EXPECT_EQ(288, profiler.cost(2).forward_flops);
+  EXPECT_EQ(0, profiler.cost(2).allocated_bytes);
+  // pool: 2 x 4 x 3 x 3 outputs of 2 x 2 windows
+  EXPECT_EQ(72 * 4, profiler.cost(3).forward_flops);
+  // ip: 2 x 5 outputs of 36 multiply-adds plus a bias
+  EXPECT_EQ(2 * 10 * 36 + 10, profiler.cost(4).forward_flops);
+}
+
+TYPED_TEST(NetProfilerTest, TestCounts) {
+  NetProfiler<TypeParam> profiler(*this->net_);
+  int64_t counts[PerfCounters::NUM_EVENTS] = {100, 50, -1, 4};
+  profiler.AddCounts(1, false, counts);
+  counts[0] = 200;
+  counts[3] = -1;
+  profiler.AddCounts(1, false, counts);
+  EXPECT_EQ(150, profiler.MeanCount(1, false, PerfCounters::CYCLES));
+  EXPECT_EQ(50, profiler.MeanCount(1, false, PerfCounters::INSTRUCTIONS));
+  // An event not counted in every run has no mean.
+  EXPECT_EQ(-1, profiler.MeanCount(1, false,
+                                   PerfCounters::CACHE_REFERENCES));
+  EXPECT_EQ(-1, profiler.MeanCount(1, false, PerfCounters::CACHE_MISSES));
+  EXPECT_EQ(-1, profiler.MeanCount(1, true, PerfCounters::CYCLES));
+  EXPECT_EQ(-1, profiler.MeanCount(0, false, PerfCounters::CYCLES));
+}
+
+TYPED_TEST(NetProfilerTest, TestWrite) {
+  NetProfiler<TypeParam> profiler(*this->net_);
+  for (int i = 0; i < 3; ++i) {
+    const double start = 100 * i;
+    profiler.AddPass(false, start, 50);
+    for (int j = 0; j < this->net_->layers().size(); ++j) {
+      profiler.AddLayer(j, false, start + 10 * j, 10);
+    }
+  }
+  EXPECT_EQ(3, profiler.LayerStats(1, false).count);
+  EXPECT_EQ(0, profiler.LayerStats(1, true).count);
+  EXPECT_NEAR(0.05, profiler.PassStats(false).median, 1e-6);
+  std::ostringstream json;
+  profiler.WriteJSON(&json);
+  EXPECT_NE(string::npos, json.str().find("\"net\": \"TestNetwork\""));
+  EXPECT_NE(string::npos, json.str().find(
+      "{\"name\": \"conv\", \"type\": \"Convolution\""));
+  EXPECT_NE(string::npos, json.str().find("\"top_shapes\": [[2, 5]]"));
+  std::ostringstream trace;
+  profiler.WriteTrace(&trace);
+  EXPECT_EQ(0, trace.str().find("{\"traceEvents\": ["));
+  EXPECT_NE(string::npos, trace.str().find(
+      "{\"name\": \"pool\", \"cat\": \"forward\", "
+      "\"args\": {\"type\": \"Pooling\"}, \"ph\": \"X\", \"pid\": 0, "
+      "\"tid\": 0, \"ts\": 230.0, \"dur\": 10.0}"));
+}
+
+}  // namespace caffe
@@ -34,6 +34,24 @@ TEST_F(SyncedMemoryTest, TestAllocationCPUGPU) {
 
 #endif
 
+TEST_F(SyncedMemoryTest, TestAllocatedBytes) {
+  const int64_t allocated = SyncedMemory::thread_allocated_bytes();
+  {
+    SyncedMemory mem(10);
+    EXPECT_EQ(0, mem.allocated_size());
+    EXPECT_EQ(allocated, SyncedMemory::thread_allocated_bytes());
+    mem.cpu_data();
+    EXPECT_EQ(10, mem.allocated_size());
+    EXPECT_EQ(allocated + 10, SyncedMemory::thread_allocated_bytes());
+    mem.Resize(20);
+    EXPECT_EQ(0, mem.allocated_size());
+    EXPECT_EQ(allocated, SyncedMemory::thread_allocated_bytes());
+    mem.mutable_cpu_data();
+    EXPECT_EQ(allocated + 20, SyncedMemory::thread_allocated_bytes());
+  }
+  EXPECT_EQ(allocated, SyncedMemory::thread_allocated_bytes());
+}
+
 TEST_F(SyncedMemoryTest, TestAllocationCPU) {
   SyncedMemory mem(10);
   EXPECT_TRUE(mem.cpu_data());
@@ -67,6 +85,21 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  const size_t version = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), version);
+  mem.mutable_cpu_data();
+  EXPECT_NE(mem.version(), version);
+  const size_t written = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), written);
+  char data[10];
+  mem.set_cpu_data(data);
+  EXPECT_NE(mem.version(), written);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
@@ -0,0 +1,162 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/tiled_net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class TiledNetTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  TiledNetTest() : seed_(1701) {
+    // A trunk with a receptive field of 8 x 10, whose features are also
+    // used by another layer besides the ROI pooling.
+    const string proto =
+        "name: 'TestNetwork' "
+        "layer { "
+        "  name: 'input' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  top: 'rois' "
+        "  input_param { "
+        "    shape { dim: 1 dim: 2 dim: 16 dim: 16 } "
+        "    shape { dim: 3 dim: 5 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_h: 3 "
+        "    kernel_w: 5 "
+        "    pad_h: 1 "
+        "    pad_w: 2 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 3 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'score' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv2' "
+        "  top: 'score' "
+        "  convolution_param { "
+        "    num_output: 1 "
+        "    kernel_size: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'roi_pool' "
+        "  type: 'ROIPooling' "
+        "  bottom: 'conv2' "
+        "  bottom: 'rois' "
+        "  top: 'roi_pool' "
+        "  roi_pooling_param { pooled_h: 2 pooled_w: 2 spatial_scale: 0.5 } "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param_));
+  }
+
+  int seed_;
+  NetParameter param_;
+};
+
+TYPED_TEST_CASE(TiledNetTest, TestDtypesAndDevices);
+
+TYPED_TEST(TiledNetTest, TestReceptiveField) {
+  typedef typename TypeParam::Dtype Dtype;
+  TilingParameter tiling_param;
+  TiledNet<Dtype> net(tiling_param, this->param_);
+  EXPECT_EQ(2, net.stride(0));
+  EXPECT_EQ(2, net.stride(1));
+  EXPECT_EQ(3, net.pad(0));
+  EXPECT_EQ(4, net.pad(1));
+  EXPECT_EQ(8, net.size(0));
+  EXPECT_EQ(10, net.size(1));
+  // The trunk stops at the features.
+  EXPECT_TRUE(net.trunk()->has_blob("conv2"));
+  EXPECT_FALSE(net.trunk()->has_blob("score"));
+  EXPECT_FALSE(net.trunk()->has_blob("roi_pool"));
+}
+
+TYPED_TEST(TiledNetTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  TilingParameter tiling_param;
+  tiling_param.set_tile_height(12);
+  tiling_param.set_tile_width(15);
+  TiledNet<Dtype> tiled(tiling_param, this->param_);
+  Blob<Dtype> image(1, 2, 23, 30);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&image);
+  const Dtype rois[] = {0, 0, 0, 29, 22, 0, 3, 8, 20, 14, 0, 16, 2, 27, 21};
+  caffe_copy(15, rois, tiled.net()->blob_by_name("rois")->mutable_cpu_data());
+  tiled.Forward(image);
+
+  // The same net run on the whole image
+  Net<Dtype> net(this->param_);
+  net.ShareTrainedLayersWith(tiled.net().get());
+  net.blob_by_name("data")->ReshapeLike(image);
+  net.Reshape();
+  caffe_copy(image.count(), image.cpu_data(),
+             net.blob_by_name("data")->mutable_cpu_data());
+  caffe_copy(15, rois, net.blob_by_name("rois")->mutable_cpu_data());
+  net.Forward();
+  const char* names[] = {"conv2", "score", "roi_pool"};
+  for (int i = 0; i < 3; ++i) {
+    const Blob<Dtype>& expected = *net.blob_by_name(names[i]);
+    const Blob<Dtype>& actual = *tiled.net()->blob_by_name(names[i]);
+    ASSERT_EQ(expected.shape(), actual.shape()) << names[i];
+    for (int j = 0; j < expected.count(); ++j) {
+      EXPECT_NEAR(expected.cpu_data()[j], actual.cpu_data()[j], 1e-5)
+          << names[i] << " " << j;
+    }
+  }
+  // The trunk only ran on tiles.
+  EXPECT_LE(tiled.trunk()->blob_by_name("data")->height(), 12);
+  EXPECT_LE(tiled.trunk()->blob_by_name("data")->width(), 15);
+}
+
+}  // namespace caffe
@@ -0,0 +1,96 @@
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/transport.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Sums rank + i over the ring into value i.
+template <typename Dtype>
+void RingAllreduceRank(const vector<string>& addresses, int rank,
+    vector<Dtype>* values) {
+  SocketTransport transport(addresses, rank);
+  vector<Dtype> buffer;
+  // Twice, reusing the buffer
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < values->size(); ++i) {
+      (*values)[i] = rank + i;
+    }
+    ring_allreduce(&transport, &(*values)[0], values->size(), &buffer);
+  }
+}
+
+// Broadcasts i from rank 0 into value i.
+template <typename Dtype>
+void RingBroadcastRank(const vector<string>& addresses, int rank,
+    vector<Dtype>* values) {
+  SocketTransport transport(addresses, rank);
+  for (int i = 0; i < values->size(); ++i) {
+    (*values)[i] = rank == 0 ? i : -1;
+  }
+  ring_broadcast(&transport, &(*values)[0], values->size());
+}
+
+template <typename Dtype>
+class TransportTest : public ::testing::Test {
+ protected:
+  // Runs f for each rank of a ring of the given size on its own thread, as
+  // separate processes would, connected through unix sockets.
+  void RunRing(int size, int count,
+      void (*f)(const vector<string>&, int, vector<Dtype>*)) {
+    string dir;
+    MakeTempDir(&dir);
+    vector<string> addresses;
+    for (int rank = 0; rank < size; ++rank) {
+      addresses.push_back("unix://" + dir + "/" + format_int(rank));
+    }
+    values_.assign(size, vector<Dtype>(count));
+    boost::thread_group threads;
+    for (int rank = 0; rank < size; ++rank) {
+      threads.create_thread(boost::bind(f, boost::cref(addresses), rank,
+                                        &values_[rank]));
+    }
+    threads.join_all();
+  }
+
+  vector<vector<Dtype> > values_;
+};
+
+TYPED_TEST_CASE(TransportTest, TestDtypes);
+
+TYPED_TEST(TransportTest, TestAllreduce) {
+  for (int size = 1; size <= 4; ++size) {
+    // Fewer values than processes leaves some chunks empty.
+    const int counts[] = {2, 1001};
+    for (int c = 0; c < 2; ++c) {
+      this->RunRing(size, counts[c], &RingAllreduceRank<TypeParam>);
+      for (int rank = 0; rank < size; ++rank) {
+        for (int i = 0; i < counts[c]; ++i) {
+          EXPECT_EQ(size * (size - 1) / 2 + size * i,
+                    this->values_[rank][i]);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(TransportTest, TestBroadcast) {
+  // Spans several pipelined chunks.
+  const int count = (1 << 20) * 2 + 3;
+  this->RunRing(3, count, &RingBroadcastRank<TypeParam>);
+  for (int rank = 0; rank < 3; ++rank) {
+    for (int i = 0; i < count; ++i) {
+      ASSERT_EQ(i, this->values_[rank][i]);
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/tiled_net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Reads the height (axis 0) or width (axis 1) of a kernel, stride, pad or
+// dilation, given as one value for both, a value per axis, or neither.
+static int AxisValue(
+    const google::protobuf::RepeatedField<google::protobuf::uint32>& values,
+    int axis, int default_value) {
+  if (values.size() == 0) {
+    return default_value;
+  }
+  return values.Get(values.size() == 1 ? 0 : axis);
+}
+
+template <typename Dtype>
+TiledNet<Dtype>::TiledNet(const TilingParameter& tiling_param,
+    const NetParameter& param, shared_ptr<NetWeights<Dtype> > weights)
+    : param_(tiling_param) {
+  CHECK(param_.tile_height() > 0 && param_.tile_width() > 0)
+      << "The tile size must be positive";
+  net_.reset(new Net<Dtype>(param, weights));
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_->layers();
+  feature_blob_ = param_.feature_blob();
+  for (int i = 0; i < layers.size() && feature_blob_.empty(); ++i) {
+    const string& type = layers[i]->type();
+    if (type == string("ROIPooling") || type == string("ROIAlign") ||
+        type == string("PSROIPooling") || type == string("PSROIAlign")) {
+      feature_blob_ = net_->blob_names()[net_->bottom_ids(i)[0]];
+    }
+  }
+  CHECK(!feature_blob_.empty())
+      << "The net has no ROI pooling layer; set feature_blob";
+  CHECK(net_->has_blob(feature_blob_)) << "Unknown blob " << feature_blob_;
+  // Take the features from before they are split between their consumers.
+  int feature_id = -1;
+  int end = -1;
+  for (bool split = true; split;) {
+    const vector<string>& blob_names = net_->blob_names();
+    feature_id = std::find(blob_names.begin(), blob_names.end(),
+                           feature_blob_) - blob_names.begin();
+    for (int i = 0; i < layers.size(); ++i) {
+      const vector<int>& top_ids = net_->top_ids(i);
+      if (std::find(top_ids.begin(), top_ids.end(), feature_id) !=
+          top_ids.end()) {
+        end = i;
+      }
+    }
+    CHECK_GE(end, 0) << "No layer produces " << feature_blob_;
+    split = layers[end]->type() == string("Split");
+    if (split) {
+      feature_blob_ = net_->blob_names()[net_->bottom_ids(end)[0]];
+    }
+  }
+
+  // The trunk is the layers that the features depend on.
+  std::set<int> needed, trunk_blobs;
+  needed.insert(feature_id);
+  vector<bool> in_trunk(layers.size(), false);
+  for (int i = end; i >= 0; --i) {
+    const vector<int>& top_ids = net_->top_ids(i);
+    for (int j = 0; j < top_ids.size() && !in_trunk[i]; ++j) {
+      in_trunk[i] = needed.count(top_ids[j]) > 0;
+    }
+    if (in_trunk[i]) {
+      needed.insert(net_->bottom_ids(i).begin(), net_->bottom_ids(i).end());
+      // The inputs of the net are set on it as usual.
+      if (net_->bottom_ids(i).size() > 0) {
+        trunk_blobs.insert(top_ids.begin(), top_ids.end());
+      }
+    }
+  }
+  NetParameter trunk_param;
+  trunk_param.set_name(net_->name() + "_trunk");
+  trunk_param.mutable_state()->set_phase(net_->phase());
+  for (int i = 0; i < layers.size(); ++i) {
+    if (in_trunk[i]) {
+      LayerParameter* layer_param = trunk_param.add_layer();
+      layer_param->CopyFrom(layers[i]->layer_param());
+      layer_param->clear_blobs();
+      layer_param->clear_include();
+      layer_param->clear_exclude();
+      continue;
+    }
+    const vector<int>& bottom_ids = net_->bottom_ids(i);
+    for (int j = 0; j < bottom_ids.size(); ++j) {
+      CHECK(bottom_ids[j] == feature_id || !trunk_blobs.count(bottom_ids[j]))
+          << "Layer " << net_->layer_names()[i] << " takes "
+          << net_->blob_names()[bottom_ids[j]] << " from the trunk, which "
+          << "only gives " << feature_blob_;
+    }
+    head_layers_.push_back(i);
+  }
+  trunk_.reset(new Net<Dtype>(trunk_param, weights));
+  if (!weights) {
+    trunk_->ShareTrainedLayersWith(net_.get());
+  }
+  CHECK(trunk_->has_blob(param_.data_blob()))
+      << "The features do not depend on " << param_.data_blob();
+  InitReceptiveField();
+  LOG(INFO) << "Tiling " << trunk_->layers().size() << " layers up to "
+            << feature_blob_ << ", of stride " << stride_[0] << " x "
+            << stride_[1] << " and receptive field " << size_[0] << " x "
+            << size_[1];
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::InitReceptiveField() {
+  const Net<Dtype>& net = *trunk_;
+  // The receptive field of each blob, per axis
+  vector<vector<int> > stride(net.blobs().size());
+  vector<vector<int> > pad(net.blobs().size());
+  vector<vector<int> > size(net.blobs().size());
+  for (int i = 0; i < net.layers().size(); ++i) {
+    const LayerParameter& layer_param = net.layers()[i]->layer_param();
+    const vector<int>& bottom_ids = net.bottom_ids(i);
+    // The receptive field of the bottoms, which must be aligned
+    vector<int> s(2, 1), p(2, 0), k(2, 1);
+    for (int j = 0; j < bottom_ids.size(); ++j) {
+      const int id = bottom_ids[j];
+      CHECK(!stride[id].empty()) << "Unknown input " << net.blob_names()[id];
+      CHECK(j == 0 || (stride[id] == s && pad[id] == p))
+          << "The bottoms of " << layer_param.name() << " are not aligned";
+      s = stride[id];
+      p = pad[id];
+      for (int a = 0; a < 2; ++a) {
+        k[a] = std::max(k[a], size[id][a]);
+      }
+    }
+    // The kernel, stride, pad and dilation of the layer
+    int kernel[2] = {1, 1}, step[2] = {1, 1}, padding[2] = {0, 0};
+    int dilation[2] = {1, 1};
+    const string& type = layer_param.type();
+    if (bottom_ids.empty()) {
+      // An input of the net
+    } else if (type == "Convolution") {
+      const ConvolutionParameter& conv_param =
+          layer_param.convolution_param();
+      CHECK_EQ(1, conv_param.axis()) << "Can only tile 2D convolutions";
+      for (int a = 0; a < 2; ++a) {
+        kernel[a] = conv_param.has_kernel_h() ?
+            (a == 0 ? conv_param.kernel_h() : conv_param.kernel_w()) :
+            AxisValue(conv_param.kernel_size(), a, 1);
+        step[a] = conv_param.has_stride_h() ?
+            (a == 0 ? conv_param.stride_h() : conv_param.stride_w()) :
+            AxisValue(conv_param.stride(), a, 1);
+        padding[a] = conv_param.has_pad_h() ?
+            (a == 0 ? conv_param.pad_h() : conv_param.pad_w()) :
+            AxisValue(conv_param.pad(), a, 0);
+        dilation[a] = AxisValue(conv_param.dilation(), a, 1);
+      }
+    } else if (type == "Pooling") {
+      const PoolingParameter& pool_param = layer_param.pooling_param();
+      CHECK(!pool_param.global_pooling())
+          << "Cannot tile global pooling " << layer_param.name();
+      kernel[0] = pool_param.has_kernel_h() ? pool_param.kernel_h() :
+          pool_param.kernel_size();
+      kernel[1] = pool_param.has_kernel_w() ? pool_param.kernel_w() :
+          pool_param.kernel_size();
+      step[0] = pool_param.has_stride_h() ? pool_param.stride_h() :
+          pool_param.stride();
+      step[1] = pool_param.has_stride_w() ? pool_param.stride_w() :
+          pool_param.stride();
+      padding[0] = pool_param.has_pad_h() ? pool_param.pad_h() :
+          pool_param.pad();
+      padding[1] = pool_param.has_pad_w() ? pool_param.pad_w() :
+          pool_param.pad();
+    } else if (type == "LRN") {
+      const LRNParameter& lrn_param = layer_param.lrn_param();
+      if (lrn_param.norm_region() == LRNParameter_NormRegion_WITHIN_CHANNEL) {
+        kernel[0] = kernel[1] = lrn_param.local_size();
+        padding[0] = padding[1] = (lrn_param.local_size() - 1) / 2;
+      }
+    } else if (type == "Concat") {
+      CHECK_EQ(1, layer_param.concat_param().axis())
+          << "Can only tile concatenation along channels";
+    } else if (type != "ReLU" && type != "PReLU" && type != "ELU" &&
+               type != "Sigmoid" && type != "TanH" && type != "AbsVal" &&
+               type != "BNLL" && type != "Power" && type != "Exp" &&
+               type != "Log" && type != "Threshold" && type != "Dropout" &&
+               type != "BatchNorm" && type != "BatchNormFixed" &&
+               type != "Scale" && type != "ScaleFixed" && type != "Bias" &&
+               type != "Split" && type != "Eltwise") {
+      LOG(FATAL) << "Cannot tile layer " << layer_param.name() << " of type "
+                 << type;
+    }
+    for (int a = 0; a < 2; ++a) {
+      k[a] += (dilation[a] * (kernel[a] - 1)) * s[a];
+      p[a] += padding[a] * s[a];
+      s[a] *= step[a];
+    }
+    const vector<int>& top_ids = net.top_ids(i);
+    for (int j = 0; j < top_ids.size(); ++j) {
+      stride[top_ids[j]] = s;
+      pad[top_ids[j]] = p;
+      size[top_ids[j]] = k;
+    }
+  }
+  const int feature_id = std::find(net.blob_names().begin(),
+      net.blob_names().end(), feature_blob_) - net.blob_names().begin();
+  for (int a = 0; a < 2; ++a) {
+    stride_[a] = stride[feature_id][a];
+    pad_[a] = pad[feature_id][a];
+    size_[a] = size[feature_id][a];
+  }
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::Split(int axis, int length, vector<Tile>* tiles) const {
+  const int tile_size = axis == 0 ? param_.tile_height() : param_.tile_width();
+  // The features of a tile, other than at the borders of the image, whose
+  // receptive field is within the tile
+  const int first = (pad_[axis] + stride_[axis] - 1) / stride_[axis];
+  const int last = tile_size + pad_[axis] >= size_[axis] ?
+      (tile_size + pad_[axis] - size_[axis]) / stride_[axis] : -1;
+  CHECK_GE(last, first) << "Tiles of " << tile_size << " are too small for "
+      << "a receptive field of " << size_[axis];
+  tiles->clear();
+  for (int begin = 0; ; begin += (last - first + 1) * stride_[axis]) {
+    Tile tile;
+    tile.begin = begin;
+    tile.end = std::min(begin + tile_size, length);
+    tile.feature_begin = begin == 0 ? 0 : begin / stride_[axis] + first;
+    tile.feature_end = begin / stride_[axis] + last + 1;
+    tiles->push_back(tile);
+    if (tile.end == length) {
+      break;
+    }
+  }
+}
+
+template <typename Dtype>
+const Blob<Dtype>& TiledNet<Dtype>::RunTrunk(const Blob<Dtype>& image,
+    const Tile& row, const Tile& col) {
+  Blob<Dtype>* data = trunk_->blob_by_name(param_.data_blob()).get();
+  const int height = row.end - row.begin;
+  const int width = col.end - col.begin;
+  data->Reshape(image.num(), image.channels(), height, width);
+  Dtype* data_data = data->mutable_cpu_data();
+  for (int n = 0; n < image.num(); ++n) {
+    for (int c = 0; c < image.channels(); ++c) {
+      for (int y = 0; y < height; ++y) {
+        caffe_copy(width,
+                   image.cpu_data() + image.offset(n, c, row.begin + y,
+                                                   col.begin),
+                   data_data + data->offset(n, c, y));
+      }
+    }
+  }
+  trunk_->Forward();
+  return *trunk_->blob_by_name(feature_blob_);
+}
+
+template <typename Dtype>
+void TiledNet<Dtype>::Stitch(const Blob<Dtype>& tile_features,
+    const Tile& row, const Tile& col) {
+  Blob<Dtype>* features = net_->blob_by_name(feature_blob_).get();
+  const int row_offset = row.begin / stride_[0];
+  const int col_offset = col.begin / stride_[1];
+  CHECK_LE(row.feature_end - row_offset, tile_features.height());
+  CHECK_LE(col.feature_end - col_offset, tile_features.width());
+  const int width = col.feature_end - col.feature_begin;
+  Dtype* features_data = features->mutable_cpu_data();
+  for (int n = 0; n < features->num(); ++n) {
+    for (int c = 0; c < features->channels(); ++c) {
+      for (int y = row.feature_begin; y < row.feature_end; ++y) {
+        caffe_copy(width,
+                   tile_features.cpu_data() + tile_features.offset(n, c,
+                       y - row_offset, col.feature_begin - col_offset),
+                   features_data + features->offset(n, c, y,
+                                                    col.feature_begin));
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+const vector<Blob<Dtype>*>& TiledNet<Dtype>::Forward(
+    const Blob<Dtype>& image) {
+  CHECK_EQ(4, image.num_axes()) << "The image must be N x C x H x W";
+  vector<Tile> rows, cols;
+  Split(0, image.height(), &rows);
+  Split(1, image.width(), &cols);
+  // The bottom right tile, run first, gives the size of the features.
+  const Blob<Dtype>& last = RunTrunk(image, rows.back(), cols.back());
+  CHECK_EQ(4, last.num_axes()) << "The features must be N x C x H x W";
+  net_->blob_by_name(feature_blob_)->Reshape(last.num(), last.channels(),
+      rows.back().begin / stride_[0] + last.height(),
+      cols.back().begin / stride_[1] + last.width());
+  rows.back().feature_end = rows.back().begin / stride_[0] + last.height();
+  cols.back().feature_end = cols.back().begin / stride_[1] + last.width();
+  Stitch(last, rows.back(), cols.back());
+  for (int r = 0; r < rows.size(); ++r) {
+    for (int c = 0; c < cols.size(); ++c) {
+      if (r + 1 < rows.size() || c + 1 < cols.size()) {
+        Stitch(RunTrunk(image, rows[r], cols[c]), rows[r], cols[c]);
+      }
+    }
+  }
+  for (int i = 0; i < head_layers_.size(); ++i) {
+    net_->ForwardFromTo(head_layers_[i], head_layers_[i]);
+  }
+  return net_->output_blobs();
+}
+
+INSTANTIATE_CLASS(TiledNet);
+
+}  // namespace caffe
@@ -1,7 +1,9 @@
 #include <boost/thread.hpp>
 #include <string>
 
+#include "caffe/inference_server.hpp"
 #include "caffe/layers/base_data_layer.hpp"
+#include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
@@ -40,6 +42,23 @@ bool BlockingQueue<T>::try_pop(T* t) {
   return true;
 }
 
+template<typename T>
+bool BlockingQueue<T>::try_pop(T* t, int timeout_us) {
+  const boost::system_time deadline = boost::get_system_time()
+      + boost::posix_time::microseconds(timeout_us);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+
+  while (queue_.empty()) {
+    if (!sync_->condition_.timed_wait(lock, deadline) && queue_.empty()) {
+      return false;
+    }
+  }
+
+  *t = queue_.front();
+  queue_.pop();
+  return true;
+}
+
 template<typename T>
 T BlockingQueue<T>::pop(const string& log_on_wait) {
   boost::mutex::scoped_lock lock(sync_->mutex_);
@@ -85,7 +104,12 @@ size_t BlockingQueue<T>::size() const {
   return queue_.size();
 }
 
+template class BlockingQueue<int>;
 template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
+template class BlockingQueue<HDF5Chunk<float>*>;
+template class BlockingQueue<HDF5Chunk<double>*>;
+template class BlockingQueue<InferenceRequest<float>*>;
+template class BlockingQueue<InferenceRequest<double>*>;
 
 }  // namespace caffe
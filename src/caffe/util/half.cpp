@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+// Size of the Dtype rows converted at once
+static const int kTileBytes = 1 << 18;
+
+// caffe_cpu_gemm on sub-matrices, given their leading dimensions.
+template <typename Dtype>
+static void gemm_ld(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const Dtype* A, const int lda, const Dtype* B, const int ldb,
+    const Dtype beta, Dtype* C, const int ldc);
+
+template <>
+void gemm_ld<float>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const float* A, const int lda, const float* B, const int ldb,
+    const float beta, float* C, const int ldc) {
+  cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, 1.f, A, lda, B, ldb,
+      beta, C, ldc);
+}
+
+template <>
+void gemm_ld<double>(const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const double* A, const int lda, const double* B, const int ldb,
+    const double beta, double* C, const int ldc) {
+  cblas_dgemm(CblasRowMajor, TransA, TransB, M, N, K, 1., A, lda, B, ldb,
+      beta, C, ldc);
+}
+
+template <typename Dtype>
+void HalfMatrix<Dtype>::Pack(const Dtype* data, int rows, int cols,
+    bool bf16) {
+  CHECK_GT(rows, 0);
+  CHECK_GT(cols, 0);
+  rows_ = rows;
+  cols_ = cols;
+  bf16_ = bf16;
+  const int count = rows * cols;
+  values_.resize(count);
+  if (bf16) {
+    for (int i = 0; i < count; ++i) {
+      values_[i] = float_to_bf16(data[i]);
+    }
+  } else {
+    for (int i = 0; i < count; ++i) {
+      values_[i] = float_to_fp16(data[i]);
+    }
+  }
+  tile_.resize(std::min(rows_, tile_rows()) * cols_);
+}
+
+template <typename Dtype>
+void HalfMatrix<Dtype>::Clear() {
+  rows_ = cols_ = 0;
+  vector<uint16_t>().swap(values_);
+  vector<Dtype>().swap(tile_);
+}
+
+template <typename Dtype>
+int HalfMatrix<Dtype>::tile_rows() const {
+  return std::max(1, kTileBytes / static_cast<int>(cols_ * sizeof(Dtype)));
+}
+
+template <typename Dtype>
+void HalfMatrix<Dtype>::Unpack(int row, int count, Dtype* data) const {
+  CHECK_GE(row, 0);
+  CHECK_LE(row + count, rows_);
+  const uint16_t* values = &values_[0] + row * cols_;
+  const int n = count * cols_;
+  if (bf16_) {
+    for (int i = 0; i < n; ++i) {
+      data[i] = bf16_to_float(values[i]);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      data[i] = fp16_to_float(values[i]);
+    }
+  }
+}
+
+template <typename Dtype>
+void HalfMatrix<Dtype>::Gemm(const CBLAS_TRANSPOSE TransW, const int M,
+    const Dtype* A, Dtype* C) {
+  CHECK(!empty());
+  Dtype* tile = &tile_[0];
+  for (int row = 0; row < rows_; row += tile_rows()) {
+    const int count = std::min(tile_rows(), rows_ - row);
+    Unpack(row, count, tile);
+    if (TransW == CblasTrans) {
+      // The rows of W are columns [row, row + count) of C.
+      gemm_ld<Dtype>(CblasNoTrans, CblasTrans, M, count, cols_, A, cols_,
+          tile, cols_, Dtype(0), C + row, rows_);
+    } else {
+      // The rows of W multiply columns [row, row + count) of A.
+      gemm_ld<Dtype>(CblasNoTrans, CblasNoTrans, M, cols_, count, A + row,
+          rows_, tile, cols_, Dtype(row > 0 ? 1 : 0), C, cols_);
+    }
+  }
+}
+
+template <typename Dtype>
+void HalfMatrix<Dtype>::GemmRows(const int row, const int count, const int N,
+    const Dtype* B, Dtype* C) {
+  CHECK(!empty());
+  Dtype* tile = &tile_[0];
+  for (int i = 0; i < count; i += tile_rows()) {
+    const int tile_count = std::min(tile_rows(), count - i);
+    Unpack(row + i, tile_count, tile);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, tile_count, N, cols_,
+        Dtype(1), tile, B, Dtype(0), C + i * N);
+  }
+}
+
+INSTANTIATE_CLASS(HalfMatrix);
+
+}  // namespace caffe
@@ -1,10 +1,24 @@
 #include "caffe/util/hdf5.hpp"
 
+#include <boost/thread.hpp>
+
 #include <string>
 #include <vector>
 
 namespace caffe {
 
+// Never deleted, so that it outlives the threads and static objects that
+// may still write HDF5 files at exit.
+static boost::recursive_mutex* hdf5_mutex_ = new boost::recursive_mutex();
+
+HDF5Lock::HDF5Lock() {
+  hdf5_mutex_->lock();
+}
+
+HDF5Lock::~HDF5Lock() {
+  hdf5_mutex_->unlock();
+}
+
 // Verifies format of data stored in HDF5 file and reshapes blob accordingly.
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
@@ -103,6 +117,72 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+hsize_t hdf5_get_num_rows(hid_t file_id, const char* dataset_name_) {
+  CHECK(H5LTfind_dataset(file_id, dataset_name_))
+      << "Failed to find HDF5 dataset " << dataset_name_;
+  int ndims;
+  herr_t status = H5LTget_dataset_ndims(file_id, dataset_name_, &ndims);
+  CHECK_GE(status, 0) << "Failed to get dataset ndims for " << dataset_name_;
+  CHECK_GE(ndims, 1) << "Dataset " << dataset_name_ << " has no axes";
+  std::vector<hsize_t> dims(ndims);
+  H5T_class_t class_;
+  status = H5LTget_dataset_info(
+      file_id, dataset_name_, dims.data(), &class_, NULL);
+  CHECK_GE(status, 0) << "Failed to get dataset info for " << dataset_name_;
+  return dims[0];
+}
+
+// Selects a hyperslab of whole rows and reads it converted to mem_type.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows_helper(
+    hid_t file_id, const char* dataset_name_, hsize_t row_start,
+    hsize_t num_rows, Blob<Dtype>* blob, hid_t mem_type) {
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset);
+  CHECK_GE(file_space, 0) << "Failed to get dataspace of " << dataset_name_;
+  const int ndims = H5Sget_simple_extent_ndims(file_space);
+  CHECK_GE(ndims, 1) << "Dataset " << dataset_name_ << " has no axes";
+  std::vector<hsize_t> dims(ndims);
+  H5Sget_simple_extent_dims(file_space, dims.data(), NULL);
+  CHECK_LE(row_start + num_rows, dims[0])
+      << "Rows out of range for dataset " << dataset_name_;
+
+  std::vector<hsize_t> start(ndims, 0);
+  start[0] = row_start;
+  dims[0] = num_rows;
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+      start.data(), NULL, dims.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(ndims, dims.data(), NULL);
+  CHECK_GE(mem_space, 0) << "Failed to create memory dataspace";
+
+  vector<int> blob_dims(dims.begin(), dims.end());
+  blob->Reshape(blob_dims);
+  status = H5Dread(dataset, mem_type, mem_space, file_space, H5P_DEFAULT,
+      blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of dataset " << dataset_name_;
+
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id, const char* dataset_name_,
+    hsize_t row_start, hsize_t num_rows, Blob<float>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, row_start, num_rows,
+                                   blob, H5T_NATIVE_FLOAT);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, hsize_t row_start, hsize_t num_rows,
+    Blob<double>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, row_start, num_rows,
+                                   blob, H5T_NATIVE_DOUBLE);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
@@ -185,6 +265,11 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
     << "Failed to save int dataset with name " << dataset_name;
 }
 
+bool hdf5_is_file(const string& filename) {
+  HDF5Lock lock;
+  return H5Fis_hdf5(filename.c_str()) > 0;
+}
+
 int hdf5_get_num_links(hid_t loc_id) {
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
@@ -0,0 +1,196 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif  // __SSE2__
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/int8.hpp"
+
+namespace caffe {
+
+// The int32 sums of 127 * 127 products overflow past this many columns.
+static const int kMaxCols = INT_MAX / (127 * 127);
+// The number of input rows multiplied with each pass over the weights
+static const int kInputBlock = 64;
+// The number of input rows multiplied with each load of a weight row
+static const int kInputRows = 4;
+// The rows are padded to a multiple of this many columns.
+static const int kColAlign = 16;
+
+template <typename Dtype>
+static inline int8_t quantize(const Dtype value, const Dtype inv_scale) {
+  const Dtype q = std::floor(value * inv_scale + Dtype(0.5));
+  return static_cast<int8_t>(std::max(Dtype(-127), std::min(Dtype(127), q)));
+}
+
+// Writes to sums the dot products of the int8 weights w with the R input
+// rows from a, each stride long, where stride is a multiple of kColAlign.
+template <int R>
+static inline void dot_int8(const int16_t* a, const int8_t* w,
+    const int stride, int* sums) {
+#ifdef __SSE2__
+  __m128i acc[R];
+  for (int k = 0; k < R; ++k) {
+    acc[k] = _mm_setzero_si128();
+  }
+  for (int i = 0; i < stride; i += kColAlign) {
+    // Sign extend 16 weights to int16 once for all R rows: unpacking each
+    // byte with itself and shifting right by 8 leaves its signed value.
+    const __m128i w8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+    const __m128i w_lo = _mm_srai_epi16(_mm_unpacklo_epi8(w8, w8), 8);
+    const __m128i w_hi = _mm_srai_epi16(_mm_unpackhi_epi8(w8, w8), 8);
+    for (int k = 0; k < R; ++k) {
+      const __m128i* x = reinterpret_cast<const __m128i*>(a + k * stride + i);
+      acc[k] = _mm_add_epi32(acc[k],
+          _mm_madd_epi16(_mm_loadu_si128(x), w_lo));
+      acc[k] = _mm_add_epi32(acc[k],
+          _mm_madd_epi16(_mm_loadu_si128(x + 1), w_hi));
+    }
+  }
+  for (int k = 0; k < R; ++k) {
+    __m128i sum = acc[k];
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    sums[k] = _mm_cvtsi128_si32(sum);
+  }
+#else
+  for (int k = 0; k < R; ++k) {
+    const int16_t* x = a + k * stride;
+    int sum = 0;
+    for (int i = 0; i < stride; ++i) {
+      sum += x[i] * static_cast<int16_t>(w[i]);
+    }
+    sums[k] = sum;
+  }
+#endif  // __SSE2__
+}
+
+template <typename Dtype>
+void Int8Matrix<Dtype>::Pack(const Dtype* data, int rows, int cols,
+    bool trans) {
+  CHECK_GT(rows, 0);
+  CHECK_GT(cols, 0);
+  CHECK_LE(cols, kMaxCols) << "Too many columns for int32 accumulation";
+  rows_ = rows;
+  cols_ = cols;
+  stride_ = (cols + kColAlign - 1) / kColAlign * kColAlign;
+  values_.assign(rows * stride_, 0);
+  scales_.resize(rows);
+  // Element (i, j) of the matrix
+  const int row_stride = trans ? 1 : cols;
+  const int col_stride = trans ? rows : 1;
+  for (int i = 0; i < rows; ++i) {
+    const Dtype* row = data + i * row_stride;
+    Dtype max_abs = 0;
+    for (int j = 0; j < cols; ++j) {
+      max_abs = std::max(max_abs, std::fabs(row[j * col_stride]));
+    }
+    scales_[i] = max_abs / 127;
+    const Dtype inv_scale = max_abs > 0 ? 127 / max_abs : 0;
+    for (int j = 0; j < cols; ++j) {
+      values_[i * stride_ + j] = quantize(row[j * col_stride], inv_scale);
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8Matrix<Dtype>::Clear() {
+  rows_ = cols_ = stride_ = 0;
+  vector<int8_t>().swap(values_);
+  vector<Dtype>().swap(scales_);
+  vector<int16_t>().swap(input_);
+}
+
+template <typename Dtype>
+Dtype Int8Matrix<Dtype>::QuantizeInput(const int M, const Dtype* A,
+    const bool trans, const Dtype range) {
+  const int count = M * cols_;
+  Dtype max_abs = range;
+  if (max_abs <= 0) {
+    for (int i = 0; i < count; ++i) {
+      max_abs = std::max(max_abs, std::fabs(A[i]));
+    }
+  }
+  const Dtype inv_scale = max_abs > 0 ? 127 / max_abs : 0;
+  // The padding stays zero.
+  input_.assign(M * stride_, 0);
+  int16_t* input = &input_[0];
+  if (trans) {
+    // Read A a row at a time, to write each input column.
+    for (int j = 0; j < cols_; ++j) {
+      const Dtype* a = A + j * M;
+      for (int i = 0; i < M; ++i) {
+        input[i * stride_ + j] = quantize(a[i], inv_scale);
+      }
+    }
+  } else {
+    for (int i = 0; i < M; ++i) {
+      for (int j = 0; j < cols_; ++j) {
+        input[i * stride_ + j] = quantize(A[i * cols_ + j], inv_scale);
+      }
+    }
+  }
+  return max_abs / 127;
+}
+
+template <typename Dtype>
+void Int8Matrix<Dtype>::Multiply(const int row, const int count, const int M,
+    const Dtype input_scale, const bool trans_C, Dtype* C) const {
+  const int16_t* input = &input_[0];
+  const int8_t* values = &values_[0] + row * stride_;
+  const Dtype* scales = &scales_[0] + row;
+  for (int begin = 0; begin < M; begin += kInputBlock) {
+    const int end = std::min(M, begin + kInputBlock);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int o = 0; o < count; ++o) {
+      const int8_t* w = values + o * stride_;
+      const Dtype scale = scales[o] * input_scale;
+      for (int i = begin; i < end; i += kInputRows) {
+        const int n = std::min(kInputRows, end - i);
+        int sums[kInputRows];
+        if (n == kInputRows) {
+          dot_int8<kInputRows>(input + i * stride_, w, stride_, sums);
+        } else {
+          for (int k = 0; k < n; ++k) {
+            dot_int8<1>(input + (i + k) * stride_, w, stride_, sums + k);
+          }
+        }
+        for (int k = 0; k < n; ++k) {
+          const Dtype value = scale * sums[k];
+          if (trans_C) {
+            C[o * M + i + k] = value;
+          } else {
+            C[(i + k) * count + o] = value;
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8Matrix<Dtype>::Gemm(const int M, const Dtype* A, const Dtype range,
+    Dtype* C) {
+  CHECK(!empty());
+  const Dtype input_scale = QuantizeInput(M, A, false, range);
+  Multiply(0, rows_, M, input_scale, false, C);
+}
+
+template <typename Dtype>
+void Int8Matrix<Dtype>::GemmRows(const int row, const int count, const int N,
+    const Dtype* B, const Dtype range, Dtype* C) {
+  CHECK(!empty());
+  CHECK_GE(row, 0);
+  CHECK_LE(row + count, rows_);
+  const Dtype input_scale = QuantizeInput(N, B, true, range);
+  Multiply(row, count, N, input_scale, true, C);
+}
+
+INSTANTIATE_CLASS(Int8Matrix);
+
+}  // namespace caffe
@@ -0,0 +1,190 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/util/mapped_weights.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+static const char kMagic[8] = {'C', 'A', 'F', 'F', 'E', 'W', 'T', 'S'};
+static const uint32_t kVersion = 1;
+
+// Reads the fields of the header and the table, checking the file size.
+class TableReader {
+ public:
+  TableReader(const char* data, size_t size, const string& filename)
+      : data_(data), size_(size), pos_(0), filename_(filename) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    memcpy(&value, Advance(sizeof(value)), sizeof(value));
+    return value;
+  }
+  string ReadString(size_t length) {
+    return string(Advance(length), length);
+  }
+
+ private:
+  const char* Advance(size_t bytes) {
+    CHECK_LE(pos_ + bytes, size_) << "Truncated weights file " << filename_;
+    const char* p = data_ + pos_;
+    pos_ += bytes;
+    return p;
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t pos_;
+  const string& filename_;
+};
+
+template <typename T>
+static void Append(const T& value, string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint64_t Align(uint64_t offset) {
+  const uint64_t alignment = MappedWeights::kAlignment;
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+MappedWeights::MappedWeights(const string& filename)
+    : filename_(filename), data_(NULL), size_(0) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Couldn't open " << filename << ": " << strerror(errno);
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "fstat " << filename << ": "
+                              << strerror(errno);
+  size_ = st.st_size;
+  CHECK_GT(size_, 0) << "Empty weights file " << filename;
+  data_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(data_ != MAP_FAILED) << "mmap " << filename << ": " << strerror(errno);
+
+  char* data = static_cast<char*>(data_);
+  TableReader reader(data, size_, filename_);
+  CHECK(reader.ReadString(sizeof(kMagic)) == string(kMagic, sizeof(kMagic)))
+      << filename << " is not a weights file";
+  const uint32_t version = reader.Read<uint32_t>();
+  CHECK_EQ(version, kVersion) << "Unsupported weights file version in "
+                              << filename;
+  const uint32_t num_tensors = reader.Read<uint32_t>();
+  reader.Read<uint64_t>();  // The data offset
+  tensors_.resize(num_tensors);
+  for (int i = 0; i < num_tensors; ++i) {
+    Tensor& tensor = tensors_[i];
+    tensor.layer = reader.ReadString(reader.Read<uint32_t>());
+    tensor.index = reader.Read<uint32_t>();
+    const uint32_t num_axes = reader.Read<uint32_t>();
+    CHECK_LE(num_axes, kMaxBlobAxes) << "Bad shape in " << filename;
+    uint64_t count = 1;
+    for (int j = 0; j < num_axes; ++j) {
+      tensor.shape.push_back(reader.Read<int32_t>());
+      CHECK_GE(tensor.shape.back(), 0) << "Bad shape in " << filename;
+      count *= tensor.shape.back();
+    }
+    const uint64_t offset = reader.Read<uint64_t>();
+    CHECK_EQ(offset % kAlignment, 0) << "Unaligned data in " << filename;
+    CHECK_LE(offset + count * sizeof(float), size_)
+        << "Truncated weights file " << filename;
+    tensor.data = reinterpret_cast<float*>(data + offset);
+  }
+}
+
+MappedWeights::~MappedWeights() {
+  munmap(data_, size_);
+}
+
+bool MappedWeights::IsWeightsFile(const string& filename) {
+  std::ifstream file(filename.c_str(), std::ios::binary);
+  char magic[sizeof(kMagic)];
+  return file.read(magic, sizeof(magic)) &&
+         memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+void MappedWeights::Write(const NetParameter& param, const string& filename) {
+  vector<shared_ptr<Blob<float> > > blobs;
+  string table;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    for (int j = 0; j < layer.blobs_size(); ++j) {
+      shared_ptr<Blob<float> > blob(new Blob<float>());
+      blob->FromProto(layer.blobs(j), true);
+      blobs.push_back(blob);
+      Append<uint32_t>(layer.name().size(), &table);
+      table += layer.name();
+      Append<uint32_t>(j, &table);
+      Append<uint32_t>(blob->num_axes(), &table);
+      for (int k = 0; k < blob->num_axes(); ++k) {
+        Append<int32_t>(blob->shape(k), &table);
+      }
+      Append<uint64_t>(0, &table);  // The offset, set below
+    }
+  }
+  // Fill in the offsets, now that the size of the table is known.
+  string header(kMagic, sizeof(kMagic));
+  Append<uint32_t>(kVersion, &header);
+  Append<uint32_t>(blobs.size(), &header);
+  const uint64_t data_offset =
+      Align(header.size() + sizeof(uint64_t) + table.size());
+  Append<uint64_t>(data_offset, &header);
+  vector<uint64_t> offsets;
+  uint64_t offset = data_offset;
+  size_t pos = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    uint32_t length;
+    memcpy(&length, &table[pos], sizeof(length));
+    pos += sizeof(length) + length + 2 * sizeof(uint32_t) +
+           blobs[i]->num_axes() * sizeof(int32_t);
+    memcpy(&table[pos], &offset, sizeof(offset));
+    pos += sizeof(offset);
+    offsets.push_back(offset);
+    offset = Align(offset + blobs[i]->count() * sizeof(float));
+  }
+  std::ofstream file(filename.c_str(), std::ios::binary | std::ios::trunc);
+  CHECK(file) << "Couldn't open " << filename;
+  file.write(header.data(), header.size());
+  file.write(table.data(), table.size());
+  for (int i = 0; i < blobs.size(); ++i) {
+    const uint64_t position = file.tellp();
+    const string padding(offsets[i] - position, '\0');
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(blobs[i]->cpu_data()),
+               blobs[i]->count() * sizeof(float));
+  }
+  CHECK(file) << "Error writing " << filename;
+}
+
+template <>
+void load_mapped_tensor(const MappedWeights::Tensor& tensor, bool share,
+    Blob<float>* blob) {
+  CHECK(blob->shape() == tensor.shape);
+  if (share) {
+    blob->set_cpu_data(tensor.data);
+  } else {
+    caffe_copy(blob->count(), tensor.data, blob->mutable_cpu_data());
+  }
+}
+
+template <>
+void load_mapped_tensor(const MappedWeights::Tensor& tensor, bool share,
+    Blob<double>* blob) {
+  CHECK(blob->shape() == tensor.shape);
+  double* data = blob->mutable_cpu_data();
+  for (int i = 0; i < blob->count(); ++i) {
+    data[i] = tensor.data[i];
+  }
+}
+
+}  // namespace caffe
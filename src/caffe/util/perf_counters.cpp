@@ -0,0 +1,110 @@
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <boost/thread/tss.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include "caffe/util/perf_counters.hpp"
+
+namespace caffe {
+
+PerfCounters::PerfCounters() : leader_(-1) {
+  for (int i = 0; i < NUM_EVENTS; ++i) {
+    fds_[i] = -1;
+  }
+#ifdef __linux__
+  const uint64_t configs[NUM_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES,
+      PERF_COUNT_HW_CACHE_MISSES};
+  int error = 0;
+  for (int i = 0; i < NUM_EVENTS; ++i) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    // The group starts once all its events are opened.
+    attr.disabled = leader_ < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // The calling thread, on any CPU
+    fds_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, leader_, 0);
+    if (fds_[i] < 0) {
+      error = errno;
+    } else if (leader_ < 0) {
+      leader_ = fds_[i];
+    }
+  }
+  if (leader_ >= 0) {
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+  LOG_IF(INFO, error) << "Some hardware counters are unavailable: "
+      << strerror(error);
+#else
+  LOG(INFO) << "Hardware counters are only available on Linux.";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  // The leader goes last, as closing it first would split the group.
+  for (int i = NUM_EVENTS - 1; i >= 0; --i) {
+    if (fds_[i] >= 0 && fds_[i] != leader_) {
+      close(fds_[i]);
+    }
+  }
+  if (leader_ >= 0) {
+    close(leader_);
+  }
+#endif
+}
+
+PerfCounters* PerfCounters::ForThread() {
+  // Never deleted, like the counters of threads still running at exit.
+  static boost::thread_specific_ptr<PerfCounters>* counters =
+      new boost::thread_specific_ptr<PerfCounters>();
+  if (!counters->get()) {
+    counters->reset(new PerfCounters());
+  }
+  return counters->get();
+}
+
+const char* PerfCounters::name(int event) {
+  const char* names[NUM_EVENTS] = {"cycles", "instructions",
+      "cache_references", "cache_misses"};
+  CHECK_GE(event, 0);
+  CHECK_LT(event, NUM_EVENTS);
+  return names[event];
+}
+
+void PerfCounters::Read(int64_t* counts) const {
+  for (int i = 0; i < NUM_EVENTS; ++i) {
+    counts[i] = -1;
+  }
+#ifdef __linux__
+  if (leader_ < 0) {
+    return;
+  }
+  // The number of events, then the count of each in the order opened
+  uint64_t values[NUM_EVENTS + 1];
+  const ssize_t size = read(leader_, values, sizeof(values));
+  if (size < static_cast<ssize_t>(sizeof(uint64_t))) {
+    return;
+  }
+  const int num = values[0];
+  for (int i = 0, j = 1; i < NUM_EVENTS && j <= num; ++i) {
+    if (fds_[i] >= 0) {
+      counts[i] = values[j++];
+    }
+  }
+#endif
+}
+
+}  // namespace caffe
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "caffe/util/profiler.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Writes s as a JSON string.
+void WriteString(const string& s, std::ostream* os) {
+  *os << '"';
+  for (int i = 0; i < s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      *os << '\\' << c;
+    } else if (c < 0x20) {
+      *os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec << std::setfill(' ');
+    } else {
+      *os << c;
+    }
+  }
+  *os << '"';
+}
+
+template <typename Stats>
+void WriteStats(const Stats& stats, std::ostream* os) {
+  *os << "{\"count\": " << stats.count << ", \"mean_ms\": " << stats.mean
+      << ", \"min_ms\": " << stats.min << ", \"median_ms\": " << stats.median
+      << ", \"p99_ms\": " << stats.p99 << "}";
+}
+
+template <typename Dtype>
+int64_t TotalCount(const vector<Blob<Dtype>*>& blobs) {
+  int64_t count = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    count += blobs[i]->count();
+  }
+  return count;
+}
+
+}  // namespace
+
+template <typename Dtype>
+NetProfiler<Dtype>::NetProfiler(const Net<Dtype>& net)
+    : net_(net), start_(boost::posix_time::microsec_clock::local_time()),
+      forward_times_(net.layers().size()),
+      backward_times_(net.layers().size()),
+      forward_counts_(net.layers().size(),
+                      vector<int64_t>(PerfCounters::NUM_EVENTS, 0)),
+      backward_counts_(forward_counts_),
+      forward_counted_(net.layers().size(), 0),
+      backward_counted_(net.layers().size(), 0) {
+  Estimate();
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::Now() const {
+  return (boost::posix_time::microsec_clock::local_time() - start_)
+      .total_microseconds();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::AddLayer(int layer, bool backward, double start,
+    double duration) {
+  CHECK_GE(layer, 0);
+  CHECK_LT(layer, forward_times_.size());
+  (backward ? backward_times_ : forward_times_)[layer].push_back(duration);
+  Event event = {layer, backward, static_cast<float>(start),
+                 static_cast<float>(duration)};
+  events_.push_back(event);
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::AddPass(bool backward, double start,
+    double duration) {
+  (backward ? backward_pass_times_ : forward_pass_times_).push_back(duration);
+  Event event = {-1, backward, static_cast<float>(start),
+                 static_cast<float>(duration)};
+  events_.push_back(event);
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::AddCounts(int layer, bool backward,
+    const int64_t* counts) {
+  CHECK_GE(layer, 0);
+  CHECK_LT(layer, forward_counts_.size());
+  vector<int64_t>& sums = (backward ? backward_counts_ : forward_counts_)[layer];
+  for (int i = 0; i < PerfCounters::NUM_EVENTS; ++i) {
+    sums[i] = (sums[i] < 0 || counts[i] < 0) ? -1 : sums[i] + counts[i];
+  }
+  ++(backward ? backward_counted_ : forward_counted_)[layer];
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::MeanCount(int layer, bool backward,
+    int event) const {
+  const int64_t sum =
+      (backward ? backward_counts_ : forward_counts_)[layer][event];
+  const int counted = (backward ? backward_counted_ : forward_counted_)[layer];
+  return (counted == 0 || sum < 0) ? -1 : static_cast<double>(sum) / counted;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Estimate() {
+  costs_.clear();
+  for (int i = 0; i < net_.layers().size(); ++i) {
+    costs_.push_back(EstimateCost(net_.layers()[i].get(),
+                                  net_.bottom_vecs()[i], net_.top_vecs()[i]));
+  }
+}
+
+template <typename Dtype>
+typename NetProfiler<Dtype>::Stats NetProfiler<Dtype>::Summarize(
+    const vector<float>& times) {
+  Stats stats = {static_cast<int>(times.size()), 0, 0, 0, 0};
+  if (times.empty()) {
+    return stats;
+  }
+  vector<float> sorted(times);
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0;
+  for (int i = 0; i < sorted.size(); ++i) {
+    sum += sorted[i];
+  }
+  const int n = sorted.size();
+  stats.mean = sum / n / 1000;
+  stats.min = sorted[0] / 1000;
+  stats.median = sorted[(n + 1) / 2 - 1] / 1000;
+  stats.p99 = sorted[std::max(0, static_cast<int>(std::ceil(0.99 * n)) - 1)]
+      / 1000;
+  return stats;
+}
+
+template <typename Dtype>
+typename NetProfiler<Dtype>::Stats NetProfiler<Dtype>::LayerStats(int layer,
+    bool backward) const {
+  return Summarize((backward ? backward_times_ : forward_times_)[layer]);
+}
+
+template <typename Dtype>
+typename NetProfiler<Dtype>::Stats NetProfiler<Dtype>::PassStats(
+    bool backward) const {
+  return Summarize(backward ? backward_pass_times_ : forward_pass_times_);
+}
+
+template <typename Dtype>
+typename NetProfiler<Dtype>::Cost NetProfiler<Dtype>::EstimateCost(
+    Layer<Dtype>* layer, const vector<Blob<Dtype>*>& bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const LayerParameter& param = layer->layer_param();
+  const string type = layer->type();
+  const vector<shared_ptr<Blob<Dtype> > >& blobs = layer->blobs();
+  const int64_t bottom_count = TotalCount(bottom);
+  const int64_t top_count = TotalCount(top);
+  int64_t param_count = 0;
+  for (int i = 0; i < blobs.size(); ++i) {
+    param_count += blobs[i]->count();
+  }
+  Cost cost;
+  // By default, a FLOP for each element the layer reads or writes
+  cost.forward_flops = std::max(bottom_count, top_count);
+  cost.backward_flops = cost.forward_flops;
+  if ((type == "Convolution" || type == "Deconvolution") && blobs.size()) {
+    // Each output (input for a deconvolution) multiplies a kernel.
+    const int64_t kernel = blobs[0]->count() / blobs[0]->shape(0);
+    const int64_t outputs = (type == "Convolution" ? top_count : bottom_count);
+    cost.forward_flops = 2 * outputs * kernel;
+    if (blobs.size() > 1) {
+      cost.forward_flops += top_count;
+    }
+    // The gradients of both the bottoms and the weights
+    cost.backward_flops = 2 * cost.forward_flops;
+  } else if (type == "InnerProduct" && blobs.size()) {
+    const int64_t inputs =
+        blobs[0]->count() / param.inner_product_param().num_output();
+    cost.forward_flops = 2 * top_count * inputs;
+    if (blobs.size() > 1) {
+      cost.forward_flops += top_count;
+    }
+    cost.backward_flops = 2 * cost.forward_flops;
+  } else if (type == "Pooling" && bottom.size() && bottom[0]->num_axes() == 4) {
+    const PoolingParameter& pool_param = param.pooling_param();
+    int64_t window = bottom[0]->height() * bottom[0]->width();
+    if (!pool_param.global_pooling()) {
+      window = pool_param.has_kernel_h() ?
+          pool_param.kernel_h() * pool_param.kernel_w() :
+          pool_param.kernel_size() * pool_param.kernel_size();
+    }
+    cost.forward_flops = top_count * window;
+    cost.backward_flops = cost.forward_flops;
+  } else if (type == "LRN") {
+    const LRNParameter& lrn_param = param.lrn_param();
+    int64_t window = lrn_param.local_size();
+    if (lrn_param.norm_region() == LRNParameter_NormRegion_WITHIN_CHANNEL) {
+      window *= lrn_param.local_size();
+    }
+    cost.forward_flops = top_count * (window + 2);
+    cost.backward_flops = 2 * cost.forward_flops;
+  }
+  const int64_t size = sizeof(Dtype);
+  cost.forward_bytes = (bottom_count + top_count + param_count) * size;
+  // Reads the top diffs and bottom data, and writes the bottom and param
+  // diffs
+  cost.backward_bytes = (top_count + 2 * bottom_count + 2 * param_count)
+      * size;
+  cost.allocated_bytes = 0;
+  for (int i = 0; i < top.size(); ++i) {
+    if (std::find(bottom.begin(), bottom.end(), top[i]) != bottom.end()) {
+      continue;
+    }
+    const shared_ptr<SyncedMemory> memory[] = {top[i]->data(),
+                                               top[i]->diff()};
+    for (int j = 0; j < 2; ++j) {
+      if (memory[j] && memory[j]->head() != SyncedMemory::UNINITIALIZED) {
+        cost.allocated_bytes += memory[j]->size();
+      }
+    }
+  }
+  cost.allocated_bytes += param_count * size;
+  return cost;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Log() const {
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_.layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    for (int backward = 0; backward < 2; ++backward) {
+      const Stats stats = LayerStats(i, backward);
+      if (stats.count == 0) {
+        continue;
+      }
+      const int64_t flops = backward ?
+          costs_[i].backward_flops : costs_[i].forward_flops;
+      const int64_t bytes = backward ?
+          costs_[i].backward_bytes : costs_[i].forward_bytes;
+      // Per ms, 1e-6 G/s
+      const double rate = stats.median > 0 ? 1e-6 / stats.median : 0;
+      std::ostringstream counted;
+      const double cycles = MeanCount(i, backward, PerfCounters::CYCLES);
+      const double instructions =
+          MeanCount(i, backward, PerfCounters::INSTRUCTIONS);
+      const double references =
+          MeanCount(i, backward, PerfCounters::CACHE_REFERENCES);
+      const double misses = MeanCount(i, backward, PerfCounters::CACHE_MISSES);
+      if (cycles > 0) {
+        counted << ", " << flops / cycles << " FLOP/cycle";
+        if (instructions >= 0) {
+          counted << ", IPC " << instructions / cycles;
+        }
+      }
+      if (references > 0 && misses >= 0) {
+        counted << ", " << 100 * misses / references << "% LLC misses";
+      }
+      LOG(INFO) << std::setfill(' ') << std::setw(10)
+          << layers[i]->layer_param().name()
+          << (backward ? "\tbackward: " : "\tforward: ")
+          << "median " << stats.median << " ms, min " << stats.min
+          << " ms, p99 " << stats.p99 << " ms, " << flops * rate
+          << " GFLOP/s, " << bytes * rate << " GB/s" << counted.str() << ".";
+    }
+  }
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteJSON(std::ostream* os) const {
+  const vector<shared_ptr<Layer<Dtype> > >& layers = net_.layers();
+  *os << "{\n  \"net\": ";
+  WriteString(net_.name(), os);
+  *os << ",\n  \"phase\": \"" << (net_.phase() == TRAIN ? "TRAIN" : "TEST")
+      << "\",\n  \"forward\": ";
+  WriteStats(PassStats(false), os);
+  *os << ",\n  \"backward\": ";
+  WriteStats(PassStats(true), os);
+  *os << ",\n  \"layers\": [";
+  for (int i = 0; i < layers.size(); ++i) {
+    const Cost& cost = costs_[i];
+    *os << (i ? "," : "") << "\n    {\"name\": ";
+    WriteString(layers[i]->layer_param().name(), os);
+    *os << ", \"type\": ";
+    WriteString(layers[i]->type(), os);
+    *os << ",\n     \"top_shapes\": [";
+    const vector<Blob<Dtype>*>& top = net_.top_vecs()[i];
+    for (int j = 0; j < top.size(); ++j) {
+      *os << (j ? ", " : "") << "[";
+      for (int k = 0; k < top[j]->num_axes(); ++k) {
+        *os << (k ? ", " : "") << top[j]->shape(k);
+      }
+      *os << "]";
+    }
+    *os << "],\n     \"forward\": ";
+    WriteStats(LayerStats(i, false), os);
+    *os << ",\n     \"backward\": ";
+    WriteStats(LayerStats(i, true), os);
+    *os << ",\n     \"forward_flops\": " << cost.forward_flops
+        << ", \"backward_flops\": " << cost.backward_flops
+        << ",\n     \"forward_bytes\": " << cost.forward_bytes
+        << ", \"backward_bytes\": " << cost.backward_bytes
+        << ", \"allocated_bytes\": " << cost.allocated_bytes;
+    // The mean counts of the events counted
+    for (int backward = 0; backward < 2; ++backward) {
+      *os << ",\n     \"" << (backward ? "backward" : "forward")
+          << "_counts\": {";
+      for (int e = 0, written = 0; e < PerfCounters::NUM_EVENTS; ++e) {
+        const double count = MeanCount(i, backward, e);
+        if (count >= 0) {
+          *os << (written++ ? ", " : "") << "\"" << PerfCounters::name(e)
+              << "\": " << count;
+        }
+      }
+      *os << "}";
+    }
+    *os << "}";
+  }
+  *os << "\n  ]\n}\n";
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteTrace(std::ostream* os) const {
+  *os << "{\"traceEvents\": [";
+  for (int i = 0; i < events_.size(); ++i) {
+    const Event& event = events_[i];
+    *os << (i ? "," : "") << "\n  {\"name\": ";
+    if (event.layer < 0) {
+      WriteString(event.backward ? "Backward" : "Forward", os);
+      *os << ", \"cat\": \"net\"";
+    } else {
+      const Layer<Dtype>& layer = *net_.layers()[event.layer];
+      WriteString(layer.layer_param().name(), os);
+      *os << ", \"cat\": \"" << (event.backward ? "backward" : "forward")
+          << "\", \"args\": {\"type\": ";
+      WriteString(layer.type(), os);
+      *os << "}";
+    }
+    *os << ", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": "
+        << std::fixed << std::setprecision(1) << event.start
+        << ", \"dur\": " << event.duration << "}";
+    os->unsetf(std::ios_base::floatfield);
+    *os << std::setprecision(6);
+  }
+  *os << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
+
+INSTANTIATE_CLASS(NetProfiler);
+
+}  // namespace caffe
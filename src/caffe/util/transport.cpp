@@ -0,0 +1,260 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/transport.hpp"
+
+namespace caffe {
+
+// A parsed "tcp://host:port" or "unix:///path" address.
+struct SocketAddress {
+  explicit SocketAddress(const string& address) : tcp(false) {
+    const string tcp_prefix = "tcp://";
+    const string unix_prefix = "unix://";
+    if (address.compare(0, tcp_prefix.size(), tcp_prefix) == 0) {
+      tcp = true;
+      const string host_port = address.substr(tcp_prefix.size());
+      const size_t colon = host_port.rfind(':');
+      CHECK_NE(colon, string::npos) << "No port in address " << address;
+      host = host_port.substr(0, colon);
+      port = host_port.substr(colon + 1);
+    } else if (address.compare(0, unix_prefix.size(), unix_prefix) == 0) {
+      path = address.substr(unix_prefix.size());
+      CHECK_LT(path.size(), sizeof(sockaddr_un().sun_path))
+          << "Socket path too long: " << path;
+    } else {
+      LOG(FATAL) << "Unknown transport address " << address
+                 << ", expected tcp://host:port or unix:///path";
+    }
+  }
+
+  // Opens a socket for this address, and passes it with the address to f
+  // (bind or connect). Returns the socket, or -1 if f failed.
+  template <typename F>
+  int Open(F f) const {
+    if (!tcp) {
+      sockaddr_un addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      CHECK_GE(fd, 0) << "socket: " << strerror(errno);
+      if (f(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+      }
+      return fd;
+    }
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* infos;
+    const int error = getaddrinfo(host.empty() ? NULL : host.c_str(),
+                                  port.c_str(), &hints, &infos);
+    CHECK_EQ(error, 0) << "getaddrinfo " << host << ": "
+                       << gai_strerror(error);
+    int fd = -1;
+    for (addrinfo* info = infos; info && fd < 0; info = info->ai_next) {
+      fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+      CHECK_GE(fd, 0) << "socket: " << strerror(errno);
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (f(fd, info->ai_addr, info->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+      }
+    }
+    freeaddrinfo(infos);
+    return fd;
+  }
+
+  bool tcp;
+  string host, port, path;
+};
+
+static void set_nonblocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  CHECK_EQ(fcntl(fd, F_SETFL, flags | O_NONBLOCK), 0)
+      << "fcntl: " << strerror(errno);
+}
+
+SocketTransport::SocketTransport(const vector<string>& addresses, int rank)
+    : Transport(rank, addresses.size()), next_(-1), prev_(-1) {
+  CHECK_GE(rank, 0);
+  CHECK_LT(rank, size_);
+  if (size_ == 1) {
+    return;
+  }
+  address_ = addresses[rank];
+  const SocketAddress own(address_);
+  const SocketAddress next(addresses[(rank + 1) % size_]);
+  if (!own.tcp) {
+    unlink(own.path.c_str());
+  }
+  const int listener = own.Open(::bind);
+  CHECK_GE(listener, 0) << "Cannot bind " << address_ << ": "
+                        << strerror(errno);
+  CHECK_EQ(listen(listener, 1), 0) << "listen: " << strerror(errno);
+  // The next process may not be listening yet.
+  for (int attempt = 0; attempt < 600 && next_ < 0; ++attempt) {
+    next_ = next.Open(::connect);
+    if (next_ < 0) {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    }
+  }
+  CHECK_GE(next_, 0) << "Cannot connect to " << addresses[(rank + 1) % size_];
+  prev_ = accept(listener, NULL, NULL);
+  CHECK_GE(prev_, 0) << "accept: " << strerror(errno);
+  close(listener);
+  if (!own.tcp) {
+    unlink(own.path.c_str());
+  }
+  set_nonblocking(next_);
+  set_nonblocking(prev_);
+  LOG(INFO) << "Transport rank " << rank << " of " << size_ << " connected";
+}
+
+SocketTransport::~SocketTransport() {
+  if (next_ >= 0) {
+    close(next_);
+  }
+  if (prev_ >= 0) {
+    close(prev_);
+  }
+}
+
+void SocketTransport::SendRecv(const void* send, size_t send_bytes,
+                               void* recv, size_t recv_bytes) {
+  const char* send_ptr = static_cast<const char*>(send);
+  char* recv_ptr = static_cast<char*>(recv);
+  size_t sent = 0;
+  size_t received = 0;
+  while (sent < send_bytes || received < recv_bytes) {
+    pollfd fds[2];
+    int nfds = 0;
+    if (sent < send_bytes) {
+      fds[nfds].fd = next_;
+      fds[nfds].events = POLLOUT;
+      fds[nfds++].revents = 0;
+    }
+    if (received < recv_bytes) {
+      fds[nfds].fd = prev_;
+      fds[nfds].events = POLLIN;
+      fds[nfds++].revents = 0;
+    }
+    if (poll(fds, nfds, -1) < 0) {
+      CHECK_EQ(errno, EINTR) << "poll: " << strerror(errno);
+      continue;
+    }
+    for (int i = 0; i < nfds; ++i) {
+      if (!fds[i].revents) {
+        continue;
+      }
+      if (fds[i].fd == next_) {
+        const ssize_t n = ::send(next_, send_ptr + sent, send_bytes - sent,
+                                 MSG_NOSIGNAL);
+        if (n < 0) {
+          CHECK(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+              << "send: " << strerror(errno);
+        } else {
+          sent += n;
+        }
+      } else {
+        const ssize_t n = ::recv(prev_, recv_ptr + received,
+                                 recv_bytes - received, 0);
+        CHECK_NE(n, 0) << "Transport connection closed";
+        if (n < 0) {
+          CHECK(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+              << "recv: " << strerror(errno);
+        } else {
+          received += n;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void ring_allreduce(Transport* transport, Dtype* data, size_t count,
+                    vector<Dtype>* buffer) {
+  const int size = transport->size();
+  const int rank = transport->rank();
+  if (size == 1) {
+    return;
+  }
+  // Chunk i of the data is [begin[i], begin[i + 1]).
+  vector<size_t> begin(size + 1);
+  for (int i = 0; i <= size; ++i) {
+    begin[i] = count * i / size;
+  }
+  // Keeps the capacity of the buffer, chunks are at most begin[1] + 1 long
+  vector<Dtype>& received = *buffer;
+  if (received.size() < begin[1] + 1) {
+    received.resize(begin[1] + 1);
+  }
+  // Reduce-scatter: at step s, add the previous process's partial sum of
+  // chunk rank - s - 1 to ours. Chunk rank + 1 ends up complete here.
+  for (int s = 0; s < size - 1; ++s) {
+    const int send_chunk = (rank - s + size) % size;
+    const int recv_chunk = (rank - s - 1 + size) % size;
+    const size_t recv_count = begin[recv_chunk + 1] - begin[recv_chunk];
+    transport->SendRecv(data + begin[send_chunk],
+        (begin[send_chunk + 1] - begin[send_chunk]) * sizeof(Dtype),
+        &received[0], recv_count * sizeof(Dtype));
+    caffe_axpy(static_cast<int>(recv_count), Dtype(1), &received[0],
+               data + begin[recv_chunk]);
+  }
+  // All-gather: pass the complete chunks around the ring.
+  for (int s = 0; s < size - 1; ++s) {
+    const int send_chunk = (rank + 1 - s + size) % size;
+    const int recv_chunk = (rank - s + size) % size;
+    transport->SendRecv(data + begin[send_chunk],
+        (begin[send_chunk + 1] - begin[send_chunk]) * sizeof(Dtype),
+        data + begin[recv_chunk],
+        (begin[recv_chunk + 1] - begin[recv_chunk]) * sizeof(Dtype));
+  }
+}
+
+template <typename Dtype>
+void ring_broadcast(Transport* transport, Dtype* data, size_t count) {
+  const int size = transport->size();
+  const int rank = transport->rank();
+  // Pipeline chunks down the ring, from rank 0 to rank size - 1.
+  const size_t chunk = 1 << 20;
+  for (size_t offset = 0; size > 1 && offset < count; offset += chunk) {
+    const size_t bytes = std::min(chunk, count - offset) * sizeof(Dtype);
+    if (rank > 0) {
+      transport->SendRecv(NULL, 0, data + offset, bytes);
+    }
+    if (rank < size - 1) {
+      transport->SendRecv(data + offset, bytes, NULL, 0);
+    }
+  }
+}
+
+template void ring_allreduce<float>(Transport* transport, float* data,
+    size_t count, vector<float>* buffer);
+template void ring_allreduce<double>(Transport* transport, double* data,
+    size_t count, vector<double>* buffer);
+template void ring_broadcast<float>(Transport* transport, float* data,
+    size_t count);
+template void ring_broadcast<double>(Transport* transport, double* data,
+    size_t count);
+
+}  // namespace caffe
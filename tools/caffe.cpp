@@ -6,13 +6,28 @@ namespace bp = boost::python;
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
 #include <map>
 #include <string>
 #include <vector>
 
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#endif  // USE_OPENCV
+
 #include "boost/algorithm/string.hpp"
+#include "boost/thread.hpp"
 #include "caffe/caffe.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/perf_counters.hpp"
+#include "caffe/util/profiler.hpp"
 #include "caffe/util/signal_handler.h"
 
 using caffe::Blob;
@@ -30,6 +45,16 @@ DEFINE_string(gpu, "",
     "Optional; run in GPU mode on given device IDs separated by ','."
     "Use '-gpu all' to run on all available GPUs. The effective training "
     "batch size is multiplied by the number of devices.");
+DEFINE_int32(threads, 1,
+    "Optional; train on this many CPU solvers running in threads, each on "
+    "its share of the data. The effective training batch size is multiplied "
+    "by the number of threads.");
+DEFINE_string(ring, "",
+    "Optional; train in several processes, connected in a ring through the "
+    "given addresses separated by ',' (tcp://host:port or unix:///path). "
+    "Each process is started with the same list and its own -rank.");
+DEFINE_int32(rank, 0,
+    "Optional; the position of this process in -ring.");
 DEFINE_string(solver, "",
     "The solver definition protocol buffer text file.");
 DEFINE_string(model, "",
@@ -54,6 +79,33 @@ DEFINE_string(sigint_effect, "stop",
 DEFINE_string(sighup_effect, "snapshot",
              "Optional; action to take when a SIGHUP signal is received: "
              "snapshot, stop or none.");
+DEFINE_string(output, "",
+    "Optional; the model definition written by 'calibrate'.");
+DEFINE_bool(prefetch_stats, false,
+    "Optional; print the prefetching stats of the data layers at each "
+    "display interval when training.");
+DEFINE_string(profile, "",
+    "Optional; the JSON file written by 'time' with the time distribution, "
+    "FLOPs and bytes of each layer.");
+DEFINE_string(trace, "",
+    "Optional; the Chrome trace (chrome://tracing) written by 'time' of "
+    "each layer run.");
+DEFINE_bool(perf_counters, false,
+    "Optional; count the cycles, instructions and cache misses of each "
+    "layer in 'time' with perf_event_open, where the system allows it.");
+DEFINE_string(images, "",
+    "The image files run through the model by 'bench_detect', one per line.");
+DEFINE_int32(replicas, 1,
+    "Optional; the copies of the net that 'bench_detect' runs, each on its "
+    "own thread, sharing the weights.");
+DEFINE_int32(batch_size, 1,
+    "Optional; the images that 'bench_detect' runs each replica on at once.");
+DEFINE_int32(omp_threads, 0,
+    "Optional; the OpenMP threads of each replica of 'bench_detect', or 0 "
+    "for the default.");
+DEFINE_string(mean_value, "104,117,123",
+    "Optional; the channel means that 'bench_detect' subtracts from the "
+    "images, separated by ','.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -176,6 +228,44 @@ caffe::SolverAction::Enum GetRequestedAction(
   LOG(FATAL) << "Invalid signal effect \""<< flag_value << "\" was specified";
 }
 
+// Logs the PrefetchStats of the train net's data layers at each display
+// interval, then starts them afresh for the next one.
+class PrefetchStatsPrinter : public Solver<float>::Callback {
+ public:
+  explicit PrefetchStatsPrinter(Solver<float>* solver) : solver_(solver) {}
+
+ protected:
+  void on_start() {}
+  void on_gradients_ready() {
+    const int display = solver_->param().display();
+    if (!display || solver_->iter() % display != 0) {
+      return;
+    }
+    vector<caffe::BasePrefetchingDataLayer<float>*> layers =
+        solver_->net()->prefetching_layers();
+    for (int i = 0; i < layers.size(); ++i) {
+      const caffe::PrefetchStats& stats = layers[i]->prefetch_stats();
+      const int batches = std::max(stats.forwards, 1);
+      ostringstream occupancy;
+      for (int k = 0; k < stats.occupancy.size(); ++k) {
+        occupancy << " " << stats.occupancy[k];
+      }
+      LOG(INFO) << "    Prefetch " << layers[i]->layer_param().name()
+          << ": waited " << stats.waits << "/" << stats.forwards
+          << " forwards, " << stats.wait_time / batches
+          << " ms/forward (max " << stats.max_wait_time << " ms)";
+      LOG(INFO) << "    Prefetch " << layers[i]->layer_param().name()
+          << ": load " << stats.load_time / batches << " ms/batch (read "
+          << stats.read_time / batches << " ms, transform "
+          << stats.trans_time / batches << " ms), batches ready"
+          << occupancy.str();
+      layers[i]->ResetPrefetchStats();
+    }
+  }
+
+  Solver<float>* solver_;
+};
+
 // Train / Finetune a model.
 int train() {
   CHECK_GT(FLAGS_solver.size(), 0) << "Need a solver definition to train.";
@@ -207,10 +297,27 @@ int train() {
 
   vector<int> gpus;
   get_gpus(&gpus);
+  CHECK_GE(FLAGS_threads, 1) << "Need at least one thread.";
+  vector<string> ring;
+  if (FLAGS_ring.size()) {
+    boost::split(ring, FLAGS_ring, boost::is_any_of(","));
+  }
   if (gpus.size() == 0) {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    if (ring.size() > 0) {
+      CHECK_EQ(FLAGS_threads, 1) << "Use either solver threads or a ring.";
+      LOG(INFO) << "Process " << FLAGS_rank << " of a ring of " << ring.size();
+      Caffe::set_solver_count(ring.size());
+      Caffe::set_solver_rank(FLAGS_rank);
+      Caffe::set_multiprocess(true);
+    } else if (FLAGS_threads > 1) {
+      LOG(INFO) << "Using " << FLAGS_threads << " solver threads";
+      Caffe::set_solver_count(FLAGS_threads);
+    }
   } else {
+    CHECK_EQ(ring.size(), 0) << "Rings are only for CPU training.";
+    CHECK_EQ(FLAGS_threads, 1) << "Solver threads are only for CPU training.";
     ostringstream s;
     for (int i = 0; i < gpus.size(); ++i) {
       s << (i ? ", " : "") << gpus[i];
@@ -238,6 +345,11 @@ int train() {
 
   solver->SetActionFunction(signal_handler.GetActionFunction());
 
+  PrefetchStatsPrinter prefetch_stats_printer(solver.get());
+  if (FLAGS_prefetch_stats) {
+    solver->add_callback(&prefetch_stats_printer);
+  }
+
   if (FLAGS_snapshot.size()) {
     LOG(INFO) << "Resuming from " << FLAGS_snapshot;
     solver->Restore(FLAGS_snapshot.c_str());
@@ -253,6 +365,14 @@ int train() {
 #else
     LOG(FATAL) << "Multi-GPU execution not available - rebuild with USE_NCCL";
 #endif
+  } else if (ring.size() > 0) {
+    shared_ptr<caffe::Transport> transport(
+        new caffe::SocketTransport(ring, FLAGS_rank));
+    caffe::RingSync<float> sync(solver, transport);
+    sync.Run();
+  } else if (FLAGS_threads > 1) {
+    caffe::CPUSync<float> sync(solver);
+    sync.Run(FLAGS_snapshot.size() > 0 ? FLAGS_snapshot.c_str() : NULL);
   } else {
     solver->Solve();
   }
@@ -335,6 +455,81 @@ int test() {
 RegisterBrewFunction(test);
 
 
+// Calibrate: record the input ranges of the Convolution and InnerProduct
+// layers of a model over a sample of its TEST data, and write its definition
+// with these layers quantized to int8. Layers that already set a
+// weight_precision keep it.
+int calibrate() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to calibrate.";
+  CHECK_GT(FLAGS_weights.size(), 0) << "Need model weights to calibrate.";
+  CHECK_GT(FLAGS_output.size(), 0) << "Need an output model definition.";
+  vector<string> stages = get_stages_from_flags();
+  Caffe::set_mode(Caffe::CPU);
+
+  caffe::NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  // Record the ranges of the float layers. Memory optimization would let
+  // later layers overwrite the inputs before they are read, so it is off.
+  caffe::NetParameter float_param(param);
+  for (int i = 0; i < float_param.layer_size(); ++i) {
+    float_param.mutable_layer(i)->clear_weight_precision();
+  }
+  float_param.clear_mem_param();
+  float_param.mutable_state()->set_phase(caffe::TEST);
+  float_param.mutable_state()->set_level(FLAGS_level);
+  for (int i = 0; i < stages.size(); ++i) {
+    float_param.mutable_state()->add_stage(stages[i]);
+  }
+  Net<float> caffe_net(float_param);
+  caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
+
+  std::map<string, float> ranges;
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    // Run a layer at a time to read the inputs of each layer just before it
+    // runs, before any in-place layer after it changes them.
+    for (int i = 0; i < caffe_net.layers().size(); ++i) {
+      const string type = caffe_net.layers()[i]->type();
+      if (type == "Convolution" || type == "InnerProduct") {
+        float& range = ranges[caffe_net.layer_names()[i]];
+        const vector<Blob<float>*>& bottom = caffe_net.bottom_vecs()[i];
+        for (int j = 0; j < bottom.size(); ++j) {
+          const float* data = bottom[j]->cpu_data();
+          for (int k = 0; k < bottom[j]->count(); ++k) {
+            range = std::max(range, std::fabs(data[k]));
+          }
+        }
+      }
+      caffe_net.ForwardFromTo(i, i);
+    }
+  }
+  for (int i = 0; i < param.layer_size(); ++i) {
+    caffe::LayerParameter* layer_param = param.mutable_layer(i);
+    if (!ranges.count(layer_param->name())) {
+      continue;
+    }
+    const float range = ranges[layer_param->name()];
+    layer_param->mutable_quantization_param()->set_input_range(range);
+    if (!layer_param->has_weight_precision()) {
+      layer_param->set_weight_precision(caffe::LayerParameter_Precision_INT8);
+    }
+    LOG(INFO) << layer_param->name() << " input range " << range;
+  }
+  caffe::WriteProtoToTextFile(param, FLAGS_output);
+  LOG(INFO) << "Wrote " << FLAGS_output;
+  return 0;
+}
+RegisterBrewFunction(calibrate);
+
+
+// Subtracts the event counts at the start of a layer from those at its end,
+// keeping -1 for the events not counted.
+static void SubtractCounts(const int64_t* start, int64_t* counts) {
+  for (int i = 0; i < caffe::PerfCounters::NUM_EVENTS; ++i) {
+    counts[i] = start[i] >= 0 ? counts[i] - start[i] : -1;
+  }
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
@@ -354,6 +549,9 @@ int time() {
   }
   // Instantiate the caffe net.
   Net<float> caffe_net(FLAGS_model, phase, FLAGS_level, &stages);
+  if (FLAGS_weights.size()) {
+    caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
 
   // Do a clean forward and backward pass, so that memory allocation are done
   // and future iterations will be more stable.
@@ -371,6 +569,18 @@ int time() {
   const vector<vector<Blob<float>*> >& top_vecs = caffe_net.top_vecs();
   const vector<vector<bool> >& bottom_need_backward =
       caffe_net.bottom_need_backward();
+  // Like Net::Backward, only run the layers that need it, so that a TEST
+  // phase net is only timed forward.
+  const vector<bool>& layer_need_backward = caffe_net.layer_need_backward();
+  caffe::NetProfiler<float> profiler(caffe_net);
+  caffe::PerfCounters* counters = NULL;
+  if (FLAGS_perf_counters) {
+    counters = caffe::PerfCounters::ForThread();
+    LOG_IF(WARNING, !counters->any_available())
+        << "Hardware counters are unavailable; timing without them.";
+  }
+  int64_t counts_start[caffe::PerfCounters::NUM_EVENTS];
+  int64_t counts[caffe::PerfCounters::NUM_EVENTS];
   LOG(INFO) << "*** Benchmark begins ***";
   LOG(INFO) << "Testing for " << FLAGS_iterations << " iterations.";
   Timer total_timer;
@@ -385,21 +595,52 @@ int time() {
   for (int j = 0; j < FLAGS_iterations; ++j) {
     Timer iter_timer;
     iter_timer.Start();
+    double pass_start = profiler.Now();
     forward_timer.Start();
     for (int i = 0; i < layers.size(); ++i) {
+      if (counters) {
+        counters->Read(counts_start);
+      }
+      const double start = profiler.Now();
       timer.Start();
       layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
-      forward_time_per_layer[i] += timer.MicroSeconds();
+      const float layer_time = timer.MicroSeconds();
+      if (counters) {
+        counters->Read(counts);
+        SubtractCounts(counts_start, counts);
+        profiler.AddCounts(i, false, counts);
+      }
+      forward_time_per_layer[i] += layer_time;
+      profiler.AddLayer(i, false, start, layer_time);
     }
-    forward_time += forward_timer.MicroSeconds();
+    const float forward_pass_time = forward_timer.MicroSeconds();
+    forward_time += forward_pass_time;
+    profiler.AddPass(false, pass_start, forward_pass_time);
+    pass_start = profiler.Now();
     backward_timer.Start();
     for (int i = layers.size() - 1; i >= 0; --i) {
+      if (!layer_need_backward[i]) {
+        continue;
+      }
+      if (counters) {
+        counters->Read(counts_start);
+      }
+      const double start = profiler.Now();
       timer.Start();
       layers[i]->Backward(top_vecs[i], bottom_need_backward[i],
                           bottom_vecs[i]);
-      backward_time_per_layer[i] += timer.MicroSeconds();
+      const float layer_time = timer.MicroSeconds();
+      if (counters) {
+        counters->Read(counts);
+        SubtractCounts(counts_start, counts);
+        profiler.AddCounts(i, true, counts);
+      }
+      backward_time_per_layer[i] += layer_time;
+      profiler.AddLayer(i, true, start, layer_time);
     }
-    backward_time += backward_timer.MicroSeconds();
+    const float backward_pass_time = backward_timer.MicroSeconds();
+    backward_time += backward_pass_time;
+    profiler.AddPass(true, pass_start, backward_pass_time);
     LOG(INFO) << "Iteration: " << j + 1 << " forward-backward time: "
       << iter_timer.MilliSeconds() << " ms.";
   }
@@ -413,6 +654,8 @@ int time() {
       "\tbackward: " << backward_time_per_layer[i] / 1000 /
       FLAGS_iterations << " ms.";
   }
+  LOG(INFO) << "Time distribution per layer: ";
+  profiler.Log();
   total_timer.Stop();
   LOG(INFO) << "Average Forward pass: " << forward_time / 1000 /
     FLAGS_iterations << " ms.";
@@ -422,10 +665,291 @@ int time() {
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
   LOG(INFO) << "*** Benchmark ends ***";
+  if (FLAGS_profile.size()) {
+    std::ofstream profile_file(FLAGS_profile.c_str());
+    CHECK(profile_file) << "Cannot write " << FLAGS_profile;
+    profiler.WriteJSON(&profile_file);
+    LOG(INFO) << "Wrote the profile to " << FLAGS_profile;
+  }
+  if (FLAGS_trace.size()) {
+    std::ofstream trace_file(FLAGS_trace.c_str());
+    CHECK(trace_file) << "Cannot write " << FLAGS_trace;
+    profiler.WriteTrace(&trace_file);
+    LOG(INFO) << "Wrote the trace to " << FLAGS_trace;
+  }
   return 0;
 }
 RegisterBrewFunction(time);
 
+// Memory: report the memory of each layer of a model.
+int memory() {
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to report.";
+  caffe::Phase phase = get_phase_from_flags(caffe::TEST);
+  vector<string> stages = get_stages_from_flags();
+  vector<int> gpus;
+  get_gpus(&gpus);
+  if (gpus.size() != 0) {
+    LOG(INFO) << "Use GPU with device ID " << gpus[0];
+    Caffe::SetDevice(gpus[0]);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    LOG(INFO) << "Use CPU.";
+    Caffe::set_mode(Caffe::CPU);
+  }
+  Net<float> caffe_net(FLAGS_model, phase, FLAGS_level, &stages);
+  if (FLAGS_weights.size()) {
+    caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
+  vector<Net<float>::LayerMemory> report;
+  caffe_net.MemoryReport(&report);
+  const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
+  const double megabyte = 1 << 20;
+  Net<float>::LayerMemory total = {0, 0, 0, 0, 0};
+  LOG(INFO) << "Memory per layer in MB (data / diff): ";
+  for (int i = 0; i < layers.size(); ++i) {
+    const Net<float>::LayerMemory& memory = report[i];
+    LOG(INFO) << std::fixed << std::setprecision(2) << std::setfill(' ')
+      << std::setw(20) << caffe_net.layer_names()[i]
+      << std::setw(16) << layers[i]->type()
+      << "\ttops: " << memory.top_data / megabyte
+      << " / " << memory.top_diff / megabyte
+      << "\tparams: " << memory.param_data / megabyte
+      << " / " << memory.param_diff / megabyte
+      << "\tinternal: " << memory.internal / megabyte;
+    total.top_data += memory.top_data;
+    total.top_diff += memory.top_diff;
+    total.param_data += memory.param_data;
+    total.param_diff += memory.param_diff;
+    total.internal += memory.internal;
+  }
+  LOG(INFO) << std::fixed << std::setprecision(2)
+      << "Total tops: " << total.top_data / megabyte << " / "
+      << total.top_diff / megabyte << " MB, params: "
+      << total.param_data / megabyte << " / " << total.param_diff / megabyte
+      << " MB, internal: " << total.internal / megabyte << " MB.";
+  LOG(INFO) << std::fixed << std::setprecision(2) << "Total: "
+      << (total.top_data + total.top_diff + total.param_data +
+          total.param_diff + total.internal) / megabyte << " MB.";
+  LOG(INFO) << std::fixed << std::setprecision(2) << "Peak resident memory: "
+      << caffe::PeakResidentBytes() / megabyte << " MB.";
+  return 0;
+}
+RegisterBrewFunction(memory);
+
+#ifdef USE_OPENCV
+// The microseconds that bench_detect spent in each stage of its batches.
+struct DetectStats {
+  vector<float> read, transform, forward, post, latency;
+};
+
+// The image files of bench_detect, which replicas take batches of in turn.
+class ImageList {
+ public:
+  explicit ImageList(const vector<string>& files) : files_(files), next_(0) {}
+  void Next(int count, vector<string>* files) {
+    boost::mutex::scoped_lock lock(mutex_);
+    files->clear();
+    for (int i = 0; i < count; ++i, ++next_) {
+      files->push_back(files_[next_ % files_.size()]);
+    }
+  }
+
+ private:
+  vector<string> files_;
+  int next_;
+  boost::mutex mutex_;
+};
+
+// Runs a batch of images through net: reads and decodes the files, resizes
+// them to the input of the net and subtracts the mean, runs the net forward
+// and copies the outputs for each image out of the net.
+void DetectBatch(Net<float>* net, const vector<string>& files,
+    caffe::DataTransformer<float>* transformer, DetectStats* stats) {
+  caffe::CPUTimer latency_timer;
+  caffe::CPUTimer timer;
+  latency_timer.Start();
+  timer.Start();
+  Blob<float>* data = net->input_blobs()[0];
+  vector<cv::Mat> images(files.size());
+  for (int i = 0; i < files.size(); ++i) {
+    images[i] = caffe::ReadImageToCVMat(files[i], data->channels() == 3);
+    CHECK(images[i].data) << "Could not read " << files[i];
+  }
+  stats->read.push_back(timer.MicroSeconds());
+  timer.Start();
+  // Faster R-CNN style nets also take the size and scale of each image.
+  Blob<float>* im_info = net->has_blob("im_info") ?
+      net->blob_by_name("im_info").get() : NULL;
+  for (int i = 0; i < images.size(); ++i) {
+    if (im_info) {
+      float* info = im_info->mutable_cpu_data() + im_info->offset(i);
+      info[0] = data->height();
+      info[1] = data->width();
+      info[2] = static_cast<float>(data->height()) / images[i].rows;
+    }
+    cv::resize(images[i], images[i], cv::Size(data->width(), data->height()));
+  }
+  transformer->Transform(images, data);
+  stats->transform.push_back(timer.MicroSeconds());
+  Timer forward_timer;
+  forward_timer.Start();
+  const vector<Blob<float>*>& outputs = net->Forward();
+  stats->forward.push_back(forward_timer.MicroSeconds());
+  timer.Start();
+  vector<vector<float> > results(images.size());
+  for (int j = 0; j < outputs.size(); ++j) {
+    const int count = outputs[j]->count(1);
+    for (int i = 0; i < images.size(); ++i) {
+      const float* output = outputs[j]->cpu_data() + i * count;
+      results[i].insert(results[i].end(), output, output + count);
+    }
+  }
+  stats->post.push_back(timer.MicroSeconds());
+  stats->latency.push_back(latency_timer.MicroSeconds());
+}
+
+// Runs FLAGS_iterations batches through a replica of the net.
+void DetectReplica(Net<float>* net, ImageList* images, Caffe::Brew mode,
+    DetectStats* stats) {
+  Caffe::set_mode(mode);
+#ifdef _OPENMP
+  if (FLAGS_omp_threads > 0) {
+    omp_set_num_threads(FLAGS_omp_threads);
+  }
+#endif
+  caffe::TransformationParameter transform_param;
+  vector<string> means;
+  boost::split(means, FLAGS_mean_value, boost::is_any_of(","));
+  for (int i = 0; i < means.size(); ++i) {
+    transform_param.add_mean_value(std::atof(means[i].c_str()));
+  }
+  caffe::DataTransformer<float> transformer(transform_param, caffe::TEST);
+  vector<string> files;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    images->Next(FLAGS_batch_size, &files);
+    DetectBatch(net, files, &transformer, stats);
+  }
+}
+
+void LogDetectStats(const string& stage, const vector<float>& times) {
+  const caffe::NetProfiler<float>::Stats stats =
+      caffe::NetProfiler<float>::Summarize(times);
+  LOG(INFO) << std::setfill(' ') << std::setw(10) << stage << ": mean "
+      << stats.mean << " ms, median " << stats.median << " ms, p99 "
+      << stats.p99 << " ms per batch.";
+}
+#endif  // USE_OPENCV
+
+// Bench detect: measure the throughput of a detection model end to end,
+// from reading the images to the outputs.
+int bench_detect() {
+#ifdef USE_OPENCV
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to run.";
+  CHECK_GT(FLAGS_images.size(), 0) << "Need a list of images to run.";
+  CHECK_GT(FLAGS_replicas, 0);
+  CHECK_GT(FLAGS_batch_size, 0);
+  vector<string> stages = get_stages_from_flags();
+  vector<string> files;
+  std::ifstream list(FLAGS_images.c_str());
+  CHECK(list) << "Cannot read " << FLAGS_images;
+  string line;
+  while (std::getline(list, line)) {
+    if (line.size()) {
+      files.push_back(line.substr(0, line.find(' ')));
+    }
+  }
+  CHECK_GT(files.size(), 0) << "No images in " << FLAGS_images;
+
+  vector<int> gpus;
+  get_gpus(&gpus);
+  if (gpus.size() != 0) {
+    LOG(INFO) << "Use GPU with device ID " << gpus[0];
+    Caffe::SetDevice(gpus[0]);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    LOG(INFO) << "Use CPU.";
+    Caffe::set_mode(Caffe::CPU);
+  }
+  shared_ptr<caffe::NetWeights<float> > weights;
+  if (FLAGS_weights.size()) {
+    weights.reset(new caffe::NetWeights<float>(FLAGS_weights));
+  }
+  vector<shared_ptr<Net<float> > > nets;
+  for (int r = 0; r < FLAGS_replicas; ++r) {
+    nets.push_back(shared_ptr<Net<float> >(new Net<float>(FLAGS_model,
+        caffe::TEST, FLAGS_level, &stages, weights)));
+    if (!weights && r > 0) {
+      nets[r]->ShareTrainedLayersWith(nets[0].get());
+    }
+    CHECK_GE(nets[r]->num_inputs(), 1) << "The net needs an image input";
+    Blob<float>* data = nets[r]->input_blobs()[0];
+    CHECK_EQ(4, data->num_axes()) << "The image input must be N x C x H x W";
+    data->Reshape(FLAGS_batch_size, data->channels(), data->height(),
+                  data->width());
+    if (nets[r]->has_blob("im_info")) {
+      vector<int> shape(2);
+      shape[0] = FLAGS_batch_size;
+      shape[1] = 3;
+      nets[r]->blob_by_name("im_info")->Reshape(shape);
+    }
+    nets[r]->Reshape();
+  }
+
+  // Warm up each replica, so that its memory is allocated.
+  ImageList images(files);
+  vector<DetectStats> stats(FLAGS_replicas);
+  {
+    caffe::TransformationParameter transform_param;
+    caffe::DataTransformer<float> transformer(transform_param, caffe::TEST);
+    vector<string> batch;
+    DetectStats warm_up;
+    for (int r = 0; r < FLAGS_replicas; ++r) {
+      images.Next(FLAGS_batch_size, &batch);
+      DetectBatch(nets[r].get(), batch, &transformer, &warm_up);
+    }
+  }
+  LOG(INFO) << "*** Benchmark begins ***";
+  LOG(INFO) << "Running " << FLAGS_iterations << " batches of "
+      << FLAGS_batch_size << " on each of " << FLAGS_replicas << " replicas.";
+  caffe::CPUTimer total_timer;
+  total_timer.Start();
+  boost::thread_group threads;
+  for (int r = 0; r < FLAGS_replicas; ++r) {
+    threads.create_thread(boost::bind(&DetectReplica, nets[r].get(),
+        &images, Caffe::mode(), &stats[r]));
+  }
+  threads.join_all();
+  const float seconds = total_timer.Seconds();
+  DetectStats all;
+  for (int r = 0; r < FLAGS_replicas; ++r) {
+    all.read.insert(all.read.end(), stats[r].read.begin(),
+                    stats[r].read.end());
+    all.transform.insert(all.transform.end(), stats[r].transform.begin(),
+                         stats[r].transform.end());
+    all.forward.insert(all.forward.end(), stats[r].forward.begin(),
+                       stats[r].forward.end());
+    all.post.insert(all.post.end(), stats[r].post.begin(),
+                    stats[r].post.end());
+    all.latency.insert(all.latency.end(), stats[r].latency.begin(),
+                       stats[r].latency.end());
+  }
+  const int num_images = FLAGS_replicas * FLAGS_iterations * FLAGS_batch_size;
+  LOG(INFO) << "Time per stage: ";
+  LogDetectStats("read", all.read);
+  LogDetectStats("transform", all.transform);
+  LogDetectStats("forward", all.forward);
+  LogDetectStats("post", all.post);
+  LogDetectStats("latency", all.latency);
+  LOG(INFO) << "Images: " << num_images << " in " << seconds << " s, "
+      << num_images / seconds << " images/s.";
+  LOG(INFO) << "*** Benchmark ends ***";
+#else
+  LOG(FATAL) << "bench_detect requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
+RegisterBrewFunction(bench_detect);
+
 int main(int argc, char** argv) {
   // Print output to stderr (while still logging).
   FLAGS_alsologtostderr = 1;
@@ -437,8 +961,11 @@ int main(int argc, char** argv) {
       "commands:\n"
       "  train           train or finetune a model\n"
       "  test            score a model\n"
+      "  calibrate       record the int8 quantization of a model\n"
       "  device_query    show GPU diagnostic information\n"
-      "  time            benchmark model execution time");
+      "  time            benchmark model execution time\n"
+      "  memory          report the memory of each layer of a model\n"
+      "  bench_detect    benchmark detection throughput on a list of images");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
   if (argc == 2) {
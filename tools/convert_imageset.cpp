@@ -3,6 +3,9 @@
 // Usage:
 //   convert_imageset [FLAGS] ROOTFOLDER/ LISTFILE DB_NAME
 //
+// Images are read, resized and encoded by --threads threads, and written in
+// list order by the main thread, --commit_batch records per transaction.
+//
 // where ROOTFOLDER is the root folder that holds all the images, and LISTFILE
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
@@ -14,7 +17,7 @@
 #include <utility>
 #include <vector>
 
-#include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
@@ -26,7 +29,6 @@
 
 using namespace caffe;  // NOLINT(build/namespaces)
 using std::pair;
-using boost::scoped_ptr;
 
 DEFINE_bool(gray, false,
     "When this option is on, treat images as grayscale ones");
@@ -42,6 +44,64 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 1,
+    "Number of threads reading, resizing and encoding images");
+DEFINE_int32(commit_batch, 1000,
+    "Number of records written to a db per transaction");
+DEFINE_int32(shards, 1,
+    "Split the records round-robin over this many dbs, named DB_NAME_<k>");
+
+#ifdef USE_OPENCV
+// Reads, resizes and encodes one image as set by the flags into a serialized
+// Datum, or leaves out empty if the image cannot be read.
+void ConvertLine(const std::string& root_folder,
+    const std::pair<std::string, int>& line, std::string* out,
+    int* data_size) {
+  out->clear();
+  std::string enc = FLAGS_encode_type;
+  if (FLAGS_encoded && !enc.size()) {
+    // Guess the encoding type from the file name
+    string fn = line.first;
+    size_t p = fn.rfind('.');
+    if ( p == fn.npos )
+      LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+    enc = fn.substr(p);
+    std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+  }
+  Datum datum;
+  if (!ReadImageToDatum(root_folder + line.first, line.second,
+      std::max<int>(0, FLAGS_resize_height),
+      std::max<int>(0, FLAGS_resize_width), !FLAGS_gray, enc, &datum)) {
+    return;
+  }
+  *data_size = datum.data().size();
+  CHECK(datum.SerializeToString(out));
+}
+
+// Converts every stride-th line of [begin, end) starting at begin + offset,
+// storing the results at their position in the window.
+void ConvertLines(const std::string& root_folder,
+    const std::vector<std::pair<std::string, int> >& lines, int begin,
+    int end, int offset, int stride, std::vector<std::string>* outs,
+    std::vector<int>* data_sizes) {
+  for (int line_id = begin + offset; line_id < end; line_id += stride) {
+    ConvertLine(root_folder, lines[line_id], &(*outs)[line_id - begin],
+        &(*data_sizes)[line_id - begin]);
+  }
+}
+
+// Starts threads converting lines [begin, end) into outs and data_sizes.
+void StartConverting(const std::string& root_folder,
+    const std::vector<std::pair<std::string, int> >& lines, int begin,
+    int end, int threads, std::vector<std::string>* outs,
+    std::vector<int>* data_sizes, boost::thread_group* workers) {
+  for (int t = 0; t < threads && begin + t < end; ++t) {
+    workers->create_thread(boost::bind(&ConvertLines,
+        boost::cref(root_folder), boost::cref(lines), begin, end, t, threads,
+        outs, data_sizes));
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -66,7 +126,6 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  const bool is_color = !FLAGS_gray;
   const bool check_size = FLAGS_check_size;
   const bool encoded = FLAGS_encoded;
   const string encode_type = FLAGS_encode_type;
@@ -91,65 +150,89 @@ int main(int argc, char** argv) {
   if (encode_type.size() && !encoded)
     LOG(INFO) << "encode_type specified, assuming encoded=true.";
 
-  int resize_height = std::max<int>(0, FLAGS_resize_height);
-  int resize_width = std::max<int>(0, FLAGS_resize_width);
-
-  // Create new DB
-  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[3], db::NEW);
-  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  CHECK_GT(FLAGS_threads, 0) << "Need at least one thread.";
+  CHECK_GT(FLAGS_commit_batch, 0) << "Commit batch size must be positive.";
+  CHECK_GT(FLAGS_shards, 0) << "Need at least one shard.";
+  const int threads = FLAGS_threads;
+  const int commit_batch = FLAGS_commit_batch;
+  const int shards = FLAGS_shards;
+
+  // Create new DBs
+  std::vector<shared_ptr<db::DB> > dbs(shards);
+  std::vector<shared_ptr<db::Transaction> > txns(shards);
+  std::vector<int> pending(shards);
+  for (int shard = 0; shard < shards; ++shard) {
+    std::string db_name(argv[3]);
+    if (shards > 1) {
+      db_name += "_" + caffe::format_int(shard);
+    }
+    dbs[shard].reset(db::GetDB(FLAGS_backend));
+    dbs[shard]->Open(db_name, db::NEW);
+    txns[shard].reset(dbs[shard]->NewTransaction());
+  }
 
-  // Storing to db
+  // Images are converted in windows: while the records of one window are
+  // written in order, the threads convert the next one.
   std::string root_folder(argv[1]);
-  Datum datum;
+  const int window = 128 * threads;
+  std::vector<std::string> outs[2];
+  std::vector<int> data_sizes[2];
+  for (int i = 0; i < 2; ++i) {
+    outs[i].resize(window);
+    data_sizes[i].resize(window);
+  }
+  boost::thread_group workers;
+  StartConverting(root_folder, lines, 0, std::min<int>(window, lines.size()),
+      threads, &outs[0], &data_sizes[0], &workers);
   int count = 0;
   int data_size = 0;
   bool data_size_initialized = false;
 
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if ( p == fn.npos )
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      enc = fn.substr(p);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-    }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
-        lines[line_id].second, resize_height, resize_width, is_color,
-        enc, &datum);
-    if (status == false) continue;
-    if (check_size) {
-      if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
-        data_size_initialized = true;
-      } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
+  for (int begin = 0; begin < lines.size(); begin += window) {
+    workers.join_all();
+    const int current = (begin / window) % 2;
+    const int end = std::min<int>(begin + window, lines.size());
+    StartConverting(root_folder, lines, end,
+        std::min<int>(end + window, lines.size()), threads,
+        &outs[1 - current], &data_sizes[1 - current], &workers);
+    for (int line_id = begin; line_id < end; ++line_id) {
+      const std::string& out = outs[current][line_id - begin];
+      if (out.empty()) continue;
+      if (check_size) {
+        const int size = data_sizes[current][line_id - begin];
+        if (!data_size_initialized) {
+          data_size = size;
+          data_size_initialized = true;
+        } else {
+          CHECK_EQ(size, data_size) << "Incorrect data field size " << size;
+        }
+      }
+      // sequential
+      string key_str = caffe::format_int(line_id, 8) + "_" +
+          lines[line_id].first;
+
+      // Put in db
+      const int shard = count % shards;
+      txns[shard]->Put(key_str, out);
+
+      if (++pending[shard] == commit_batch) {
+        // Commit db
+        txns[shard]->Commit();
+        txns[shard].reset(dbs[shard]->NewTransaction());
+        pending[shard] = 0;
+      }
+      if (++count % 1000 == 0) {
+        LOG(INFO) << "Processed " << count << " files.";
       }
     }
-    // sequential
-    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
-
-    // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
-
-    if (++count % 1000 == 0) {
-      // Commit db
-      txn->Commit();
-      txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+  }
+  // write the last batches
+  for (int shard = 0; shard < shards; ++shard) {
+    if (pending[shard]) {
+      txns[shard]->Commit();
     }
   }
-  // write the last batch
   if (count % 1000 != 0) {
-    txn->Commit();
     LOG(INFO) << "Processed " << count << " files.";
   }
 #else
@@ -0,0 +1,56 @@
+// This program converts trained weights to a weights file that Net can map
+// into memory instead of parsing (see caffe/util/mapped_weights.hpp).
+// Usage:
+//    convert_weights [--model=net.prototxt] weights_in weights_out
+// where weights_in is a .caffemodel, or an .h5 file along with the model
+// definition it belongs to.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <string>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/mapped_weights.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "",
+    "The model definition, needed to read HDF5 weights.");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Converts trained weights to a weights file that\n"
+        "can be mapped into memory.\n"
+        "Usage:\n"
+        "    convert_weights [FLAGS] WEIGHTS_IN WEIGHTS_OUT\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc != 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_weights");
+    return 1;
+  }
+  const string input(argv[1]);
+  NetParameter param;
+  if (hdf5_is_file(input)) {
+    CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to read "
+                                    << input;
+    Caffe::set_mode(Caffe::CPU);
+    Net<float> net(FLAGS_model, TEST);
+    net.CopyTrainedLayersFrom(input);
+    net.ToProto(&param);
+  } else {
+    ReadNetParamsFromBinaryFileOrDie(input, &param);
+  }
+  MappedWeights::Write(param, argv[2]);
+  LOG(INFO) << "Wrote " << argv[2];
+  return 0;
+}
@@ -0,0 +1,117 @@
+// This program measures the latency and throughput of an InferenceServer
+// under load, for a range of batch timeouts.
+// Usage:
+//    server_benchmark --model=deploy.prototxt [--weights=net.caffemodel]
+//        [--clients=8] [--requests=200] [--batch_timeouts=0,500,2000]
+// Each client thread submits its requests one after the other, waiting for
+// the output of each before submitting the next.
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "caffe/caffe.hpp"
+#include "caffe/inference_server.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(model, "",
+    "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights; the params are filled randomly otherwise.");
+DEFINE_int32(replicas, 1,
+    "The number of replicas of the net.");
+DEFINE_int32(max_batch_size, 8,
+    "The largest batch to run.");
+DEFINE_string(batch_timeouts, "0,500,1000,2000,5000",
+    "Comma-separated list of the batch timeouts to try, in microseconds.");
+DEFINE_int32(clients, 8,
+    "The number of client threads.");
+DEFINE_int32(requests, 200,
+    "The number of requests per client.");
+
+// Submits requests one at a time and records how long each took, in ms.
+static void RunClient(InferenceServer<float>* server, const float* input,
+    vector<float>* latencies) {
+  CPUTimer timer;
+  for (int i = 0; i < latencies->size(); ++i) {
+    timer.Start();
+    server->Submit(input).get();
+    (*latencies)[i] = timer.MilliSeconds();
+  }
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Measures the latency and throughput of a net\n"
+        "served with dynamic batching.\n"
+        "Usage:\n"
+        "    server_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_model.empty() || FLAGS_clients <= 0 || FLAGS_requests <= 0) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/server_benchmark");
+    return 1;
+  }
+  Caffe::set_mode(Caffe::CPU);
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(TEST);
+  shared_ptr<NetWeights<float> > weights;
+  if (!FLAGS_weights.empty()) {
+    weights.reset(new NetWeights<float>(FLAGS_weights));
+  }
+
+  vector<string> timeouts;
+  boost::split(timeouts, FLAGS_batch_timeouts, boost::is_any_of(","));
+  for (int t = 0; t < timeouts.size(); ++t) {
+    InferenceServerParameter server_param;
+    server_param.set_replicas(FLAGS_replicas);
+    server_param.set_max_batch_size(FLAGS_max_batch_size);
+    server_param.set_batch_timeout_us(atoi(timeouts[t].c_str()));
+    InferenceServer<float> server(server_param, param, weights);
+    Blob<float> input(server.input_shape());
+    caffe_rng_uniform<float>(input.count(), -1, 1, input.mutable_cpu_data());
+    // Warm up each replica.
+    for (int i = 0; i < FLAGS_replicas; ++i) {
+      server.Submit(input.cpu_data()).get();
+    }
+
+    vector<vector<float> > latencies(FLAGS_clients,
+                                     vector<float>(FLAGS_requests));
+    CPUTimer timer;
+    timer.Start();
+    boost::thread_group clients;
+    for (int i = 0; i < FLAGS_clients; ++i) {
+      clients.create_thread(boost::bind(&RunClient, &server, input.cpu_data(),
+                                        &latencies[i]));
+    }
+    clients.join_all();
+    const float seconds = timer.Seconds();
+
+    vector<float> all;
+    for (int i = 0; i < latencies.size(); ++i) {
+      all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    }
+    std::sort(all.begin(), all.end());
+    LOG(INFO) << "batch_timeout_us " << server_param.batch_timeout_us()
+              << ": " << all.size() / seconds << " requests/s, p50 "
+              << all[all.size() / 2] << " ms, p99 "
+              << all[std::min<int>(all.size() - 1, all.size() * 0.99)]
+              << " ms";
+  }
+  return 0;
+}